@@ -0,0 +1,121 @@
+/* Benchmarks the hot paths of siliapp and prints every result as a single line
+ * of JSON, so that the output can be diffed between releases.
+ *
+ * The CPU benchmarks draw into a headless window and don't need a display
+ * server. The OpenGL ones do, so on a server they should be run through Xvfb
+ * with Mesa's llvmpipe, e.g. 'xvfb-run make bench'. Without a display they get
+ * reported as skipped. */
+#include <sili.h>
+#include <stb_image.h>
+#include <stb_truetype.h>
+#define SIAPP_IMPLEMENTATION
+#include <siliapp.h>
+
+#define BENCH_FONT "res/calibri.ttf"
+#define BENCH_TEXT "The quick brown fox jumps over the lazy dog 0123456789"
+
+
+/* name - cstring | runs - usize | function - EXPRESSION
+ * Runs the expression once to warm up, then 'runs' more times and prints the
+ * cost of one call. The time comes from the monotonic clock, as the TSC can't be
+ * converted into nanoseconds on CPUs that change their frequency. */
+#define BENCH(name, runs, function) \
+	do { \
+		function; \
+		u64 cycles = si_RDTSC(), start = siapp__clockNs(); \
+		for_range (benchIndex, 0, runs) { function; } \
+		u64 ns = siapp__clockNs() - start; \
+		benchPrint(name, runs, si_RDTSC() - cycles, ns); \
+	} while (0)
+
+
+void benchPrint(cstring name, usize runs, u64 cycles, u64 ns) {
+	si_printf(
+		"{\"name\": \"%s\", \"runs\": %zu, \"cycles_per_op\": %.1f, \"ns_per_op\": %.1f}\n",
+		name, runs, (f64)cycles / runs, (f64)ns / runs
+	);
+}
+void benchSkip(cstring name, cstring reason) {
+	si_printf("{\"name\": \"%s\", \"skipped\": \"%s\"}\n", name, reason);
+}
+
+
+void benchEventReset(siWindow* win) {
+	siWindowEvent* e = &win->e;
+
+	for_range (i, 0, 8) {
+		siapp__keyRelease(e, SK_A + i);
+		siapp__keyPress(e, SK_A + i);
+	}
+	siapp__mouseButtonPress(e, SI_MOUSE_LEFT);
+	siapp__mouseButtonRelease(e, SI_MOUSE_RIGHT);
+
+	siapp_windowUpdate(win, false);
+}
+void benchFontLoad(siWindow* win) {
+	siFont font = siapp_fontLoad(win, BENCH_FONT, 32);
+	siapp_fontFree(font);
+}
+void benchGLBatch(siWindow* win) {
+	for_range (i, 0, 1000) {
+		i32 x = i % 64 * 16, y = i / 64 * 16;
+		siapp_drawRect(win, SI_RECT(x, y, 16, 16), SI_RGBA(i, 128, 255 - i, 200));
+	}
+	siapp_windowRender(win);
+	glFinish();
+}
+
+
+void benchCPU(void) {
+	siWindow* win = siapp_windowMakeHeadless(SI_AREA(1024, 768), 0);
+	siapp_windowRendererMake(win, SI_RENDERING_CPU, 1, SI_AREA(256, 256), 2);
+
+	siByte* pixels = malloc(256 * 256 * 4);
+	for_range (i, 0, 256 * 256 * 4) {
+		pixels[i] = (siByte)(i * 7 + 3) | 0x80;
+	}
+	siImage image = siapp_imageLoadEx(&win->atlas, pixels, 256, 256, 4);
+	siSpriteSheet sheet = siapp_spriteSheetLoadEx(&win->atlas, pixels, 256, 256, 4, SI_AREA(256, 256));
+	siFont font = siapp_fontLoad(win, BENCH_FONT, 32);
+
+	BENCH("cpu_fill_opaque_256", 1000, siapp_drawRect(win, SI_RECT(16, 16, 256, 256), SI_RGB(200, 100, 50)));
+	BENCH("cpu_fill_blend_256", 1000, siapp_drawRect(win, SI_RECT(16, 16, 256, 256), SI_RGBA(200, 100, 50, 128)));
+
+	BENCH("cpu_blit_1to1_256", 1000, siapp_drawImage(win, SI_RECT(16, 16, 256, 256), image));
+	siapp_textureAtlasResizeMethodSet(&win->atlas, SI_RESIZE_NEAREST);
+	BENCH("cpu_blit_nearest_384", 1000, siapp_drawImage(win, SI_RECT(16, 16, 384, 384), image));
+	siapp_textureAtlasResizeMethodSet(&win->atlas, SI_RESIZE_LINEAR);
+	BENCH("cpu_blit_linear_384", 1000, siapp_drawImage(win, SI_RECT(16, 16, 384, 384), image));
+
+	BENCH("cpu_glyph_run_32px", 1000, siapp_drawText(win, BENCH_TEXT, &font, SI_POINT(16, 400), 32));
+	BENCH("font_load_32px", 100, benchFontLoad(win));
+	BENCH("cpu_atlas_upload_256", 1000, siapp_spriteSheetSpriteSetEx(sheet, 0, pixels, 4));
+	BENCH("event_state_reset", 1000, benchEventReset(win));
+
+	siapp_fontFree(font);
+	free(pixels);
+	siapp_windowClose(win);
+}
+
+void benchOpenGL(void) {
+	cstring display = getenv("DISPLAY");
+	if (display == nil || display[0] == '\0') {
+		benchSkip("gl_batch_1000_rects", "no display");
+		return ;
+	}
+
+	siWindow* win = siapp_windowMake("siliapp bench", SI_AREA(1024, 768), SI_WINDOW_DEFAULT);
+	siapp_windowRendererMake(win, SI_RENDERING_OPENGL, 1024, SI_AREA(256, 256), 1);
+	siapp_windowVSyncSet(win, false);
+
+	si_printf("{\"name\": \"gl_renderer\", \"value\": \"%s\"}\n", glGetString(GL_RENDERER));
+	BENCH("gl_batch_1000_rects", 100, benchGLBatch(win));
+
+	siapp_windowClose(win);
+}
+
+
+int main(void) {
+	benchCPU();
+	benchOpenGL();
+}
@@ -87,6 +87,7 @@ extern "C" {
 	#include <X11/cursorfont.h>
 	#include <X11/Xcursor/Xcursor.h>
 	#include <X11/extensions/Xrandr.h>
+	#include <X11/extensions/XInput2.h>
 
 	#define SIAPP_PLATFORM_API_X11
 #elif defined(SI_SYSTEM_WINDOWS)
@@ -110,6 +111,27 @@ extern "C" {
 	#define SIAPP_PLATFORM_API_COCOA
 #endif
 
+#if defined(SIAPP_TRACE)
+	#if !defined(SIAPP_TRACE_CAPACITY)
+		/* How many of the latest zones each thread keeps. */
+		#define SIAPP_TRACE_CAPACITY 16384
+	#endif
+	#if !defined(SIAPP_TRACE_THREADS)
+		/* How many threads can record zones. */
+		#define SIAPP_TRACE_THREADS 64
+	#endif
+
+	/* name - cstring
+	 * Starts a trace zone on the current thread. The name has to outlive the
+	 * trace and cannot contain quotes. */
+	#define SIAPP_TRACE_BEGIN(name) siapp__traceBegin(name)
+	/* Ends the latest trace zone of the current thread. */
+	#define SIAPP_TRACE_END() siapp__traceEnd()
+#else
+	#define SIAPP_TRACE_BEGIN(name) do { } while (0)
+	#define SIAPP_TRACE_END() do { } while (0)
+#endif
+
 #if !defined(SIAPP_IMAGE_LOAD)
 	#if defined(STBI_INCLUDE_STB_IMAGE_H)
 		/* buffer - siByte* | len - usize | width - i32* | height - i32* | channels - i32*
@@ -129,6 +151,23 @@ extern "C" {
 	#endif
 #endif
 
+#if !defined(SIAPP_IMAGE_WRITE)
+	#if defined(INCLUDE_STB_IMAGE_WRITE_H)
+		/* path - cstring | width - i32 | height - i32 | channels - i32 | data - const siByte* | stride - i32
+		 * A macro that encodes the raw image data into a file, returns a nonzero
+		 * value on success. */
+		#define SIAPP_IMAGE_WRITE(path, width, height, channels, data, stride) \
+			stbi_write_png(path, width, height, channels, data, stride)
+	#else
+		#define SIAPP_IMAGE_WRITE(path, width, height, channels, data, stride) \
+			0; SI_PANIC_MSG( \
+				"Macro 'SIAPP_IMAGE_WRITE' has not been set. Either include " \
+				"'stb_image_write.h' or define 'SIAPP_IMAGE_WRITE' with your own " \
+				"image writing function." \
+			); SI_UNUSED(path); SI_UNUSED(width); SI_UNUSED(height); SI_UNUSED(channels); SI_UNUSED(data); SI_UNUSED(stride)
+	#endif
+#endif
+
 
 typedef SI_ENUM(b32, siWindowArg) {
 	SI_WINDOW_CENTER                  = SI_BIT(0),
@@ -145,6 +184,9 @@ typedef SI_ENUM(b32, siWindowArg) {
 	SI_WINDOW_SCALING                 = SI_BIT(8),
 	SI_WINDOW_KEEP_ASPECT_RATIO       = SI_BIT(9),
 
+	/* Set by 'siapp_windowMakeHeadless', the window only has a pixel buffer. */
+	SI_WINDOW_HEADLESS                = SI_BIT(10),
+
 #if defined(SIAPP_PLATFORM_API_WIN32)
 	SI_WINDOW_WIN32_DISABLE_DARK_MODE = SI_BIT(30),
 #elif defined(SIAPP_PLATFORM_API_COCOA)
@@ -207,8 +249,6 @@ typedef SI_ENUM(u8, siKeyType) {
 	SK_F1, SK_F2, SK_F3, SK_F4, SK_F5, SK_F6, SK_F7, SK_F8, SK_F9, SK_F10, SK_F11,
 	SK_F12, SK_F13,  SK_F14, SK_F15,
 
-	SK__EVENT, /* NOTE(EimaMei): Used for setting bit 7 and 6 to denote key and
-				  mouse button event changes, do not use! */
 	SK_COUNT,
 };
 
@@ -231,6 +271,14 @@ typedef SI_ENUM(u32, siMouseWheelType) {
 	SI_MOUSE_WHEEL_COUNT = SI_MOUSE_WHEEL_RIGHT
 };
 
+typedef SI_ENUM(u32, siRawMouseMode) {
+	SI_RAW_MOUSE_OFF = 0,
+	/* The samples get summed into 'mouseDelta' and 'mouseScroll'. */
+	SI_RAW_MOUSE_COALESCED,
+	/* Every sample also gets queued as a 'SI_EVENT_MOUSE_RAW' event. */
+	SI_RAW_MOUSE_HISTORY,
+};
+
 typedef SI_ENUM(i64, siCursorType) {
 	SI_CURSOR_ARROW = 1,
 	SI_CURSOR_HAND,
@@ -291,6 +339,10 @@ typedef struct {
 	b32 windowMove          : 1;
 	b32 windowFocusChange   : 1;
 	b32 windowMouseChange   : 1;
+
+	b32 user                : 1;
+	b32 clipboard           : 1;
+	b32 mouseRaw            : 1;
 } siEventType;
 SI_STATIC_ASSERT(sizeof(siEventType) == 4); /* NOTE(EimaMei): If the type becomes
 											   larger than 4 bytes, parts of the
@@ -314,6 +366,13 @@ typedef SI_ENUM(u32, siEventTypeEnum) {
 	SI_EVENT_WINDOW_FOCUS,
 	SI_EVENT_WINDOW_MOUSE_CHANGE,
 
+	/* Posted with 'siapp_windowPostEvent'. */
+	SI_EVENT_USER,
+	/* Text requested with 'siapp_clipboardTextRequest' has arrived. */
+	SI_EVENT_CLIPBOARD,
+	/* A single raw mouse sample, see 'siapp_windowRawMouseSet'. */
+	SI_EVENT_MOUSE_RAW,
+
 	SI_EVENT_COUNT
 };
 
@@ -323,6 +382,33 @@ typedef struct {
 	b8 released : 1;
 } siKeyState;
 
+/* A bit for every key, see 'siapp_keySet'. */
+typedef struct {
+	u64 bits[(SK_COUNT + 63) / 64];
+} siKeySet;
+
+
+typedef SI_ENUM(u32, siClipboardState) {
+	/* Nothing has been requested yet. */
+	SI_CLIPBOARD_IDLE = 0,
+	/* The text is still arriving. */
+	SI_CLIPBOARD_RECEIVING,
+	/* The whole text has arrived. */
+	SI_CLIPBOARD_DONE,
+	/* The clipboard has no text or its owner refused to give it. */
+	SI_CLIPBOARD_FAILED,
+};
+
+typedef struct {
+	siClipboardState state;
+	/* The text that has arrived so far, always NUL-terminated. Stays valid until
+	 * the next request or until the window gets closed. */
+	char* text;
+	usize len;
+
+	usize __capacity;
+	b32 __incr;
+} siClipboardText;
 
 typedef struct {
 	siEventType type;
@@ -331,7 +417,12 @@ typedef struct {
 	usize charBufferLen;
 
 	siKeyType curKey;
-	siKeyState keys[SK_COUNT];
+	/* Keys that got pressed down this update. */
+	siKeySet keysClicked;
+	/* Keys that are being held down. */
+	siKeySet keysPressed;
+	/* Keys that got released this update. */
+	siKeySet keysReleased;
 
 	b32 focus;
 	b32 mouseInside;
@@ -341,20 +432,34 @@ typedef struct {
 	siPoint mouseRoot;
 
 	siMouseButtonType curMouse;
-	siKeyState mouseButtons[SI_MOUSE_COUNT];
+	/* Bit 'button - 1' of each is set in the same way as the key sets. */
+	u32 mouseClicked;
+	u32 mousePressed;
+	u32 mouseReleased;
 
 	siMouseWheelType mouseWheel;
+	/* Raw mouse motion of this update in unaccelerated, sub-pixel units. Only
+	 * set while 'siapp_windowRawMouseSet' is on. */
+	siVec2 mouseDelta;
+	/* Scrolling of this update in wheel notches, fractions included. Positive
+	 * is down and right. Only set while 'siapp_windowRawMouseSet' is on. */
+	siVec2 mouseScroll;
 
 	siPoint windowPos;
 	siArea windowSize;
 
+	/* Text of the latest 'siapp_clipboardTextRequest'. */
+	siClipboardText clipboard;
+
+	/* Nanoseconds since the window was created. */
 	f64 curTime;
+	/* Nanoseconds between the latest two updates. */
 	f64 timeDelta;
+	/* 'timeDelta' averaged over the latest updates, with stalls clamped. */
+	f64 timeDeltaSmooth;
 
-	struct {
-		siKeyType keyCache[16];
-		usize keyCacheLen;
-	} __private;
+	/* If the window should be rendered this update, see 'siapp_windowRequestRedraw'. */
+	b32 needsRedraw;
 } siWindowEvent;
 
 
@@ -363,6 +468,30 @@ typedef union {
 	siVec4 column[4];
 } siMatrix;
 
+/* Counters of the work a renderer has done since they were last reset. Defining
+ * 'SIAPP_DISABLE_COUNTERS' compiles the counting out, leaving them at zero. */
+typedef struct {
+	/* OpenGL */
+	/* Draw commands submitted to the GPU. */
+	u32 draws;
+	/* Vertices submitted to the GPU. */
+	u32 vertices;
+	/* Batches that had to be submitted early from inside of a draw function. */
+	u32 flushes;
+	/* Draws that couldn't be merged into the previous draw command. */
+	u32 batchBreaks;
+	/* Bytes of texture data uploaded to the GPU. */
+	u64 uploadBytes;
+
+	/* CPU */
+	/* Pixels written by draws. */
+	u64 pixelsFilled;
+	/* Pixels out of those that had to be blended with the buffer. */
+	u64 pixelsBlended;
+	/* Pixels copied onto the window. */
+	u64 pixelsPresented;
+} siRenderCounters;
+
 typedef struct {
 	siRenderingType render;
 
@@ -381,6 +510,8 @@ typedef struct {
 	u32 totalWidth;
 
 	u32 curCount;
+	/* Counters of the window the atlas was made for. */
+	siRenderCounters* counters;
 } siTextureAtlas;
 
 typedef struct {
@@ -416,6 +547,8 @@ typedef struct {
 	u32 firstIndex;
 	i32 baseVertex;
 	u32 baseInstance;
+	/* Primitive type of the command (GL_TRIANGLES or GL_TRIANGLE_FAN). */
+	u32 mode;
 } siOpenGLDrawCMD;
 
 typedef struct {
@@ -423,6 +556,325 @@ typedef struct {
 	u32 matrixID;
 } siOpenGLIDs;
 
+typedef struct {
+	/* Size of the whole buffer in bytes. */
+	usize size;
+	/* Size of a single mapped region in bytes. */
+	usize regionSize;
+	/* Offset of the currently mapped region. */
+	usize offset;
+	/* Mapping of the whole buffer, set only for persistently mapped buffers. */
+	siByte* mapping;
+} siOpenGLStream;
+
+typedef struct {
+	/* Position in pixels, before the transform gets applied. */
+	f32 x, y;
+	/* Normalized texture coordinates, from 0 to 'UINT16_MAX'. */
+	u16 u, v;
+	/* Colour of the vertex, multiplied with the texture's. */
+	siColor color;
+} siOpenGLVertex;
+SI_STATIC_ASSERT(sizeof(siOpenGLVertex) == 16);
+
+typedef struct {
+	/* Most vertices a single frame has drawn. */
+	u32 peakVertices;
+	/* Most draw commands a single frame has issued. */
+	u32 peakDraws;
+	/* How many times a batch had to be submitted early because it ran out of space. */
+	u32 flushes;
+	/* How many times the batch storage got reallocated. */
+	u32 grows;
+	/* Current capacity of the batch. */
+	u32 maxVertexCount;
+	u32 maxDrawCount;
+} siOpenGLBatchStats;
+
+#if !defined(SI_OPENGL_TRANSFORM_DEPTH)
+	/* How many transforms can be pushed onto the stack. */
+	#define SI_OPENGL_TRANSFORM_DEPTH 16
+#endif
+
+#if !defined(SI_OPENGL_MATRIX_COUNT)
+	/* How many unique transforms a single batch can reference. */
+	#define SI_OPENGL_MATRIX_COUNT 32
+#endif
+
+#if !defined(SI_CLIP_DEPTH)
+	/* How many clip rectangles can be pushed onto the stack. */
+	#define SI_CLIP_DEPTH 16
+#endif
+
+#if !defined(SI_OPENGL_TIMER_FRAMES)
+	/* How many frames the GPU gets to finish a frame's timer queries in before
+	 * they're read back. */
+	#define SI_OPENGL_TIMER_FRAMES 4
+#endif
+
+#if !defined(SI_OPENGL_TIMER_PASSES)
+	/* How many render passes of a single frame get their own timer query. Any
+	 * passes after that share the last query. */
+	#define SI_OPENGL_TIMER_PASSES 8
+#endif
+
+#if !defined(SI_FRAME_HISTORY)
+	/* How many of the latest frames the frame statistics are made from. */
+	#define SI_FRAME_HISTORY 128
+#endif
+
+#if !defined(SI_FRAME_CLOCK_SMOOTHING)
+	/* How much of every new delta goes into 'timeDeltaSmooth', from 0 to 1. */
+	#define SI_FRAME_CLOCK_SMOOTHING 0.1
+#endif
+#if !defined(SI_FRAME_CLOCK_MAX_DELTA)
+	/* The longest delta in nanoseconds that 'timeDeltaSmooth' takes in. */
+	#define SI_FRAME_CLOCK_MAX_DELTA 250000000
+#endif
+
+#if !defined(SI_FRAME_PACER_SPIN)
+	/* How many nanoseconds before a deadline the frame pacer stops sleeping
+	 * and spins instead, as sleeps tend to overshoot by about that much. */
+	#define SI_FRAME_PACER_SPIN 500000
+#endif
+
+#if !defined(SI_EVENT_QUEUE_CAPACITY)
+	/* How many events a window keeps until they get read with
+	 * 'siapp_windowEventNext'. Enough for a 1000 Hz mouse at 4 FPS. */
+	#define SI_EVENT_QUEUE_CAPACITY 256
+#endif
+
+#if !defined(SI_WINDOW_FD_COUNT)
+	/* How many file descriptors 'siapp_windowUpdateTimeout' can wait on besides
+	 * the display server, at most 24. */
+	#define SI_WINDOW_FD_COUNT 8
+#endif
+#if SI_WINDOW_FD_COUNT > 24
+	#error "SI_WINDOW_FD_COUNT cannot be bigger than 24."
+#endif
+
+#if !defined(SI_USER_EVENT_CAPACITY)
+	/* How many events 'siapp_windowPostEvent' can queue up before the window
+	 * gets updated. Must be a power of two. */
+	#define SI_USER_EVENT_CAPACITY 64
+#endif
+#if (SI_USER_EVENT_CAPACITY & (SI_USER_EVENT_CAPACITY - 1)) != 0
+	#error "SI_USER_EVENT_CAPACITY must be a power of two."
+#endif
+
+#if !defined(SI_CLIPBOARD_INCR_COUNT)
+	/* How many applications can incrementally read the clipboard from a
+	 * window at the same time on X11. */
+	#define SI_CLIPBOARD_INCR_COUNT 4
+#endif
+#if !defined(SI_CLIPBOARD_INCR_TIMEOUT)
+	/* How many milliseconds an incremental clipboard read can go without any
+	 * progress before it gets dropped on X11. */
+	#define SI_CLIPBOARD_INCR_TIMEOUT 5000
+#endif
+
+typedef SI_ENUM(u32, siFrameTime) {
+	/* Time spent inside of 'siapp_windowUpdate'. */
+	SI_FRAME_TIME_EVENTS = 0,
+	/* Time not spent in any of the other phases, which is mostly the app
+	 * building its batches. */
+	SI_FRAME_TIME_BUILD,
+	/* Time spent copying batches into GPU buffers. */
+	SI_FRAME_TIME_UPLOAD,
+	/* Time spent issuing draw commands, or presenting the buffer on the CPU. */
+	SI_FRAME_TIME_SUBMIT,
+	/* Time spent inside of 'siapp_windowSwapBuffers'. */
+	SI_FRAME_TIME_SWAP,
+	/* Time the GPU spent on the render passes of a frame. Only available on
+	 * OpenGL 3.3 and above and always a few frames behind. */
+	SI_FRAME_TIME_GPU,
+	/* Time between two swaps. */
+	SI_FRAME_TIME_TOTAL,
+
+	SI_FRAME_TIME_COUNT
+};
+
+typedef struct {
+	/* Every time is in nanoseconds. */
+	u64 last;
+	u64 average;
+	u64 p50;
+	u64 p95;
+	u64 p99;
+	u64 max;
+	/* How many frames the statistics were taken from. */
+	u32 samples;
+} siFrameTiming;
+
+typedef struct {
+	siFrameTiming times[SI_FRAME_TIME_COUNT];
+	/* Frames that the frame pacer couldn't present on time. */
+	u32 missedDeadlines;
+} siFrameStats;
+
+typedef struct {
+	u64 samples[SI_FRAME_TIME_COUNT][SI_FRAME_HISTORY];
+	u32 len[SI_FRAME_TIME_COUNT];
+	u32 next[SI_FRAME_TIME_COUNT];
+
+	/* Times of the frame that's currently being made. */
+	u64 current[SI_FRAME_TIME_COUNT];
+	u64 frameStart;
+} siFrameHistory;
+
+typedef struct {
+	/* Monotonic times in nanoseconds. */
+	u64 start;
+	u64 last;
+} siFrameClock;
+
+typedef struct {
+	/* Length of a frame in nanoseconds, 0 if the frames aren't paced. */
+	u64 interval;
+	/* When the next frame should be presented, 0 if there's no frame to go by. */
+	u64 deadline;
+	u32 missed;
+#if defined(SIAPP_PLATFORM_API_WIN32)
+	HANDLE timer;
+#endif
+} siFramePacer;
+
+typedef SI_ENUM(i32, siVSyncMode) {
+	SI_VSYNC_OFF = 0,
+	SI_VSYNC_ON = 1,
+	/* Syncs like 'SI_VSYNC_ON', except that a frame which misses the vertical
+	 * blank gets shown right away instead of on the next one. */
+	SI_VSYNC_ADAPTIVE = -1,
+};
+
+typedef struct {
+	siEventTypeEnum type;
+	/* Time of the event in milliseconds as given by the platform, 0 if it
+	 * doesn't give one. Only comparable with other server times. */
+	u32 serverTime;
+	/* When the event got read in nanoseconds, on the same clock as 'curTime'. */
+	u64 time;
+
+	/* The key of 'SI_EVENT_KEY_PRESS' and 'SI_EVENT_KEY_RELEASE'. */
+	siKeyType key;
+	/* The button of 'SI_EVENT_MOUSE_PRESS' and 'SI_EVENT_MOUSE_RELEASE', the
+	 * wheel of 'SI_EVENT_MOUSE_SCROLL'. */
+	u32 button;
+	/* The mouse position of mouse events, the window position of
+	 * 'SI_EVENT_WINDOW_MOVE' and the size of 'SI_EVENT_WINDOW_RESIZE'. */
+	siPoint pos;
+	/* The new state of 'SI_EVENT_WINDOW_FOCUS' and 'SI_EVENT_WINDOW_MOUSE_CHANGE',
+	 * if a 'SI_EVENT_KEY_PRESS' is a repeat, or if a 'SI_EVENT_CLIPBOARD' is the
+	 * last one of its transfer. */
+	b32 state;
+	/* The payload of 'SI_EVENT_USER'. */
+	rawptr data;
+	/* The motion and scrolling of 'SI_EVENT_MOUSE_RAW', in the same units as
+	 * 'siWindowEvent.mouseDelta' and 'siWindowEvent.mouseScroll'. */
+	siVec2 delta;
+	siVec2 scroll;
+} siEvent;
+
+typedef struct {
+	siEvent events[SI_EVENT_QUEUE_CAPACITY];
+	/* Index of the oldest unread event. */
+	u32 head;
+	u32 len;
+	/* How many events got overwritten before they were read. */
+	u32 dropped;
+} siEventQueue;
+
+#if defined(SIAPP_PLATFORM_API_WIN32)
+/* Any handle that 'WaitForMultipleObjects' can wait on. */
+typedef HANDLE siFd;
+#else
+typedef i32 siFd;
+#endif
+
+typedef SI_ENUM(u32, siWaitSource) {
+	/* The display server has new events. */
+	SI_WAIT_EVENTS = SI_BIT(0),
+	/* 'siapp_windowWake' or 'siapp_windowPostEvent' got called. */
+	SI_WAIT_WAKE = SI_BIT(1),
+	/* The first registered file descriptor became readable. The one at index
+	 * 'n' is 'SI_WAIT_FD << n'. */
+	SI_WAIT_FD = SI_BIT(8),
+};
+
+typedef struct {
+	siFd fds[SI_WINDOW_FD_COUNT];
+	/* Bit mask of the indices that have a descriptor. */
+	u32 used;
+} siWaitSet;
+
+typedef struct {
+	rawptr data;
+	/* Tells which lap of the ring the slot is on, see 'siapp_windowPostEvent'. */
+	u32 sequence;
+} siUserEventSlot;
+
+typedef struct {
+	siUserEventSlot slots[SI_USER_EVENT_CAPACITY];
+	/* Claimed by the posting threads. */
+	u32 tail;
+	/* Only touched by the thread that updates the window. */
+	u32 head;
+
+	/* Read and write ends of the wake up pipe. Both are the same eventfd on
+	 * Linux and the same event on Windows. */
+	siFd wake[2];
+} siUserEventQueue;
+
+typedef struct {
+	/* Depth of the draws inside the tile plus one, 0 if the tile is empty. */
+	u32 depth;
+	/* State of the draws at that depth. */
+	u32 state;
+} siOpenGLTile;
+
+typedef struct {
+	/* Staging vertices the draws get recorded into. */
+	siOpenGLVertex* vertices;
+	/* Mapped GPU vertices the sorted draws get copied into. */
+	siOpenGLVertex* mapped;
+
+	/* Sort key of every recorded draw. */
+	u64* keys;
+	u64* keysTmp;
+	u32* order;
+	u32* orderTmp;
+	siOpenGLDrawCMD* CMDs;
+
+	/* Coarse grid that tracks which draws overlap. */
+	siOpenGLTile* tiles;
+	u32 tilesWidth;
+	u32 tilesHeight;
+} siOpenGLDeferred;
+
+typedef struct {
+	u32 vertexCount;
+	u32 texID;
+	u32 type;
+} siOpenGLRecorded;
+
+typedef struct {
+	/* Vertices and primitives recorded so far. */
+	siOpenGLVertex* vertices;
+	siOpenGLRecorded* prims;
+	u32 primLen;
+	u32 primCap;
+
+	/* Batch state that gets restored once the recording ends. */
+	siOpenGLVertex* mapped;
+	u32 maxVertexCount;
+} siOpenGLRecording;
+
+#if !defined(SI_OPENGL_STREAM_REGIONS)
+	/* How many batches fit inside a vertex buffer before it gets orphaned
+	 * (GL 3.3) or before the oldest one has to be waited on (GL 4.4). */
+	#define SI_OPENGL_STREAM_REGIONS 4
+#endif
+
 typedef struct {
 	siAllocator* alloc;
 	rawptr context;
@@ -430,13 +882,16 @@ typedef struct {
 
 	u32 programID;
 	u32 VAO;
-	u32 VBOs[5];
+	u32 VBOs[3];
+	siOpenGLStream streams[2];
+	rawptr fences[SI_OPENGL_STREAM_REGIONS];
 
 	i32 uniformTexture;
 	i32 uniformMvp;
+	i32 uniformProjection;
 
-	siVec4 curColor;
-	siVec2 curTexCoords;
+	siColor curColor;
+	u16 curTexCoords[2];
 	siVec4 rotation;
 	siVec4 bgColor;
 
@@ -446,17 +901,42 @@ typedef struct {
 	siImage* curTex;
 	siImage defaultTex;
 
-	siVec3* vertices;
-	siVec4* colors;
-	siVec2* texCoords;
+	siOpenGLVertex* vertices;
 	siOpenGLIDs* batchInfo;
 	siMatrix* matrices;
 	siOpenGLDrawCMD* CMDs;
 
 	u32 vertexCounter;
 	u32 drawCounter;
+	u32 matrixCounter;
+	b32 matrixUsed;
+	siOpenGLIDs lastIDs;
 
 	u32 maxVertexCount;
+	u32 maxDrawCount;
+
+	u32 frameVertices;
+	u32 frameDraws;
+	siOpenGLBatchStats stats;
+
+	siMatrix transforms[SI_OPENGL_TRANSFORM_DEPTH];
+	u32 transformLen;
+
+	siOpenGLDeferred* deferred;
+	u32 layer;
+
+	siOpenGLRecording* recording;
+	/* Size of the layer that is being drawn into, zero for the window. */
+	siArea target;
+
+	u32 timerQueries[SI_OPENGL_TIMER_FRAMES][SI_OPENGL_TIMER_PASSES];
+	u32 timerPasses[SI_OPENGL_TIMER_FRAMES];
+	/* Bit mask of the frames whose queries haven't been read yet. */
+	u32 timerPending;
+	u32 timerFrame;
+	b32 timerActive;
+
+	siRenderCounters counters;
 } siWinRenderingCtxOpenGL;
 
 typedef struct {
@@ -474,10 +954,14 @@ typedef struct {
 	u32 width;
 
 	siColor bgColor;
-	u32 fps;
 
 	const siColor* gradient;
 	usize gradientLen;
+
+	/* Black and white scratch buffers of the draw list that is being recorded. */
+	siByte* recording[2];
+
+	siRenderCounters counters;
 } siWinRenderingCtxCPU;
 
 typedef struct {
@@ -509,6 +993,27 @@ typedef struct {
 	siArea originalSize;
 	u32 maxDrawCount;
 
+	siVec4 clips[SI_CLIP_DEPTH];
+	u32 clipLen;
+	/* Clips below the base belong to the target a layer was started from. */
+	u32 clipBase;
+
+	siFrameHistory frameHistory;
+	siFrameClock clock;
+	siFramePacer pacer;
+	siEventQueue events;
+	siWaitSet waitSet;
+	siUserEventQueue userEvents;
+
+	/* Set by 'siapp_windowRequestRedraw' and by every event until the next
+	 * update consumes it. A request made while drawing the frame carries over
+	 * to the next one. */
+	b32 redraw;
+	/* Time on the 'curTime' clock until which every update needs a frame. */
+	f64 animateUntil;
+
+	siRawMouseMode rawMouse;
+
 	siCursorType cursor;
 	b32 cursorSet;
 
@@ -517,12 +1022,64 @@ typedef struct {
 	siRect rectBeforeFullscreen;
 #if defined(SIAPP_PLATFORM_API_X11)
 	Cursor __x11BlankCursor;
+	siEventType __x11LastType;
 	XIC __x11Xic;
 #elif defined(SIAPP_PLATFORM_API_WIN32)
 	IDropTarget __win32DropTarget;
 #endif
 } siWindow;
 
+typedef struct {
+	/* Offset of the first pixel inside the buffer in bytes. */
+	u32 index;
+	/* Length of the span in pixels. */
+	u32 len;
+	/* Index of the first pixel inside 'siDrawList.pixels'. */
+	u32 pixel;
+	/* Every pixel of the span is the same, so only one is stored. */
+	b32 solid;
+} siCPUSpan;
+
+typedef struct {
+	siRenderingType render;
+
+	/* OpenGL */
+	u32 VAO;
+	u32 VBOs[3];
+	siOpenGLDrawCMD* CMDs;
+	u32 CMDLen;
+
+	/* CPU */
+	siCPUSpan* spans;
+	u32 spanLen;
+	/* Premultiplied pixels in the channel order of the buffer. */
+	siColor* pixels;
+	siArea size;
+} siDrawList;
+
+typedef struct {
+	/* Image of the layer, drawn like any other image. */
+	siImage image;
+	/* Whether the contents of the layer have to be drawn again. */
+	b32 invalid;
+
+	/* OpenGL */
+	u32 FBO;
+	i32 viewport[4];
+	/* The framebuffer and target that were being drawn into before the layer,
+	 * so that layers can be nested. */
+	i32 prevFBO;
+	siArea prevTarget;
+
+	/* CPU */
+	siByte* scratch[2];
+	u32 width;
+	siArea windowSize;
+	siVec2 scaleFactor;
+
+	u32 clipBase;
+} siLayer;
+
 typedef SI_ENUM(i32, siWindowShowState) {
 	SI_SHOW_HIDE = 0,
 	SI_SHOW_ACTIVATE,
@@ -623,6 +1180,57 @@ typedef struct {
 	} advance;
 } siFont;
 
+typedef struct {
+	/* Byte offset of the break opportunity inside the paragraph. */
+	u32 index;
+	/* Width of the paragraph up to the break opportunity. */
+	f32 width;
+	/* Width of the paragraph up to the last non-space character before the
+	 * break opportunity. */
+	f32 trimmed;
+} siTextBreak;
+
+typedef struct {
+	/* Byte offset of the line inside the text. */
+	usize start;
+	/* Length of the line in bytes, including the trailing spaces. */
+	usize len;
+	/* Width of the line without the trailing spaces. */
+	f32 width;
+} siTextLine;
+
+typedef struct {
+	usize start;
+	usize len;
+	u64 hash;
+	f32 maxWidth;
+
+	siTextBreak* breaks;
+	u32 breakLen;
+	u32 breakCap;
+
+	siTextLine* lines;
+	u32 lineLen;
+	u32 lineCap;
+
+	usize firstLine;
+} siTextParagraph;
+
+typedef struct {
+	siFont* font;
+	u32 size;
+	f32 maxWidth;
+
+	siTextParagraph* paragraphs;
+	usize paragraphLen;
+	usize paragraphCap;
+
+	/* Total amount of wrapped lines. */
+	usize lineCount;
+	/* Height of a single line. */
+	f32 lineHeight;
+} siTextLayout;
+
 
 #define SI_GLYPHSET_ASCII                {0x0020, 0x007E}
 #define SI_GLYPHSET_ISO_8859_1           {0x00A0, 0x00FF}
@@ -769,15 +1377,69 @@ siWindow* siapp_windowMake(cstring name, siArea size, siWindowArg arg);
 /* Creates a windows based on the specified name, position, size and arguments,
  * returns a 'siWindow' object. */
 siWindow* siapp_windowMakeEx(cstring name, siPoint pos, siArea area, siWindowArg arg);
+/* Creates a headless window of the specified size, which only draws into its
+ * own pixel buffer. It never connects to the display server, so it works on
+ * machines without one and separate headless windows can be drawn into from
+ * different threads. Only 'SI_RENDERING_CPU' is supported, and only the
+ * rendering, drawing, font and texture functions can be used with it. */
+siWindow* siapp_windowMakeHeadless(siArea size, siWindowArg arg);
 
 /* Checks the changes for the specified window and updates the contents of 'out'. */
 const siWindowEvent* siapp_windowUpdate(siWindow* win, b32 await);
+/* Updates every window at once, reading the display server's events only once
+ * and handing each of them to the window it's for. 'await' waits until any
+ * window has new events or gets woken up. Headless windows aren't included.
+ * NOTE(EimaMei): A window shouldn't be updated from 'siapp_windowUpdate' and
+ * this at the same time. */
+void siapp_appUpdate(b32 await);
+/* Waits up to 'timeout' nanoseconds until the display server sends new events
+ * or a registered file descriptor becomes readable, then updates the window
+ * like 'siapp_windowUpdate'. A negative timeout waits indefinitely and 0 doesn't
+ * wait at all. Returns the sources that fired, 0 if it timed out.
+ * NOTE(EimaMei): Windows only waits with a precision of milliseconds and
+ * reports one handle at a time. On macOS the descriptors are only checked once
+ * the wait is over, so they can't end it early. */
+siWaitSource siapp_windowUpdateTimeout(siWindow* win, i64 timeout);
+/* Registers a file descriptor for 'siapp_windowUpdateTimeout' to wait on. Returns
+ * its index, or -1 if 'SI_WINDOW_FD_COUNT' of them are already registered. */
+i32 siapp_windowFdAdd(siWindow* win, siFd fd);
+/* Unregisters the file descriptor. Other descriptors keep their indices. */
+void siapp_windowFdRemove(siWindow* win, siFd fd);
+/* Queues a 'SI_EVENT_USER' event with the payload and wakes up the window. Can be
+ * called from any thread without locking. Returns false if 'SI_USER_EVENT_CAPACITY'
+ * events are already waiting. */
+b32 siapp_windowPostEvent(siWindow* win, rawptr data);
+/* Wakes up the window if it's waiting inside of 'siapp_windowUpdate' or
+ * 'siapp_windowUpdateTimeout', otherwise the next wait returns right away. Can
+ * be called from any thread. */
+void siapp_windowWake(siWindow* win);
+/* Makes the next update (or the current one, if it has already happened) set
+ * 'needsRedraw' and keeps 'siapp_windowUpdate' from waiting. Events, exposes
+ * and resizes do this by themselves. */
+void siapp_windowRequestRedraw(siWindow* win);
+/* Makes every update set 'needsRedraw' until 'curTime' reaches 'time'. Only
+ * ever extends the animation. */
+void siapp_windowAnimateUntil(siWindow* win, f64 time);
 /* Writes new graphics into the current draw buffer. */
 void siapp_windowRender(siWindow* win);
 /* Clears the graphics of the screen. */
 void siapp_windowClear(const siWindow* win);
 /* Renders the graphics onto the screen and clears the current buffer. */
 void siapp_windowSwapBuffers(siWindow* win);
+/* Returns the timings of the latest frames, where a frame ends with
+ * 'siapp_windowSwapBuffers'. */
+siFrameStats siapp_windowFrameStatsGet(const siWindow* win);
+/* Returns the counters of the window's renderer since they were last reset. */
+siRenderCounters siapp_windowCountersGet(const siWindow* win);
+/* Resets the counters of the window's renderer, usually done once per frame. */
+void siapp_windowCountersReset(siWindow* win);
+
+/* Copies the pixels of the region into 'out' as tightly packed RGB bytes. The
+ * buffer must be at least 'width * height * 3' bytes big. */
+void siapp_windowPixelsRead(const siWindow* win, siRect region, siByte* out);
+/* Encodes the current contents of the window into an image file by using
+ * 'SIAPP_IMAGE_WRITE'. Returns false if the file couldn't be written. */
+b32 siapp_windowImageWrite(const siWindow* win, cstring path);
 
 /* Closes the window. */
 void siapp_windowClose(siWindow* win);
@@ -793,9 +1455,20 @@ void siapp_windowShow(siWindow* win, siWindowShowState state);
 /* Turns on fulscreen for the app depending on the boolean. */
 void siapp_windowFullscreen(siWindow* win, b32 fullscreen);
 
-/* Sets the vertical synchronization for the window depending on the boolean. Returns
- * a boolean indicating if the change was successful. */
-b32 siapp_windowVSyncSet(siWindow* win, b32 value);
+/* Sets the vertical synchronization for the window. Returns a boolean indicating
+ * if the change was successful. 'SI_VSYNC_ADAPTIVE' needs 'GLX_EXT_swap_control_tear'
+ * or 'WGL_EXT_swap_control_tear', without it 'SI_VSYNC_ON' gets used and false
+ * is returned. The CPU renderer paces itself to the screen's refresh rate instead. */
+b32 siapp_windowVSyncSet(siWindow* win, siVSyncMode mode);
+/* Paces 'siapp_windowSwapBuffers' to the specified rate by sleeping out the
+ * rest of every frame, 0 turns the pacing off. Late frames get counted in
+ * 'siFrameStats.missedDeadlines'. */
+void siapp_windowFrameRateSet(siWindow* win, f64 fps);
+/* Sets how the window receives raw mouse input. Motion only arrives while the
+ * window has focus, scrolling while the mouse is inside of it. Returns false if
+ * raw input isn't supported.
+ * NOTE(EimaMei): Only supported on X11 with XInput 2.1 or newer. */
+b32 siapp_windowRawMouseSet(siWindow* win, siRawMouseMode mode);
 /* Sets the window title bar to dark mode depending on the boolean. On other
  * platforms this does nothing. */
 void siapp_windowWin32DarkModeSet(siWindow* win, b32 lightMode);
@@ -821,10 +1494,26 @@ b32 siapp_windowKeyPressed(const siWindow* win, siKeyType key);
 b32 siapp_windowKeyReleased(const siWindow* win, siKeyType key);
 
 /* Returns true/false if the specified  keys are being pressed. */
-#define siapp_windowKeyMul(win, ...) \
-	siapp__internWindowKeyMul(win, (usize)countof(si_buf(i32, __VA_ARGS__)), __VA_ARGS__)
-/* DO NOT USE THIS INTERNAL FUNCTION! Use the 'siapp_windowKeyMul' macro instead. */
-b32 siapp__internWindowKeyMul(const siWindow* win, ...);
+#define siapp_windowKeyMul(win, ...) siapp_windowKeyAllPressed(win, siapp_keySet(__VA_ARGS__))
+
+/* Returns a key set of the specified keys. */
+#define siapp_keySet(...) \
+	siapp_keySetMake(si_buf(siKeyType, __VA_ARGS__), countof(si_buf(siKeyType, __VA_ARGS__)))
+/* Returns a key set of the first 'len' keys of the array. */
+siKeySet siapp_keySetMake(const siKeyType* keys, usize len);
+/* Returns a boolean indicating if the key is in the set. */
+b32 siapp_keySetHas(siKeySet set, siKeyType key);
+
+/* Returns a boolean indicating if any of the keys were clicked this frame. */
+b32 siapp_windowKeyAnyClicked(const siWindow* win, siKeySet keys);
+/* Returns a boolean indicating if any of the keys were released this frame. */
+b32 siapp_windowKeyAnyReleased(const siWindow* win, siKeySet keys);
+/* Returns a boolean indicating if every one of the keys is being pressed. */
+b32 siapp_windowKeyAllPressed(const siWindow* win, siKeySet keys);
+/* Returns true on the frame the chord gets completed, meaning that every key
+ * is being pressed and at least one of them was clicked this frame. If 'exact'
+ * is set, no other key may be pressed either. */
+b32 siapp_windowKeyChord(const siWindow* win, siKeySet keys, b32 exact);
 
 /* Returns the current state of the specified mouse button. */
 siKeyState siapp_windowMouseKeyGet(const siWindow* win, siMouseButtonType key);
@@ -839,6 +1528,10 @@ b32 siapp_windowMouseKeyReleased(const siWindow* win, siMouseButtonType key);
 const siWindowEvent* siapp_windowEventGet(const siWindow* win);
 /* */
 b32 siapp_windowEventPoll(const siWindow* win, siEventTypeEnum* out);
+/* Removes the oldest queued event of the window and writes it into 'out'.
+ * Unlike the 'siWindowEvent' snapshot, the queue keeps every event in the order
+ * they happened. Returns false if the queue is empty. */
+b32 siapp_windowEventNext(siWindow* win, siEvent* out);
 
 /* Returns the current cursor type for the window. */
 siCursorType siapp_windowCursorGet(const siWindow* win);
@@ -889,9 +1582,18 @@ void siapp_mouseShow(b32 show);
 void siapp_mouseMove(siPoint pos);
 
 
-/* */
+/* Copies the clipboard's text into the buffer, waiting until all of it has
+ * arrived. Returns the length of the copied text. */
 usize siapp_clipboardTextGet(char* outBuffer, usize capacity);
-/* */
+/* Starts reading the clipboard's text without waiting for it. The text arrives
+ * through the window's updates in 'siWindowEvent.clipboard', each part with a
+ * 'SI_EVENT_CLIPBOARD' event. Returns false if a request is still in progress.
+ * NOTE(EimaMei): Large texts are sent in chunks on X11, other platforms get all
+ * of it at once. */
+b32 siapp_clipboardTextRequest(siWindow* win);
+/* Makes the text the clipboard's content.
+ * NOTE(EimaMei): X11 has no clipboard of its own, so on it the windows have to
+ * keep being updated for other applications to be able to read the text. */
 b32 siapp_clipboardTextSet(cstring text);
 /* */
 usize siapp_clipboardTextLen(void);
@@ -983,7 +1685,8 @@ void siapp_fontFree(siFont font);
 
 /* Draws a vertex with the two specified NDC floats. */
 void siapp_drawVertex2f(siWindow* win, f32 x, f32 y);
-/* Draws a vertex with the three specified NDC floats. */
+/* Draws a vertex with the three specified NDC floats.
+ * NOTE: The Z coordinate is ignored, draws are ordered by when they're made. */
 void siapp_drawVertex3f(siWindow* win, f32 x, f32 y, f32 z);
 
 /* Draws a rectangle based on the specified 'siRect' and color. */
@@ -1025,13 +1728,37 @@ void siapp_drawPolygonF(siWindow* win, siVec4 rect, u32 sides, siColor color);
 f32 siapp_drawText(siWindow* win, cstring text, siFont* font, siPoint pos, u32 size);
 /* Draws the text based on the specified NULL-terminated string and siVec2 position. */
 f32 siapp_drawTextF(siWindow* win, cstring text, siFont* font, siVec2 pos, u32 size);
-/* */
+/* Draws the text based on the specified NULL-terminated string and siPoint
+ * position, wrapping the words that would go past the X coordinate 'maxWidth'. */
 f32 siapp_drawTextWithWrap(siWindow* win, cstring text, siFont* font, siPoint pos,
 		u32 size, i32 maxWidth);
-/* */
+/* Draws the text based on the specified NULL-terminated string and siVec2
+ * position, wrapping the words that would go past the X coordinate 'maxWidth'.
+ * The line breaks are kept between calls, so redrawing the same text only
+ * re-measures the paragraphs that have changed. */
 f32 siapp_drawTextWithWrapF(siWindow* win, cstring text, siFont* font, siVec2 pos,
 		u32 size, f32 maxWidth);
 
+/* Creates an empty line-break index for text drawn with the specified font and size. */
+siTextLayout siapp_textLayoutMake(siFont* font, u32 size);
+/* Re-indexes the text. Every paragraph gets hashed, but only the ones whose text
+ * or wrap width is new get re-laid-out, no matter where they've moved to. */
+void siapp_textLayoutUpdate(siTextLayout* layout, cstring text, usize len, f32 maxWidth);
+/* Re-indexes the text after 'removed' bytes at 'start' were replaced with
+ * 'inserted' new bytes. Only the paragraphs that contain the edit get hashed. */
+void siapp_textLayoutEdit(siTextLayout* layout, cstring text, usize len, usize start,
+		usize removed, usize inserted);
+/* Returns the index of the wrapped line at the specified vertical scroll offset. */
+usize siapp_textLayoutLineFind(const siTextLayout* layout, f32 offsetY);
+/* Returns the wrapped line at the specified index in O(log n). */
+siTextLine siapp_textLayoutLineGet(const siTextLayout* layout, usize line);
+/* Frees the layout. */
+void siapp_textLayoutFree(siTextLayout* layout);
+/* Draws only the lines of the layout that are visible between 'scrollY' and
+ * 'scrollY + height'. The text must be the same as the last update's. */
+f32 siapp_drawTextLayout(siWindow* win, const siTextLayout* layout, cstring text,
+		siVec2 pos, f32 scrollY, f32 height);
+
 /* */
 f32 siapp_drawCharacter(siWindow* win, const siFont* font, const siGlyphInfo* glyph,
 		siVec2 pos, u32 size);
@@ -1050,9 +1777,74 @@ void siapp_color4f(siWindow* win, f32 r, f32 g, f32 b, f32 a);
  * values from 0.0f to 1.0f. */
 void siapp_colorVec4f(siWindow* win, siVec4 color);
 
-/* Sets the current texture coordinates for the window based on 2 NDC floats. */
+/* Sets the current texture coordinates for the window based on 2 NDC floats.
+ * NOTE: The coordinates get clamped between 0 and 1, so textures cannot be
+ * repeated with them. */
 void siapp_texCoords2f(siWindow* win, f32 x, f32 y);
 
+/* Pushes a copy of the current transform onto the stack.
+ * NOTE: Transforms are only supported by the OpenGL renderer. On legacy OpenGL
+ * the transform functions do nothing. */
+void siapp_transformPush(siWindow* win);
+/* Pops the current transform off the stack. */
+void siapp_transformPop(siWindow* win);
+/* Resets the current transform to the identity matrix. */
+void siapp_transformReset(siWindow* win);
+/* Translates the current transform by the specified amount of pixels. */
+void siapp_transformTranslate(siWindow* win, f32 x, f32 y);
+/* Scales the current transform. */
+void siapp_transformScale(siWindow* win, f32 x, f32 y);
+/* Rotates the current transform clockwise by the specified degrees. */
+void siapp_transformRotate(siWindow* win, f32 degrees);
+
+/* Enables or disables deferred drawing. Deferred draws get sorted by layer,
+ * texture and transform when the window is rendered, so that draws which don't
+ * overlap get merged no matter the order they were made in. Overlapping draws
+ * keep their order.
+ * NOTE: Only supported by the OpenGL renderer. */
+void siapp_windowDeferredSet(siWindow* win, b32 deferred);
+/* Sets the layer of the next deferred draws. Higher layers get drawn over lower
+ * ones. */
+void siapp_drawLayerSet(siWindow* win, u8 layer);
+
+/* Pushes a clip rectangle onto the stack, intersected with the current one.
+ * Draws get cut off at its edges and draws that are fully outside of it are
+ * skipped before any vertex or pixel work is done.
+ * NOTE: The rectangle is in window coordinates (layer coordinates inside of a
+ * layer) and ignores transforms. On OpenGL the clip cannot be changed while a
+ * draw list is being recorded. */
+void siapp_clipPush(siWindow* win, siRect rect);
+/* Pops the current clip rectangle off the stack. */
+void siapp_clipPop(siWindow* win);
+
+/* Starts recording the draws of the window into a draw list instead of drawing
+ * them. */
+void siapp_drawListBegin(siWindow* win);
+/* Stops the recording and returns the recorded list. On OpenGL the list lives in
+ * static GPU buffers, on the CPU it's a list of pre-clipped spans.
+ * NOTE: Transforms made while recording are ignored, the list gets drawn with
+ * the transform that's active when it's submitted. CPU lists only get drawn
+ * while the window has the same size as when they were recorded. */
+siDrawList siapp_drawListEnd(siWindow* win);
+/* Draws the list. */
+void siapp_drawListSubmit(siWindow* win, const siDrawList* list);
+/* Frees the list. */
+void siapp_drawListFree(siDrawList* list);
+
+/* Creates an offscreen layer of the specified size. Draws made between
+ * 'siapp_layerBegin' and 'siapp_layerEnd' go into the layer, which then gets
+ * drawn with 'siapp_drawImage(win, rect, layer.image)'. */
+siLayer siapp_layerMake(siWindow* win, siArea size);
+/* Starts drawing into the layer. Returns 'false' if the layer is still valid, in
+ * which case nothing has to be drawn and 'siapp_layerEnd' must not be called. */
+b32 siapp_layerBegin(siWindow* win, siLayer* layer);
+/* Stops drawing into the layer and marks it as valid. */
+void siapp_layerEnd(siWindow* win, siLayer* layer);
+/* Marks the layer to be drawn again on the next 'siapp_layerBegin'. */
+void siapp_layerInvalidate(siLayer* layer);
+/* Frees the layer. */
+void siapp_layerFree(siLayer* layer);
+
 
 /* */
 b32 siapp_windowRendererMake(siWindow* win, siRenderingType renderType,
@@ -1068,6 +1860,12 @@ void siapp_windowRendererDestroy(siWindow* win);
 b32 siapp_windowOpenGLInit(siWindow* win, u32 maxDrawCount, u32 maxTexCount, siArea maxTexRes);
 /* Renders the OpenGL graphics onto the screen. */
 void siapp_windowOpenGLRender(siWindow* win);
+/* Grows the batch so that it can hold at least the specified amount of vertices
+ * and draw commands. Pending graphics get rendered first. */
+void siapp_windowOpenGLBatchReserve(siWindow* win, u32 maxVertexCount, u32 maxDrawCount);
+/* Returns the batch statistics of the window. The batch grows by itself once a
+ * frame overflows it, the statistics can be used to size it upfront instead. */
+siOpenGLBatchStats siapp_windowOpenGLBatchStatsGet(const siWindow* win);
 /* Destroys the OpenGL context of the window. */
 void siapp_windowOpenGLDestroy(siWindow* win);
 
@@ -1099,6 +1897,18 @@ b32 siapp_OpenGLCurrentContextSet(const siWindow* win);
 b32 siapp_OpenGLCurrentContextExSet(rawptr window, rawptr context);
 
 
+/* Writes the trace zones of every thread into the file as Chrome trace JSON,
+ * which can be opened with 'chrome://tracing' or Perfetto. Every thread gets its
+ * own track. Returns false if the file couldn't be written or if tracing wasn't
+ * compiled in with 'SIAPP_TRACE'.
+ * NOTE: Zones that are recorded while the trace is being written may come out
+ * torn, so it's best to write it while the other threads are idle. */
+b32 siapp_traceWrite(cstring path);
+#if defined(SIAPP_TRACE)
+void siapp__traceBegin(cstring name);
+void siapp__traceEnd(void);
+#endif
+
 /* Opens an OS message box with the specified tittle, message, buttons and icons.
  * Returns the exact button that was selected. */
 siMessageBoxResult siapp_messageBox(cstring title, cstring message,
@@ -1122,6 +1932,14 @@ siMessageBoxResult siapp_messageBoxEx(siWindow* win, cstring title,
 #define WGL_ARB_multisample
 #include <include/sili/siligl.h> /* TODO(EimaMei): Remove this. */
 
+#if !defined(SIAPP_PLATFORM_API_WIN32)
+#include <poll.h>
+#include <fcntl.h>
+#endif
+#if defined(SI_SYSTEM_LINUX)
+#include <sys/eventfd.h>
+#endif
+
 #if defined(SIAPP_PLATFORM_API_COCOA)
 #define SICDEF
 #define GL_SILENCE_DEPRECATION
@@ -1160,10 +1978,200 @@ siMessageBoxResult siapp_messageBoxEx(siWindow* win, cstring title,
 
 #if 1 /* Common. */
 
-intern u32 SI_WINDOWS_NUM = 0;
+#if !defined(SIAPP_DISABLE_COUNTERS)
+	#define SI__COUNTER_ADD(counters, name, value) ((counters)->name += (value))
+#else
+	#define SI__COUNTER_ADD(counters, name, value) do { } while (0)
+#endif
+
+/* NOTE(EimaMei): Loads acquire, stores release, while additions and compare
+ * exchanges are relaxed. The compare exchange writes the current value into
+ * 'expected' when it fails. */
+#if defined(SI_GNUC_COMPLIANT)
+	#define SI__THREAD_LOCAL __thread
+
+	#define siapp__atomicLoad32(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+	#define siapp__atomicStore32(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+	#define siapp__atomicAdd32(ptr, value) __atomic_fetch_add(ptr, value, __ATOMIC_RELAXED)
+	#define siapp__atomicCas32(ptr, expected, desired) \
+		__atomic_compare_exchange_n(ptr, expected, desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+	#define siapp__atomicLoad64(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+	#define siapp__atomicStore64(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+	#define siapp__atomicLoadPtr(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+	#define siapp__atomicStorePtr(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+#elif defined(SI_COMPILER_MSVC)
+	#define SI__THREAD_LOCAL __declspec(thread)
+
+	#define siapp__atomicLoad32(ptr) (u32)InterlockedCompareExchange((volatile LONG*)(ptr), 0, 0)
+	#define siapp__atomicStore32(ptr, value) (void)InterlockedExchange((volatile LONG*)(ptr), (LONG)(value))
+	#define siapp__atomicAdd32(ptr, value) (u32)InterlockedExchangeAdd((volatile LONG*)(ptr), (LONG)(value))
+	#define siapp__atomicLoad64(ptr) (u64)InterlockedCompareExchange64((volatile LONG64*)(ptr), 0, 0)
+	#define siapp__atomicStore64(ptr, value) (void)InterlockedExchange64((volatile LONG64*)(ptr), (LONG64)(value))
+	#define siapp__atomicLoadPtr(ptr) InterlockedCompareExchangePointer((PVOID volatile*)(ptr), nil, nil)
+	#define siapp__atomicStorePtr(ptr, value) (void)InterlockedExchangePointer((PVOID volatile*)(ptr), value)
+
+	F_TRAITS(inline intern)
+	b32 siapp__atomicCas32(u32* ptr, u32* expected, u32 desired) {
+		u32 old = (u32)InterlockedCompareExchange((volatile LONG*)ptr, (LONG)desired, (LONG)*expected);
+		SI_STOPIF(old == *expected, return true);
+
+		*expected = old;
+		return false;
+	}
+#else
+	#error "siliapp.h: Atomics and thread-local storage are only implemented for GCC-compatible compilers and MSVC."
+#endif
+
+/* Returns the time of a monotonic clock in nanoseconds.
+ * NOTE(EimaMei): 'si_clock' divides the TSC by a float, which leaves it with
+ * 24 bits of precision. That's far too coarse to time parts of a frame. */
+F_TRAITS(intern)
+u64 siapp__clockNs(void) {
+#if defined(SIAPP_PLATFORM_API_WIN32)
+	static LARGE_INTEGER freq;
+	SI_STOPIF(freq.QuadPart == 0, QueryPerformanceFrequency(&freq));
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	u64 secs = counter.QuadPart / freq.QuadPart,
+		rem = counter.QuadPart % freq.QuadPart;
+	return secs * SI_CLOCKS_PER_SECOND + rem * SI_CLOCKS_PER_SECOND / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * SI_CLOCKS_PER_SECOND + ts.tv_nsec;
+#endif
+}
+
+#if defined(SIAPP_TRACE)
+
+/* How deep zones can be nested on a single thread. */
+#define SI__TRACE_DEPTH 64
+
+typedef struct {
+	cstring name;
+	u64 start;
+	u64 duration;
+} siTraceZone;
+
+typedef struct {
+	u32 threadID;
+	/* How many zones have been written in total. Only the latest
+	 * 'SIAPP_TRACE_CAPACITY' of them are kept. */
+	u64 head;
 
-#define SK_TO_INT(sk) (*((u8*)&sk))
-#define INT_TO_SK(num) (*((siKeyState*)&(u8){num}))
+	u32 depth;
+	cstring names[SI__TRACE_DEPTH];
+	u64 starts[SI__TRACE_DEPTH];
+
+	siTraceZone zones[SIAPP_TRACE_CAPACITY];
+} siTraceRing;
+
+/* NOTE(EimaMei): Every thread writes into its own ring, so recording needs no
+ * locks. The rings only get published through the list with atomics, and they
+ * live until the program exits. */
+intern siTraceRing* SI_TRACE_RINGS[SIAPP_TRACE_THREADS];
+intern u32 SI_TRACE_RING_LEN;
+intern SI__THREAD_LOCAL siTraceRing* SI_TRACE_RING;
+
+F_TRAITS(intern)
+siTraceRing* siapp__traceRingGet(void) {
+	SI_STOPIF(SI_TRACE_RING != nil, return SI_TRACE_RING);
+
+	u32 index = siapp__atomicAdd32(&SI_TRACE_RING_LEN, 1);
+	SI_ASSERT_MSG(index < SIAPP_TRACE_THREADS, "Too many threads are being traced.");
+
+	siTraceRing* ring = calloc(1, sizeof(siTraceRing));
+	SI_ASSERT_NOT_NULL(ring);
+	ring->threadID = index + 1;
+
+	siapp__atomicStorePtr(&SI_TRACE_RINGS[index], ring);
+	SI_TRACE_RING = ring;
+	return ring;
+}
+
+void siapp__traceBegin(cstring name) {
+	siTraceRing* ring = siapp__traceRingGet();
+
+	if (ring->depth < SI__TRACE_DEPTH) {
+		ring->names[ring->depth] = name;
+		ring->starts[ring->depth] = siapp__clockNs();
+	}
+	ring->depth += 1;
+}
+void siapp__traceEnd(void) {
+	siTraceRing* ring = siapp__traceRingGet();
+	SI_ASSERT_MSG(ring->depth != 0, "There is no trace zone to end.");
+
+	ring->depth -= 1;
+	SI_STOPIF(ring->depth >= SI__TRACE_DEPTH, return);
+
+	u64 head = ring->head;
+	siTraceZone* zone = &ring->zones[head % SIAPP_TRACE_CAPACITY];
+	zone->name = ring->names[ring->depth];
+	zone->start = ring->starts[ring->depth];
+	zone->duration = siapp__clockNs() - zone->start;
+
+	siapp__atomicStore64(&ring->head, head + 1);
+}
+
+#endif
+
+b32 siapp_traceWrite(cstring path) {
+	SI_ASSERT_NOT_NULL(path);
+#if defined(SIAPP_TRACE)
+	siFile file = si_fileCreate(path);
+	SI_STOPIF(file.handle == 0, return false);
+
+	/* NOTE(EimaMei): The zones are written in chunks, as a write per zone would
+	 * take ages with full rings. */
+	char buffer[SI_KILO(16)];
+	usize len = 0;
+	len += si_snprintf(buffer, sizeof(buffer), "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") - 1;
+
+	b32 first = true;
+	u32 ringLen = si_min(siapp__atomicLoad32(&SI_TRACE_RING_LEN), SIAPP_TRACE_THREADS);
+	for (u32 i = 0; i < ringLen; i += 1) {
+		const siTraceRing* ring = siapp__atomicLoadPtr(&SI_TRACE_RINGS[i]);
+		SI_STOPIF(ring == nil, continue);
+
+		u64 head = siapp__atomicLoad64(&ring->head);
+		u64 start = (head > SIAPP_TRACE_CAPACITY) ? head - SIAPP_TRACE_CAPACITY : 0;
+
+		len += si_snprintf(
+			&buffer[len], sizeof(buffer) - len,
+			"%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}",
+			first ? "" : ",", ring->threadID, ring->threadID
+		) - 1;
+		first = false;
+
+		for (u64 j = start; j < head; j += 1) {
+			if (len > sizeof(buffer) - 256) {
+				si_fileWriteLen(&file, buffer, len);
+				len = 0;
+			}
+
+			const siTraceZone* zone = &ring->zones[j % SIAPP_TRACE_CAPACITY];
+			len += si_snprintf(
+				&buffer[len], sizeof(buffer) - len,
+				",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03llu,\"dur\":%llu.%03llu}",
+				zone->name, ring->threadID,
+				zone->start / 1000, zone->start % 1000,
+				zone->duration / 1000, zone->duration % 1000
+			) - 1;
+		}
+	}
+	len += si_snprintf(&buffer[len], sizeof(buffer) - len, "\n]}\n") - 1;
+	si_fileWriteLen(&file, buffer, len);
+	si_fileClose(file);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+intern u32 SI_WINDOWS_NUM = 0;
 
 #if defined (SIAPP_PLATFORM_API_WIN32)
 	#define SIAPP_ERROR_CHECK(condition, function) \
@@ -1205,25 +2213,46 @@ intern u32 SI_WINDOWS_NUM = 0;
 
 #define siapp__mouseButtonPress(e, type) \
 	do { \
-		siKeyState* state = &e->mouseButtons[type - 1]; \
-		state->clicked = true; \
-		state->pressed = true; \
-		state->released = false; \
-		\
-		SK_TO_INT(e->keys[SK__EVENT]) |= SI_BIT(6); \
+		u32 bit = SI_BIT((type) - 1); \
+		e->mouseClicked |= bit; \
+		e->mousePressed |= bit; \
+		e->mouseReleased &= ~bit; \
 		e->curMouse = type; \
 	} while(0)
 #define siapp__mouseButtonRelease(e, type) \
 	do { \
-		siKeyState* state = &e->mouseButtons[type - 1]; \
-		state->clicked = false; \
-		state->pressed = false; \
-		state->released = true; \
-		\
-		SK_TO_INT(e->keys[SK__EVENT]) |= SI_BIT(6); \
+		u32 bit = SI_BIT((type) - 1); \
+		e->mouseClicked &= ~bit; \
+		e->mousePressed &= ~bit; \
+		e->mouseReleased |= bit; \
 		e->curMouse = type; \
 	} while (0)
 
+/* Marks the key as pressed. Returns true if it wasn't being held down already,
+ * which makes it clicked. */
+F_TRAITS(inline intern)
+b32 siapp__keyPress(siWindowEvent* e, siKeyType key) {
+	u64 bit = (u64)1 << (key % 64);
+	usize word = key / 64;
+	b32 clicked = (e->keysPressed.bits[word] & bit) == 0;
+
+	SI_STOPIF(clicked, e->keysClicked.bits[word] |= bit);
+	e->keysPressed.bits[word] |= bit;
+	e->keysReleased.bits[word] &= ~bit;
+
+	return clicked;
+}
+/* Marks the key as released. */
+F_TRAITS(inline intern)
+void siapp__keyRelease(siWindowEvent* e, siKeyType key) {
+	u64 bit = (u64)1 << (key % 64);
+	usize word = key / 64;
+
+	e->keysClicked.bits[word] &= ~bit;
+	e->keysPressed.bits[word] &= ~bit;
+	e->keysReleased.bits[word] |= bit;
+}
+
 
 
 b32 siapp__collideRectPoint(siRect r, siPoint p) {
@@ -1235,26 +2264,584 @@ b32 siapp__collideRectPoint(siRect r, siPoint p) {
 	);
 }
 
-
 F_TRAITS(intern)
-void siapp__resizeWindow(siWindow* win, i32 width, i32 height, b32 setEvent) {
-	win->e.type.windowResize = setEvent;
-	win->e.windowSize = SI_AREA(width, height);
+void siapp__frameSamplePush(siFrameHistory* h, siFrameTime time, u64 ns) {
+	h->samples[time][h->next[time]] = ns;
+	h->next[time] = (h->next[time] + 1) % SI_FRAME_HISTORY;
+	h->len[time] = si_min(h->len[time] + 1, SI_FRAME_HISTORY);
+}
+/* Ends the frame that's being made and moves its times into the history. */
+F_TRAITS(intern)
+void siapp__frameEnd(siFrameHistory* h, u64 swapStart) {
+	u64 now = siapp__clockNs();
+	h->current[SI_FRAME_TIME_SWAP] += now - swapStart;
 
-	switch (win->renderType & SI_RENDERING_BITS) {
-		case SI_RENDERING_OPENGL: {
-			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-			siapp_OpenGLCurrentContextSet(win);
+	/* NOTE(EimaMei): The very first frame has no start, as nothing before the
+	 * first swap can be told apart from the app starting up. */
+	if (h->frameStart != 0) {
+		u64 total = now - h->frameStart;
+		u64 measured = h->current[SI_FRAME_TIME_EVENTS] + h->current[SI_FRAME_TIME_UPLOAD]
+			+ h->current[SI_FRAME_TIME_SUBMIT] + h->current[SI_FRAME_TIME_SWAP];
+		h->current[SI_FRAME_TIME_BUILD] = (total > measured) ? total - measured : 0;
+		h->current[SI_FRAME_TIME_TOTAL] = total;
 
-#if defined(SIAPP_PLATFORM_API_COCOA)
-	objc_msgSend_void(gl->context, sel_registerName("update"));
-#endif
+		for_range (i, 0, SI_FRAME_TIME_COUNT) {
+			SI_STOPIF(i == SI_FRAME_TIME_GPU, continue);
+			siapp__frameSamplePush(h, i, h->current[i]);
+		}
+	}
 
-			if (win->arg & SI_WINDOW_SCALING) {
-				glViewport(0, 0, width, height);
-			}
-			else if (win->arg & SI_WINDOW_KEEP_ASPECT_RATIO) {
-				i32 newY = 0;
+	memset(h->current, 0, sizeof(h->current));
+	h->frameStart = now;
+}
+
+/* Advances the frame clock of the window and writes the new times into its
+ * event. */
+F_TRAITS(intern)
+void siapp__frameClockTick(siWindow* win) {
+	siFrameClock* clock = &win->clock;
+	siWindowEvent* e = &win->e;
+
+	u64 now = siapp__clockNs();
+	u64 delta = now - clock->last;
+	clock->last = now;
+
+	/* NOTE(EimaMei): There's no previous frame on the first update. */
+	b32 first = (e->curTime == 0);
+	e->curTime = (f64)(now - clock->start);
+	e->timeDelta = first ? 0 : (f64)delta;
+	SI_STOPIF(first, return);
+
+	/* NOTE(EimaMei): A stall (e.g. the window being dragged) gets clamped, so
+	 * that a single long frame doesn't throw the average off for seconds. */
+	f64 clamped = (delta < SI_FRAME_CLOCK_MAX_DELTA) ? (f64)delta : SI_FRAME_CLOCK_MAX_DELTA;
+	if (e->timeDeltaSmooth == 0) {
+		e->timeDeltaSmooth = clamped;
+	}
+	else {
+		e->timeDeltaSmooth += (clamped - e->timeDeltaSmooth) * SI_FRAME_CLOCK_SMOOTHING;
+	}
+}
+
+/* Sleeps out the rest of the frame. The timer wakes up 'SI_FRAME_PACER_SPIN'
+ * early and the rest gets spun out, so the frame ends right on the deadline. */
+F_TRAITS(intern)
+void siapp__framePace(siFramePacer* pacer) {
+	SI_STOPIF(pacer->interval == 0, return);
+	u64 now = siapp__clockNs();
+
+	/* NOTE(EimaMei): Catching up on a late frame would only make the frames
+	 * after it shorter, so the schedule starts over from it instead. */
+	if (pacer->deadline == 0 || now > pacer->deadline) {
+		pacer->missed += (pacer->deadline != 0);
+		pacer->deadline = now + pacer->interval;
+		return;
+	}
+
+	u64 deadline = pacer->deadline;
+	pacer->deadline += pacer->interval;
+
+	if (deadline > now + SI_FRAME_PACER_SPIN) {
+		u64 wake = deadline - SI_FRAME_PACER_SPIN;
+	#if defined(SIAPP_PLATFORM_API_WIN32)
+		if (pacer->timer == nil) {
+			#if !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+				#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+			#endif
+			/* NOTE(EimaMei): High resolution timers only exist since Windows 10 1803. */
+			pacer->timer = CreateWaitableTimerExW(nil, nil, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+			SI_STOPIF(pacer->timer == nil, pacer->timer = CreateWaitableTimerExW(nil, nil, 0, TIMER_ALL_ACCESS));
+		}
+
+		LARGE_INTEGER due;
+		due.QuadPart = -(LONGLONG)((wake - now) / 100);
+		SetWaitableTimer(pacer->timer, &due, 0, nil, nil, false);
+		WaitForSingleObject(pacer->timer, INFINITE);
+	#elif defined(SI_SYSTEM_LINUX) || defined(SI_SYSTEM_FREEBSD)
+		struct timespec ts = {wake / SI_CLOCKS_PER_SECOND, wake % SI_CLOCKS_PER_SECOND};
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nil) == EINTR) {}
+	#else
+		struct timespec ts = {(wake - now) / SI_CLOCKS_PER_SECOND, (wake - now) % SI_CLOCKS_PER_SECOND};
+		nanosleep(&ts, nil);
+	#endif
+	}
+
+	while (siapp__clockNs() < deadline) {}
+}
+
+/* Returns true if the window already needs a frame, so waiting for events
+ * would only delay it. */
+F_TRAITS(inline intern)
+b32 siapp__redrawPending(const siWindow* win) {
+	return win->redraw || (f64)(siapp__clockNs() - win->clock.start) < win->animateUntil;
+}
+/* Decides whether the update needs a frame and consumes the pending redraw
+ * before the frame gets drawn. Must come after the clock tick. */
+F_TRAITS(intern)
+void siapp__redrawUpdate(siWindow* win) {
+	siWindowEvent* e = &win->e;
+	SI_STOPIF(SI_TO_U32(&e->type) != 0, win->redraw = true);
+
+	e->needsRedraw = win->redraw || e->curTime < win->animateUntil;
+	win->redraw = false;
+}
+
+/* Appends a new event to the window's queue and returns it, overwriting the
+ * oldest one if the queue is full. */
+F_TRAITS(intern)
+siEvent* siapp__eventPush(siWindow* win, siEventTypeEnum type, u32 serverTime) {
+	siEventQueue* queue = &win->events;
+
+	if (queue->len == SI_EVENT_QUEUE_CAPACITY) {
+		queue->head = (queue->head + 1) % SI_EVENT_QUEUE_CAPACITY;
+		queue->len -= 1;
+		queue->dropped += 1;
+	}
+
+	siEvent* event = &queue->events[(queue->head + queue->len) % SI_EVENT_QUEUE_CAPACITY];
+	queue->len += 1;
+
+	memset(event, 0, sizeof(*event));
+	event->type = type;
+	event->serverTime = serverTime;
+	event->time = siapp__clockNs() - win->clock.start;
+
+	return event;
+}
+
+/* Adds the bytes to the end of the received clipboard text. */
+F_TRAITS(intern)
+void siapp__clipboardAppend(siClipboardText* clip, const void* data, usize len) {
+	if (clip->len + len + 1 > clip->__capacity) {
+		usize capacity = si_max(clip->__capacity * 2, clip->len + len + 1);
+		char* text = realloc(clip->text, capacity);
+		SI_STOPIF(text == nil, return);
+
+		clip->text = text;
+		clip->__capacity = capacity;
+	}
+
+	SI_STOPIF(len != 0, memcpy(&clip->text[clip->len], data, len));
+	clip->len += len;
+	clip->text[clip->len] = '\0';
+}
+/* Reports the clipboard text that has arrived, ending the transfer unless the
+ * state is still 'SI_CLIPBOARD_RECEIVING'. */
+F_TRAITS(intern)
+void siapp__clipboardNotify(siWindow* win, siClipboardState state) {
+	win->e.clipboard.state = state;
+	win->e.type.clipboard = true;
+
+	siEvent* event = siapp__eventPush(win, SI_EVENT_CLIPBOARD, 0);
+	event->state = (state != SI_CLIPBOARD_RECEIVING);
+}
+
+#if !defined(SIAPP_PLATFORM_API_WIN32)
+/* Waits until the display connection, the wake up pipe or one of the
+ * registered descriptors becomes readable. A negative 'displayFd' doesn't wait
+ * on the display and 'waitSet' tells if the registered descriptors are used. */
+F_TRAITS(intern)
+siWaitSource siapp__waitPoll(const siWindow* win, i32 displayFd, b32 waitSet, i64 timeout) {
+	const siWaitSet* set = &win->waitSet;
+	struct pollfd fds[SI_WINDOW_FD_COUNT + 2];
+	fds[0].fd = displayFd;
+	fds[0].events = POLLIN;
+	fds[1].fd = win->userEvents.wake[0];
+	fds[1].events = POLLIN;
+
+	for_range (i, 0, SI_WINDOW_FD_COUNT) {
+		fds[i + 2].fd = (waitSet && (set->used & SI_BIT(i))) ? set->fds[i] : -1;
+		fds[i + 2].events = POLLIN;
+	}
+
+	u64 deadline = siapp__clockNs() + (u64)si_max(timeout, 0);
+	i32 res;
+
+	while (true) {
+		i64 left = (timeout < 0) ? -1 : (i64)si_max((i64)deadline - (i64)siapp__clockNs(), 0);
+	#if defined(SI_SYSTEM_LINUX) || defined(SI_SYSTEM_FREEBSD)
+		struct timespec ts = {left / SI_CLOCKS_PER_SECOND, left % SI_CLOCKS_PER_SECOND};
+		res = ppoll(fds, countof(fds), (left < 0) ? nil : &ts, nil);
+	#else
+		/* NOTE(EimaMei): 'poll' takes milliseconds, so the time gets rounded
+		 * up to not wake up before the deadline. */
+		res = poll(fds, countof(fds), (left < 0) ? -1 : (i32)si_min((left + 999999) / 1000000, INT32_MAX));
+	#endif
+		SI_STOPIF(res != -1 || errno != EINTR, break);
+	}
+	SI_STOPIF(res <= 0, return 0);
+
+	siWaitSource sources = 0;
+	for_range (i, 0, countof(fds)) {
+		SI_STOPIF(fds[i].revents == 0, continue);
+		sources |= (siWaitSource)((i < 2) ? SI_BIT(i) : ((u64)SI_WAIT_FD << (i - 2)));
+	}
+
+	return sources;
+}
+#endif
+
+typedef struct {
+	/* The native handle of the window, 0 if the slot is empty. */
+	u64 key;
+	siWindow* win;
+} siWindowMapEntry;
+
+/* NOTE(EimaMei): Maps native window handles to their windows, so that events
+ * can be handed straight to the window they're for. It's an open addressed
+ * table with linear probing, which always stays under half full. */
+intern siWindowMapEntry* SI_WINDOW_MAP = nil;
+intern u32 SI_WINDOW_MAP_CAP = 0;
+intern u32 SI_WINDOW_MAP_LEN = 0;
+
+F_TRAITS(inline intern)
+u32 siapp__windowMapSlot(u64 key) {
+	return (u32)((key * 0x9E3779B97F4A7C15) >> 32) & (SI_WINDOW_MAP_CAP - 1);
+}
+F_TRAITS(intern)
+siWindow* siapp__windowMapGet(u64 key) {
+	SI_STOPIF(SI_WINDOW_MAP_LEN == 0 || key == 0, return nil);
+
+	u32 i = siapp__windowMapSlot(key);
+	while (SI_WINDOW_MAP[i].key != 0) {
+		SI_STOPIF(SI_WINDOW_MAP[i].key == key, return SI_WINDOW_MAP[i].win);
+		i = (i + 1) & (SI_WINDOW_MAP_CAP - 1);
+	}
+
+	return nil;
+}
+F_TRAITS(intern)
+void siapp__windowMapPut(u64 key, siWindow* win) {
+	SI_ASSERT(key != 0);
+
+	if ((SI_WINDOW_MAP_LEN + 1) * 2 > SI_WINDOW_MAP_CAP) {
+		siWindowMapEntry* old = SI_WINDOW_MAP;
+		u32 oldCap = SI_WINDOW_MAP_CAP;
+
+		SI_WINDOW_MAP_CAP = si_max(oldCap * 2, 16);
+		SI_WINDOW_MAP = calloc(SI_WINDOW_MAP_CAP, sizeof(siWindowMapEntry));
+		SI_ASSERT_NOT_NULL(SI_WINDOW_MAP);
+		SI_WINDOW_MAP_LEN = 0;
+
+		for_range (i, 0, oldCap) {
+			SI_STOPIF(old[i].key != 0, siapp__windowMapPut(old[i].key, old[i].win));
+		}
+		free(old);
+	}
+
+	u32 i = siapp__windowMapSlot(key);
+	while (SI_WINDOW_MAP[i].key != 0 && SI_WINDOW_MAP[i].key != key) {
+		i = (i + 1) & (SI_WINDOW_MAP_CAP - 1);
+	}
+
+	SI_WINDOW_MAP_LEN += (SI_WINDOW_MAP[i].key == 0);
+	SI_WINDOW_MAP[i].key = key;
+	SI_WINDOW_MAP[i].win = win;
+}
+F_TRAITS(intern)
+void siapp__windowMapRemove(u64 key) {
+	SI_STOPIF(SI_WINDOW_MAP_LEN == 0, return);
+
+	u32 mask = SI_WINDOW_MAP_CAP - 1;
+	u32 i = siapp__windowMapSlot(key);
+	while (SI_WINDOW_MAP[i].key != key) {
+		SI_STOPIF(SI_WINDOW_MAP[i].key == 0, return);
+		i = (i + 1) & mask;
+	}
+
+	/* NOTE(EimaMei): Instead of leaving a tombstone, the entries after the
+	 * hole that can't be found past it anymore get shifted back into it. */
+	u32 j = i;
+	while (true) {
+		j = (j + 1) & mask;
+		SI_STOPIF(SI_WINDOW_MAP[j].key == 0, break);
+
+		u32 home = siapp__windowMapSlot(SI_WINDOW_MAP[j].key);
+		b32 between = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+		SI_STOPIF(between, continue);
+
+		SI_WINDOW_MAP[i] = SI_WINDOW_MAP[j];
+		i = j;
+	}
+
+	SI_WINDOW_MAP[i].key = 0;
+	SI_WINDOW_MAP[i].win = nil;
+	SI_WINDOW_MAP_LEN -= 1;
+
+	if (SI_WINDOW_MAP_LEN == 0) {
+		free(SI_WINDOW_MAP);
+		SI_WINDOW_MAP = nil;
+		SI_WINDOW_MAP_CAP = 0;
+	}
+}
+
+/* Creates the wake up pipe and readies the slots of the user event queue. */
+F_TRAITS(intern)
+void siapp__userEventsInit(siUserEventQueue* queue) {
+	for_range (i, 0, SI_USER_EVENT_CAPACITY) {
+		queue->slots[i].sequence = (u32)i;
+	}
+
+#if defined(SIAPP_PLATFORM_API_WIN32)
+	queue->wake[0] = CreateEventW(nil, false, false, nil);
+	queue->wake[1] = queue->wake[0];
+#elif defined(SI_SYSTEM_LINUX)
+	queue->wake[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	queue->wake[1] = queue->wake[0];
+#else
+	i32 res = pipe(queue->wake);
+	SI_ASSERT(res == 0);
+
+	for_range (i, 0, 2) {
+		fcntl(queue->wake[i], F_SETFL, fcntl(queue->wake[i], F_GETFL) | O_NONBLOCK);
+		fcntl(queue->wake[i], F_SETFD, FD_CLOEXEC);
+	}
+#endif
+}
+F_TRAITS(intern)
+void siapp__userEventsFree(siUserEventQueue* queue) {
+#if defined(SIAPP_PLATFORM_API_WIN32)
+	CloseHandle(queue->wake[0]);
+#else
+	close(queue->wake[0]);
+	SI_STOPIF(queue->wake[1] != queue->wake[0], close(queue->wake[1]));
+#endif
+}
+/* Empties the wake up pipe and moves the posted events into the window's queue. */
+F_TRAITS(intern)
+void siapp__userEventsRead(siWindow* win) {
+	siUserEventQueue* queue = &win->userEvents;
+
+	/* NOTE(EimaMei): The pipe has to be emptied before the queue is read, so
+	 * that an event that gets posted in between still leaves a wake up behind. */
+#if defined(SIAPP_PLATFORM_API_WIN32)
+	ResetEvent(queue->wake[0]);
+#else
+	u64 buffer;
+	while (read(queue->wake[0], &buffer, sizeof(buffer)) > 0) {}
+#endif
+
+	while (true) {
+		siUserEventSlot* slot = &queue->slots[queue->head % SI_USER_EVENT_CAPACITY];
+		u32 sequence = siapp__atomicLoad32(&slot->sequence);
+		SI_STOPIF(sequence != queue->head + 1, break);
+
+		siEvent* event = siapp__eventPush(win, SI_EVENT_USER, 0);
+		event->data = slot->data;
+		win->e.type.user = true;
+
+		siapp__atomicStore32(&slot->sequence, queue->head + SI_USER_EVENT_CAPACITY);
+		queue->head += 1;
+	}
+}
+
+/* Starts timing a render pass on the GPU. Nothing is timed if the queries of
+ * the frame from 'SI_OPENGL_TIMER_FRAMES' frames ago still haven't finished,
+ * as waiting on them would stall the CPU. */
+F_TRAITS(intern)
+void siapp__timerPassBegin(siWindow* win) {
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	u32 frame = gl->timerFrame;
+	u32 pass = gl->timerPasses[frame];
+	SI_STOPIF(gl->timerActive || (gl->timerPending & SI_BIT(frame)), return);
+	SI_STOPIF(pass == SI_OPENGL_TIMER_PASSES, return);
+
+	glBeginQuery(GL_TIME_ELAPSED, gl->timerQueries[frame][pass]);
+	gl->timerPasses[frame] += 1;
+	gl->timerActive = true;
+}
+F_TRAITS(intern)
+void siapp__timerPassEnd(siWindow* win) {
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	SI_STOPIF(!gl->timerActive || gl->timerPasses[gl->timerFrame] == SI_OPENGL_TIMER_PASSES, return);
+
+	glEndQuery(GL_TIME_ELAPSED);
+	gl->timerActive = false;
+}
+/* Ends the GPU timing of the frame and reads back the earlier frames whose
+ * queries are done. */
+F_TRAITS(intern)
+void siapp__timerFrameEnd(siWindow* win) {
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	SI_STOPIF((win->renderType & SI_RENDERING_OPENGL_BITS) == SI_RENDERINGVER_OPENGL_LEGACY, return);
+
+	if (gl->timerActive) {
+		glEndQuery(GL_TIME_ELAPSED);
+		gl->timerActive = false;
+	}
+	u32 cur = gl->timerFrame;
+	if (gl->timerPasses[cur] != 0 && (gl->timerPending & SI_BIT(cur)) == 0) {
+		gl->timerPending |= SI_BIT(cur);
+		gl->timerFrame = (gl->timerFrame + 1) % SI_OPENGL_TIMER_FRAMES;
+	}
+
+	for_range (frame, 0, SI_OPENGL_TIMER_FRAMES) {
+		SI_STOPIF((gl->timerPending & SI_BIT(frame)) == 0, continue);
+
+		/* NOTE(EimaMei): Queries finish in order, so the whole frame is done
+		 * once its last query is. */
+		u32 passes = gl->timerPasses[frame];
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(gl->timerQueries[frame][passes - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		SI_STOPIF(!available, continue);
+
+		u64 total = 0;
+		for (u32 i = 0; i < passes; i += 1) {
+			GLuint64 elapsed;
+			glGetQueryObjectui64v(gl->timerQueries[frame][i], GL_QUERY_RESULT, &elapsed);
+			total += elapsed;
+		}
+		siapp__frameSamplePush(&win->frameHistory, SI_FRAME_TIME_GPU, total);
+
+		gl->timerPending &= ~SI_BIT(frame);
+		gl->timerPasses[frame] = 0;
+	}
+}
+
+F_TRAITS(intern)
+siVec4 siapp__rectIntersect(siVec4 a, siVec4 b) {
+	f32 x1 = si_maxf(a.x, b.x),
+		y1 = si_maxf(a.y, b.y),
+		x2 = si_minf(a.x + a.z, b.x + b.z),
+		y2 = si_minf(a.y + a.w, b.y + b.w);
+
+	return SI_VEC4(x1, y1, si_maxf(x2 - x1, 0), si_maxf(y2 - y1, 0));
+}
+/* Returns the bounding box of the rectangle after it has been transformed. */
+F_TRAITS(intern)
+siVec4 siapp__rectTransform(const siMatrix* m, siVec4 rect) {
+	f32 corners[4][2] = {
+		{rect.x, rect.y}, {rect.x + rect.z, rect.y},
+		{rect.x + rect.z, rect.y + rect.w}, {rect.x, rect.y + rect.w}
+	};
+	f32 x1 = (f32)INT32_MAX, y1 = (f32)INT32_MAX,
+		x2 = (f32)INT32_MIN, y2 = (f32)INT32_MIN;
+	for_range (i, 0, countof(corners)) {
+		f32 x = m->column[0].x * corners[i][0] + m->column[1].x * corners[i][1] + m->column[3].x,
+			y = m->column[0].y * corners[i][0] + m->column[1].y * corners[i][1] + m->column[3].y;
+
+		x1 = si_minf(x1, x); x2 = si_maxf(x2, x);
+		y1 = si_minf(y1, y); y2 = si_maxf(y2, y);
+	}
+
+	return SI_VEC4(x1, y1, x2 - x1, y2 - y1);
+}
+
+/* Returns the area draws currently land in, in the coordinates they're made in. */
+F_TRAITS(intern)
+siVec4 siapp__clipGet(const siWindow* win) {
+	siVec4 area;
+	if ((win->renderType & SI_RENDERING_BITS) == SI_RENDERING_OPENGL) {
+		const siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+		siArea size = (gl->target.width != 0) ? gl->target : gl->size;
+		area = SI_VEC4(0, 0, size.width, size.height);
+	}
+	else {
+		area = SI_VEC4(
+			0, 0,
+			win->e.windowSize.width / win->scaleFactor.x,
+			win->e.windowSize.height / win->scaleFactor.y
+		);
+	}
+	SI_STOPIF(win->clipLen == win->clipBase, return area);
+
+	return siapp__rectIntersect(area, win->clips[win->clipLen - 1]);
+}
+/* Returns true if the rectangle is fully outside of the current clip. */
+F_TRAITS(intern)
+b32 siapp__clipRejects(const siWindow* win, siVec4 rect) {
+	if ((win->renderType & SI_RENDERING_BITS) == SI_RENDERING_OPENGL) {
+		const siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+		/* NOTE(EimaMei): Draw lists get submitted with a transform that isn't
+		 * known yet, so nothing can be rejected while recording. */
+		SI_STOPIF(gl->recording != nil, return false);
+		rect = siapp__rectTransform(&gl->transforms[gl->transformLen], rect);
+	}
+
+	siVec4 clip = siapp__clipGet(win);
+	return rect.x >= clip.x + clip.z || rect.x + rect.z <= clip.x
+		|| rect.y >= clip.y + clip.w || rect.y + rect.w <= clip.y;
+}
+/* Returns the current clip in buffer pixels. */
+F_TRAITS(intern)
+siRect siapp__cpuClipGet(const siWindow* win) {
+	siRect area = SI_RECT(0, 0, win->e.windowSize.width, win->e.windowSize.height);
+	SI_STOPIF(win->clipLen == win->clipBase, return area);
+
+	siVec4 clip = win->clips[win->clipLen - 1];
+	siVec2 scale = win->scaleFactor;
+	i32 x1 = si_max((i32)(clip.x * scale.x), 0),
+		y1 = si_max((i32)(clip.y * scale.y), 0),
+		x2 = si_min((i32)((clip.x + clip.z) * scale.x), area.width),
+		y2 = si_min((i32)((clip.y + clip.w) * scale.y), area.height);
+
+	return SI_RECT(x1, y1, si_max(x2 - x1, 0), si_max(y2 - y1, 0));
+}
+/* Sets the scissor rectangle of the current clip. */
+F_TRAITS(intern)
+void siapp__clipApply(siWindow* win) {
+	SI_STOPIF((win->renderType & SI_RENDERING_BITS) != SI_RENDERING_OPENGL, return);
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+
+	if (win->clipLen == win->clipBase) {
+		glDisable(GL_SCISSOR_TEST);
+		return;
+	}
+
+	b32 layer = (gl->target.width != 0);
+	siArea size = layer ? gl->target : gl->size;
+	siVec4 clip = siapp__clipGet(win);
+
+	GLint view[4];
+	glGetIntegerv(GL_VIEWPORT, view);
+	f32 scaleX = view[2] / (f32)size.width,
+		scaleY = view[3] / (f32)size.height;
+
+	/* NOTE(EimaMei): Scissor rectangles go from bottom to top, while layers are
+	 * already drawn upside down. */
+	f32 y = layer ? clip.y : size.height - clip.y - clip.w;
+	i32 x1 = si_round(clip.x * scaleX),
+		y1 = si_round(y * scaleY),
+		x2 = si_round((clip.x + clip.z) * scaleX),
+		y2 = si_round((y + clip.w) * scaleY);
+
+	glScissor(view[0] + x1, view[1] + y1, x2 - x1, y2 - y1);
+	glEnable(GL_SCISSOR_TEST);
+}
+/* Submits the pending draws if the clip has changed from 'prev' and moves the
+ * scissor rectangle to the new clip. */
+F_TRAITS(intern)
+void siapp__clipUpdate(siWindow* win, siVec4 prev) {
+	SI_STOPIF((win->renderType & SI_RENDERING_BITS) != SI_RENDERING_OPENGL, return);
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	SI_ASSERT_MSG(gl->recording == nil, "The clip cannot be changed while recording a draw list.");
+
+	siVec4 clip = siapp__clipGet(win);
+	SI_STOPIF(memcmp(&prev, &clip, sizeof(clip)) == 0, return);
+
+	SI_STOPIF(gl->vertexCounter != 0 || gl->drawCounter != 0, siapp_windowOpenGLRender(win));
+	siapp__clipApply(win);
+}
+
+F_TRAITS(intern)
+void siapp__resizeWindow(siWindow* win, i32 width, i32 height, b32 setEvent) {
+	win->e.type.windowResize = setEvent;
+	win->e.windowSize = SI_AREA(width, height);
+
+	switch (win->renderType & SI_RENDERING_BITS) {
+		case SI_RENDERING_OPENGL: {
+			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+			siapp_OpenGLCurrentContextSet(win);
+
+#if defined(SIAPP_PLATFORM_API_COCOA)
+	objc_msgSend_void(gl->context, sel_registerName("update"));
+#endif
+
+			if (win->arg & SI_WINDOW_SCALING) {
+				glViewport(0, 0, width, height);
+			}
+			else if (win->arg & SI_WINDOW_KEEP_ASPECT_RATIO) {
+				i32 newY = 0;
 
 				if (height <= win->originalSize.height) {
 					newY = height - win->originalSize.height;
@@ -1276,6 +2863,7 @@ void siapp__resizeWindow(siWindow* win, i32 width, i32 height, b32 setEvent) {
 			f32 viewH = view[3];
 
 			win->scaleFactor = SI_VEC2(viewW / gl->size.width, viewH / gl->size.height);
+			siapp__clipApply(win);
 			break;
 		}
 		case SI_RENDERING_CPU: {
@@ -1317,40 +2905,229 @@ siDropEvent* siapp__findDndNode(siWindow* win, siPoint pos) {
 	return node;
 }
 
-force_inline
-void siapp__drawTextWrapped(siWindow* win, cstring text, siFont* font, f32 posX,
-		u32 size, f32 maxWidth, f32 scaleFactor, siVec2* base, f32* width, usize* index) {
-	siUtf32Char x;
-	siGlyphInfo* glyph;
-	usize chainLen = 0;
-	f32 addedWidth = base->x;
-	u32 maxChars[256];
+F_TRAITS(inline intern)
+f32 siapp__textAdvance(siFont* font, i32 codepoint, f32 scaleFactor) {
+	switch (codepoint) {
+		case ' ': return font->advance.space * scaleFactor;
+		case '\t': return font->advance.tab * scaleFactor;
+		case '\r': return 0;
+	}
+	return siapp_fontGlyphFind(font, codepoint)->advanceX * scaleFactor;
+}
+
+#define SI__ARRAY_RESERVE(array, cap, count) \
+	do { \
+		if ((count) > (cap)) { \
+			(cap) = si_max((count), (cap) * 2); \
+			(array) = realloc((array), (cap) * sizeof(*(array))); \
+			SI_ASSERT_NOT_NULL(array); \
+		} \
+	} while (0)
+
+F_TRAITS(intern)
+void siapp__textLayoutMeasure(siTextLayout* layout, siTextParagraph* p, cstring text) {
+	f32 scaleFactor = (f32)layout->size / layout->font->size;
+	f32 width = 0,
+		trimmed = 0;
+	b32 prevSpace = false;
+	p->breakLen = 0;
+
+	usize index = 0;
+	while (index < p->len) {
+		siUtf32Char x = si_utf8Decode(&text[index]);
+		SI_STOPIF(x.codepoint == SI_UNICODE_INVALID, x.len = 1);
+		b32 space = (x.codepoint == ' ' || x.codepoint == '\t');
+
+		/* NOTE(EimaMei): A line may only be broken at the start of a word. */
+		if (index == 0 || (prevSpace && !space)) {
+			SI__ARRAY_RESERVE(p->breaks, p->breakCap, p->breakLen + 1);
+			p->breaks[p->breakLen] = (siTextBreak){index, width, trimmed};
+			p->breakLen += 1;
+		}
+
+		width += siapp__textAdvance(layout->font, x.codepoint, scaleFactor);
+		SI_STOPIF(!space, trimmed = width);
+		prevSpace = space;
+		index += x.len;
+	}
+
+	SI__ARRAY_RESERVE(p->breaks, p->breakCap, p->breakLen + 2);
+	if (p->breakLen == 0) {
+		p->breaks[0] = (siTextBreak){0, 0, 0};
+		p->breakLen = 1;
+	}
+	p->breaks[p->breakLen] = (siTextBreak){p->len, width, trimmed};
+	p->breakLen += 1;
+}
+
+F_TRAITS(inline intern)
+void siapp__textLayoutLinePush(siTextParagraph* p, siTextBreak start, siTextBreak end) {
+	SI__ARRAY_RESERVE(p->lines, p->lineCap, p->lineLen + 1);
+	p->lines[p->lineLen] = (siTextLine){start.index, end.index - start.index, end.trimmed - start.width};
+	p->lineLen += 1;
+}
+
+F_TRAITS(intern)
+void siapp__textLayoutWrap(siTextLayout* layout, siTextParagraph* p, cstring text) {
+	f32 scaleFactor = (f32)layout->size / layout->font->size;
+	f32 maxWidth = layout->maxWidth;
+	p->lineLen = 0;
+	p->maxWidth = maxWidth;
+
+	siTextBreak start = p->breaks[0],
+				prev = start;
+
+	/* NOTE(EimaMei): Trailing spaces are allowed to hang past the wrap width,
+	 * only the words have to fit. */
+	for (u32 i = 1; i < p->breakLen; i += 1) {
+		siTextBreak cur = p->breaks[i];
+		if (cur.trimmed - start.width <= maxWidth) {
+			prev = cur;
+			continue;
+		}
+
+		if (prev.index != start.index) {
+			siapp__textLayoutLinePush(p, start, prev);
+			start = prev;
+			i -= 1;
+			continue;
+		}
+
+		/* NOTE(EimaMei): The word alone doesn't fit, meaning it has to be
+		 * split per glyph. This is rare enough that the glyphs get re-measured
+		 * instead of storing every glyph's width. */
+		siTextBreak pos = start;
+		while (pos.index < cur.index) {
+			siUtf32Char x = si_utf8Decode(&text[pos.index]);
+			SI_STOPIF(x.codepoint == SI_UNICODE_INVALID, x.len = 1);
+			f32 advance = siapp__textAdvance(layout->font, x.codepoint, scaleFactor);
+			b32 space = (x.codepoint == ' ' || x.codepoint == '\t');
+
+			if (!space && pos.width + advance - start.width > maxWidth && pos.index != start.index) {
+				siapp__textLayoutLinePush(p, start, pos);
+				start = pos;
+			}
+			pos.width += advance;
+			SI_STOPIF(!space, pos.trimmed = pos.width);
+			pos.index += x.len;
+		}
+		prev = cur;
+	}
+	siapp__textLayoutLinePush(p, start, p->breaks[p->breakLen - 1]);
+}
+
+F_TRAITS(inline intern)
+u64 siapp__textHash(cstring text, usize len) {
+	u64 hash = 14695981039346656037ULL;
+	for_range (i, 0, len) {
+		hash = (hash ^ (u8)text[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+F_TRAITS(inline intern)
+usize siapp__textParagraphEnd(cstring text, usize start, usize end) {
+	const char* newline = memchr(&text[start], '\n', end - start);
+	return (newline != nil) ? (usize)(newline - text) : end;
+}
+
+/* Lays out the paragraphs of the text between 'start' and 'end' into 'out'.
+ * The old paragraphs are looked up by the hash of their text, meaning that
+ * a paragraph only gets re-measured if its text is new, no matter where it
+ * has moved to. Every old paragraph gets freed or moved into 'out'. */
+F_TRAITS(intern)
+void siapp__textLayoutSplit(siTextLayout* layout, cstring text, usize start, usize end,
+		siTextParagraph* old, usize oldLen, siTextParagraph** out, usize* outLen,
+		usize* outCap) {
+	usize mask = 1;
+	while (mask < oldLen * 2) { mask <<= 1; }
+	mask -= 1;
+
+	usize* slots = malloc((mask + 1) * sizeof(usize));
+	SI_ASSERT_NOT_NULL(slots);
+	for_range (i, 0, mask + 1) { slots[i] = USIZE_MAX; }
+	for_range (i, 0, oldLen) {
+		usize slot = (usize)old[i].hash & mask;
+		while (slots[slot] != USIZE_MAX) { slot = (slot + 1) & mask; }
+		slots[slot] = i;
+	}
 
 	while (true) {
-		if (addedWidth > maxWidth) {
-			*width = maxWidth;
-			base->x = posX;
-			base->y += font->advance.newline * scaleFactor;
-			break;
+		usize pEnd = siapp__textParagraphEnd(text, start, end);
+		SI__ARRAY_RESERVE(*out, *outCap, *outLen + 1);
+		siTextParagraph* p = &(*out)[*outLen];
+		*outLen += 1;
+
+		memset(p, 0, sizeof(*p));
+		p->start = start;
+		p->len = pEnd - start;
+		p->hash = siapp__textHash(&text[start], p->len);
+
+		/* NOTE(EimaMei): Paragraphs that were already taken have their breaks
+		 * cleared, but stay in the table so that the probing isn't cut short. */
+		usize slot = (usize)p->hash & mask;
+		while (slots[slot] != USIZE_MAX) {
+			siTextParagraph* match = &old[slots[slot]];
+			if (match->breaks != nil && match->hash == p->hash && match->len == p->len) {
+				usize pStart = p->start;
+				*p = *match;
+				p->start = pStart;
+				match->breaks = nil;
+				match->lines = nil;
+				break;
+			}
+			slot = (slot + 1) & mask;
 		}
 
-		x = si_utf8Decode(&text[*index]);
-		SI_STOPIF(x.codepoint == ' ' || (x.codepoint >= '\t' && x.codepoint <= '\r') || x.codepoint == '%', break);
+		if (p->breaks == nil) {
+			siapp__textLayoutMeasure(layout, p, &text[start]);
+			siapp__textLayoutWrap(layout, p, &text[start]);
+		}
+		else if (p->maxWidth != layout->maxWidth) {
+			siapp__textLayoutWrap(layout, p, &text[start]);
+		}
+
+		SI_STOPIF(pEnd == end, break);
+		start = pEnd + 1;
+	}
+
+	for_range (i, 0, oldLen) {
+		free(old[i].breaks);
+		free(old[i].lines);
+	}
+	free(slots);
+}
 
-		glyph = siapp_fontGlyphFind(font, x.codepoint);
-		maxChars[chainLen] = glyph - font->glyphs;
-		addedWidth += glyph->advanceX * scaleFactor;
-		*index += x.len;
-		chainLen += 1;
+F_TRAITS(intern)
+void siapp__textLayoutCount(siTextLayout* layout, usize from) {
+	usize lineCount = (from != 0)
+		? layout->paragraphs[from - 1].firstLine + layout->paragraphs[from - 1].lineLen
+		: 0;
+	for_range (i, from, layout->paragraphLen) {
+		layout->paragraphs[i].firstLine = lineCount;
+		lineCount += layout->paragraphs[i].lineLen;
 	}
+	layout->lineCount = lineCount;
+}
 
-	for_range (i, 0, chainLen) {
-		glyph = &font->glyphs[maxChars[i]];
-		f32 advance = siapp_drawCharacterScale(win, font, glyph, *base, size, scaleFactor);
-		base->x += advance;
+F_TRAITS(intern)
+usize siapp__textLayoutParagraphFind(const siTextLayout* layout, usize index) {
+	usize low = 0,
+		  high = layout->paragraphLen - 1;
+	while (low < high) {
+		usize mid = low + (high - low + 1) / 2;
+		SI_STOPIF(layout->paragraphs[mid].start <= index, low = mid; continue);
+		high = mid - 1;
 	}
+	return low;
 }
 
+/* Layout reused by 'siapp_drawTextWithWrapF', so that redrawing the same text
+ * doesn't re-measure it. */
+intern SI__THREAD_LOCAL siTextLayout SI_TEXT_WRAP_LAYOUT;
+/* Allocator of the font that the layout was made for. */
+intern SI__THREAD_LOCAL siAllocator* SI_TEXT_WRAP_ALLOC;
+
 #endif
 
 #if defined(SIAPP_PLATFORM_API_WIN32)
@@ -1399,24 +3176,21 @@ u32 siapp__dropUpdatePress(IDropTarget* target, IDataObject* pDataObj, DWORD grf
 
 	switch (grfKeyState & (MK_LBUTTON | MK_MBUTTON | MK_RBUTTON)) {
 		case MK_LBUTTON: {
-			siKeyState* key = &e->mouseButtons[SI_MOUSE_LEFT - 1];
-			key->clicked = false;
-			key->pressed = true;
-			key->released = false;
+			e->mouseClicked &= ~SI_BIT(SI_MOUSE_LEFT - 1);
+			e->mousePressed |= SI_BIT(SI_MOUSE_LEFT - 1);
+			e->mouseReleased &= ~SI_BIT(SI_MOUSE_LEFT - 1);
 			break;
 		}
 		case MK_MBUTTON: {
-			siKeyState* key = &e->mouseButtons[SI_MOUSE_RIGHT - 1];
-			key->clicked = false;
-			key->pressed = true;
-			key->released = false;
+			e->mouseClicked &= ~SI_BIT(SI_MOUSE_RIGHT - 1);
+			e->mousePressed |= SI_BIT(SI_MOUSE_RIGHT - 1);
+			e->mouseReleased &= ~SI_BIT(SI_MOUSE_RIGHT - 1);
 			break;
 		}
 		case MK_RBUTTON: {
-			siKeyState* key = &e->mouseButtons[SI_MOUSE_RIGHT - 1];
-			key->clicked = false;
-			key->pressed = true;
-			key->released = false;
+			e->mouseClicked &= ~SI_BIT(SI_MOUSE_RIGHT - 1);
+			e->mousePressed |= SI_BIT(SI_MOUSE_RIGHT - 1);
+			e->mouseReleased &= ~SI_BIT(SI_MOUSE_RIGHT - 1);
 			break;
 		}
 	}
@@ -1455,31 +3229,35 @@ void siapp__dropUpdateRelease(IDropTarget* target, IDataObject* pDataObj, DWORD
 
 	switch (grfKeyState & (MK_LBUTTON | MK_MBUTTON | MK_RBUTTON)) {
 		case MK_LBUTTON: {
-			siKeyState* key = &e->mouseButtons[SI_MOUSE_LEFT - 1];
-			key->clicked = false;
-			key->pressed = false;
-			key->released = true;
+			e->mouseClicked &= ~SI_BIT(SI_MOUSE_LEFT - 1);
+			e->mousePressed &= ~SI_BIT(SI_MOUSE_LEFT - 1);
+			e->mouseReleased |= SI_BIT(SI_MOUSE_LEFT - 1);
 			break;
 		}
 		case MK_MBUTTON: {
-			siKeyState* key = &e->mouseButtons[SI_MOUSE_RIGHT - 1];
-			key->clicked = false;
-			key->pressed = false;
-			key->released = true;
+			e->mouseClicked &= ~SI_BIT(SI_MOUSE_RIGHT - 1);
+			e->mousePressed &= ~SI_BIT(SI_MOUSE_RIGHT - 1);
+			e->mouseReleased |= SI_BIT(SI_MOUSE_RIGHT - 1);
 			break;
 		}
 		case MK_RBUTTON: {
-			siKeyState* key = &e->mouseButtons[SI_MOUSE_RIGHT - 1];
-			key->clicked = false;
-			key->pressed = false;
-			key->released = true;
+			e->mouseClicked &= ~SI_BIT(SI_MOUSE_RIGHT - 1);
+			e->mousePressed &= ~SI_BIT(SI_MOUSE_RIGHT - 1);
+			e->mouseReleased |= SI_BIT(SI_MOUSE_RIGHT - 1);
 			break;
 		}
 	}
 }
 
 
-LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+F_TRAITS(inline intern)
+void siapp__win32EventPushButton(siWindow* win, siEventTypeEnum type, siMouseButtonType button) {
+	siEvent* queued = siapp__eventPush(win, type, GetMessageTime());
+	queued->button = button;
+	queued->pos = win->e.mouse;
+}
+
+LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 	siWindow* win = (siWindow*)GetWindowLongPtrW(hwnd, GWLP_USERDATA);
 	if (win == nil) {
 		return DefWindowProcW(hwnd, msg, wParam, lParam);
@@ -1493,8 +3271,13 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 			DestroyWindow(win->hwnd);
 			break;
 		}
+		case WM_PAINT: {
+			win->redraw = true;
+			return DefWindowProcW(hwnd, msg, wParam, lParam);
+		}
 		case WM_CLOSE: {
 			e->type.isClosed = true;
+			siapp__eventPush(win, SI_EVENT_CLOSE, GetMessageTime());
 			break;
 		}
 		case WM_WINDOWPOSCHANGED: {
@@ -1505,21 +3288,25 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 			if (!si_pointCmp(e->windowPos, pos)) {
 				e->type.windowMove = true;
 				e->windowPos = pos;
+				siapp__eventPush(win, SI_EVENT_WINDOW_MOVE, GetMessageTime())->pos = pos;
 			}
 
 			if (!si_areaCmp(e->windowSize, size)) {
 				siapp__resizeWindow(win, change->cx, change->cy, true);
+				siapp__eventPush(win, SI_EVENT_WINDOW_RESIZE, GetMessageTime())->pos = SI_POINT(size.width, size.height);
 			}
 			break;
 		}
 		case WM_KILLFOCUS: {
 			e->type.windowFocusChange = true;
 			e->focus = false;
+			siapp__eventPush(win, SI_EVENT_WINDOW_FOCUS, GetMessageTime())->state = false;
 			break;
 		}
 		case WM_SETFOCUS: {
 			e->type.windowFocusChange = true;
 			e->focus = true;
+			siapp__eventPush(win, SI_EVENT_WINDOW_FOCUS, GetMessageTime())->state = true;
 			break;
 		}
 		case WM_MOUSEMOVE: {
@@ -1529,27 +3316,35 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 			e->type.mouseMove = true;
 			e->mouse = SI_POINT(mouseX, mouseY);
 			e->mouseScaled = SI_VEC2((f32)mouseX / win->scaleFactor.x, (f32)mouseY / win->scaleFactor.y);
+			siapp__eventPush(win, SI_EVENT_MOUSE_MOVE, GetMessageTime())->pos = e->mouse;
 			break;
 		}
 		case WM_MOUSEWHEEL: {
 			e->type.mouseScroll = true;
 			i32 delta = GET_WHEEL_DELTA_WPARAM(wParam);
 			e->mouseWheel = (delta < 0) ? SI_MOUSE_WHEEL_DOWN : SI_MOUSE_WHEEL_UP;
+
+			siEvent* queued = siapp__eventPush(win, SI_EVENT_MOUSE_SCROLL, GetMessageTime());
+			queued->button = e->mouseWheel;
+			queued->pos = e->mouse;
 			break;
 		}
 		case WM_LBUTTONDOWN: {
 			e->type.mousePress = true;
 			siapp__mouseButtonPress(e, SI_MOUSE_LEFT);
+			siapp__win32EventPushButton(win, SI_EVENT_MOUSE_PRESS, SI_MOUSE_LEFT);
 			break;
 		}
 		case WM_MBUTTONDOWN: {
 			e->type.mousePress = true;
 			siapp__mouseButtonPress(e, SI_MOUSE_MIDDLE);
+			siapp__win32EventPushButton(win, SI_EVENT_MOUSE_PRESS, SI_MOUSE_MIDDLE);
 			break;
 		}
 		case WM_RBUTTONDOWN: {
 			e->type.mousePress = true;
 			siapp__mouseButtonPress(e, SI_MOUSE_RIGHT);
+			siapp__win32EventPushButton(win, SI_EVENT_MOUSE_PRESS, SI_MOUSE_RIGHT);
 			break;
 		}
 		case WM_XBUTTONDOWN: {
@@ -1560,22 +3355,26 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 			 * convert the given result by adding 3. */
 			siMouseButtonType xButton = GET_XBUTTON_WPARAM(wParam) + 3;
 			siapp__mouseButtonPress(e, xButton);
+			siapp__win32EventPushButton(win, SI_EVENT_MOUSE_PRESS, xButton);
 			break;
 		}
 
 		case WM_LBUTTONUP: {
 			e->type.mouseRelease = true;
 			siapp__mouseButtonRelease(e, SI_MOUSE_LEFT);
+			siapp__win32EventPushButton(win, SI_EVENT_MOUSE_RELEASE, SI_MOUSE_LEFT);
 			break;
 		}
 		case WM_MBUTTONUP: {
 			e->type.mouseRelease = true;
 			siapp__mouseButtonRelease(e, SI_MOUSE_MIDDLE);
+			siapp__win32EventPushButton(win, SI_EVENT_MOUSE_RELEASE, SI_MOUSE_MIDDLE);
 			break;
 		}
 		case WM_RBUTTONUP: {
 			e->type.mouseRelease = true;
 			siapp__mouseButtonRelease(e, SI_MOUSE_RIGHT);
+			siapp__win32EventPushButton(win, SI_EVENT_MOUSE_RELEASE, SI_MOUSE_RIGHT);
 			break;
 		}
 		case WM_XBUTTONUP: {
@@ -1586,6 +3385,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 			 * convert the given result by adding 3. */
 			siMouseButtonType xButton = GET_XBUTTON_WPARAM(wParam) + 3;
 			siapp__mouseButtonRelease(e, xButton);
+			siapp__win32EventPushButton(win, SI_EVENT_MOUSE_RELEASE, xButton);
 			break;
 		}
 
@@ -1653,16 +3453,18 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 			siKeyType key = siapp_osKeyToSili(vk);
 			e->curKey = key;
 
-			siKeyState* keyState = &e->keys[key];
-			keyState->clicked = (!keyState->pressed && isDown);
-			keyState->pressed = isDown;
-			keyState->released = isUp;
-
-			if (keyState->clicked || isUp) {
-				SK_TO_INT(e->keys[SK__EVENT]) |= SI_BIT(7);
-				e->__private.keyCache[e->__private.keyCacheLen % 16] = key;
-				e->__private.keyCacheLen += 1;
+			b32 clicked = false;
+			if (isDown) {
+				clicked = siapp__keyPress(e, key);
 			}
+			else if (isUp) {
+				siapp__keyRelease(e, key);
+			}
+
+			siEvent* queued = siapp__eventPush(win, isDown ? SI_EVENT_KEY_PRESS : SI_EVENT_KEY_RELEASE, GetMessageTime());
+			queued->key = key;
+			queued->pos = e->mouse;
+			queued->state = isDown && !clicked;
 
 			if (isDown && !isE1 && !isE0) {
 				u16 buf[4];
@@ -1781,6 +3583,7 @@ intern Atom WM_DELETE_WINDOW,
 			UTF8_STRING,
 			CLIPBOARD,
 			XSEL_DATA,
+			INCR,
 			SAVE_TARGETS,
 			TARGETS,
 			MULTIPLE,
@@ -1806,6 +3609,24 @@ intern Atom XdndAware,
 intern Cursor SI_X11_CURSORS[SI_CURSOR_COUNT] = {0};
 intern siWindow* SI_ROOT_WINDOW = nil;
 
+/* Text served while one of the windows owns the clipboard. */
+intern char* SI_X11_CLIPBOARD_TEXT = nil;
+intern usize SI_X11_CLIPBOARD_LEN = 0;
+intern Window SI_X11_CLIPBOARD_OWNER = 0;
+/* Transfers of the text that are sent in chunks with the INCR protocol. */
+intern struct {
+	Window requestor;
+	Atom property, target;
+	usize offset;
+	/* When the transfer gets dropped, on the 'siapp__clockNs' clock. */
+	u64 deadline;
+	/* Whether the requestor's events were selected by us. */
+	b32 selected;
+} SI_X11_CLIPBOARD_SENDS[SI_CLIPBOARD_INCR_COUNT];
+/* Set by 'siapp__x11ErrorIgnore' while errors are being trapped. */
+intern b32 SI_X11_ERROR_TRAPPED = false;
+intern XErrorHandler SI_X11_ERROR_PREV = nil;
+
 intern siDllProc SI_X11_XCURSOR = nil;
 
 typedef Cursor SI_FUNC_PTR(XcursorLibraryLoadCursorProc, (Display *dpy, const char *file));
@@ -1818,6 +3639,41 @@ XcursorLibraryImageCreateProc si_XcursorImageCreate;
 XcursorImageLoadCursorProc si_XcursorImageLoadCursor;
 XcursorImageDestroyProc si_XcursorImageDestroy;
 
+intern siDllProc SI_X11_XI = nil;
+/* The major opcode of XInput, 0 if it hasn't been checked yet and -1 if it's
+ * unsupported. */
+intern i32 SI_X11_XI_OPCODE = 0;
+/* How many windows have raw mouse input on. */
+intern u32 SI_X11_XI_USERS = 0;
+typedef struct {
+	/* 0 if unused, 1 and 2 for X and Y, 3 and 4 for vertical and horizontal
+	 * scrolling. */
+	u8 kind;
+	b8 absolute;
+	b8 lastValid;
+	f64 increment;
+	f64 last;
+} siX11XiAxis;
+
+typedef struct {
+	i32 id;
+	siX11XiAxis axes[16];
+} siX11XiDevice;
+
+/* The valuators of the devices that have sent raw events so far. */
+intern siX11XiDevice SI_X11_XI_DEVICES[16];
+intern u32 SI_X11_XI_DEVICES_LEN = 0;
+
+typedef Status SI_FUNC_PTR(XIQueryVersionProc, (Display* display, int* major, int* minor));
+typedef int SI_FUNC_PTR(XISelectEventsProc, (Display* display, Window win, XIEventMask* masks, int numMasks));
+typedef XIDeviceInfo* SI_FUNC_PTR(XIQueryDeviceProc, (Display* display, int deviceid, int* ndevicesReturn));
+typedef void SI_FUNC_PTR(XIFreeDeviceInfoProc, (XIDeviceInfo* info));
+
+XIQueryVersionProc si_XIQueryVersion;
+XISelectEventsProc si_XISelectEvents;
+XIQueryDeviceProc si_XIQueryDevice;
+XIFreeDeviceInfoProc si_XIFreeDeviceInfo;
+
 F_TRAITS(intern)
 void siapp__x11CheckStartup(void) {
 	SI_STOPIF(SI_X11_DISPLAY != nil, return);
@@ -1837,6 +3693,7 @@ void siapp__x11CheckStartup(void) {
 	ATOM_PAIR = XInternAtom(SI_X11_DISPLAY, "ATOM_PAIR", False);
 	CLIPBOARD_MANAGER = XInternAtom(SI_X11_DISPLAY, "CLIPBOARD_MANAGER", False);
 	XSEL_DATA = XInternAtom(SI_X11_DISPLAY, "XSEL_DATA", False);
+	INCR = XInternAtom(SI_X11_DISPLAY, "INCR", False);
 	_MOTIF_WM_HINTS = XInternAtom(SI_X11_DISPLAY, "_MOTIF_WM_HINTS", False);
 	_NET_WM_STATE = XInternAtom(SI_X11_DISPLAY, "_NET_WM_STATE", False);
 	_NET_WM_STATE_FULLSCREEN = XInternAtom(SI_X11_DISPLAY, "_NET_WM_STATE_FULLSCREEN", False);
@@ -1901,12 +3758,22 @@ IOHIDGetModifierLockStatePROC si_IOHIDGetModifierLockState;
 IOObjectReleasePROC si_IOObjectRelease;
 IOServiceClosePROC si_IOServiceClose;
 
+/* NOTE(EimaMei): Cocoa's event timestamps aren't wrapped, so the server time is
+ * left empty. */
+F_TRAITS(inline intern)
+void siapp__cocoaEventPushButton(siWindow* win, siEventTypeEnum type, u32 button) {
+	siEvent* queued = siapp__eventPush(win, type, 0);
+	queued->button = button;
+	queued->pos = win->e.mouse;
+}
+
 b32 si__osxWindowClose(void* self) {
 	siWindow* win = nil;
 	object_getInstanceVariable(self, "siWindow", (void*)&win);
 	SI_STOPIF(win == nil, return true);
 
 	win->e.type.isClosed = true;
+	siapp__eventPush(win, SI_EVENT_CLOSE, 0);
 	return true;
 }
 NSSize si__osxWindowResize(void* self, SEL sel, NSSize frameSize) {
@@ -1915,6 +3782,7 @@ NSSize si__osxWindowResize(void* self, SEL sel, NSSize frameSize) {
 	SI_ASSERT_NOT_NULL(win);
 
 	siapp__resizeWindow(win, frameSize.width, frameSize.height, true);
+	siapp__eventPush(win, SI_EVENT_WINDOW_RESIZE, 0)->pos = SI_POINT(frameSize.width, frameSize.height);
 	return frameSize;
 	SI_UNUSED(sel);
 }
@@ -1927,6 +3795,7 @@ void si__osxWindowMove(void* self) {
 	NSRect frame = NSWindow_frame(win->hwnd);
 	win->e.type.windowMove = true;
 	win->e.windowPos = SI_POINT(frame.origin.x, frame.origin.y);
+	siapp__eventPush(win, SI_EVENT_WINDOW_MOVE, 0)->pos = win->e.windowPos;
 }
 
 void si__osxWindowFocus(void* self) {
@@ -1936,6 +3805,7 @@ void si__osxWindowFocus(void* self) {
 
 	win->e.type.windowFocusChange = true;
 	win->e.focus = true;
+	siapp__eventPush(win, SI_EVENT_WINDOW_FOCUS, 0)->state = true;
 }
 void si__osxWindowFocusLost(void* self) {
 	siWindow* win = nil;
@@ -1944,6 +3814,7 @@ void si__osxWindowFocusLost(void* self) {
 
 	win->e.type.windowFocusChange = true;
 	win->e.focus = false;
+	siapp__eventPush(win, SI_EVENT_WINDOW_FOCUS, 0)->state = false;
 }
 b32 si__osxViewResponder(void) {
 	return true;
@@ -2043,12 +3914,9 @@ void si__osxDraggingEnded(id self, SEL sel, id sender) {
 #define MULTILINE_STR(...) #__VA_ARGS__
 
 typedef SI_ENUM(i32, siVboIndex) {
-	SI_VBO_POS = 0,
-	SI_VBO_TEX,
-	SI_VBO_CLR,
+	SI_VBO_VERTEX = 0,
 	SI_VBO_ID,
-	SI_VBO_ELM,
-	SI_VBO_OFFSET
+	SI_VBO_ELM
 };
 
 typedef SI_ENUM(i32, siShaderIndex) {
@@ -2058,40 +3926,29 @@ typedef SI_ENUM(i32, siShaderIndex) {
 	SI_SHADER_ID,
 };
 
-#define i32ToNDCX(num, windowCord) (((+2.0f * (num)) / (windowCord)) - 1.0f)
-#define i32ToNDCY(num, windowCord) (((-2.0f * (num)) / (windowCord)) + 1.0f)
+typedef SI_ENUM(i32, siOpenGLPrimitive) {
+	SI_PRIMITIVE_QUAD = 0,
+	SI_PRIMITIVE_TRIANGLE,
+	SI_PRIMITIVE_FAN,
+};
+
+#define SI__STREAM_MAP_FLAGS \
+	(GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT)
+#define SI__PERSISTENT_MAP_FLAGS \
+	(GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
 
-#if !defined(SIAPP_PLATFORM_API_COCOA)
 #define GL_BUFFER_MAKE(ID, var, size) \
 	do { \
-		if ((win->renderType & SI_RENDERING_OPENGL_BITS) == SI_RENDERINGVER_OPENGL_3_3) { \
-			var = malloc(size); \
-			glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[ID]); \
-			glBufferData(GL_ARRAY_BUFFER, size, var, GL_DYNAMIC_DRAW); \
-		} \
-		else { \
-			glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[ID]); \
-			glBufferStorage(GL_ARRAY_BUFFER, size, nil, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT); \
-			var = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT); \
-		} \
-		SI_ASSERT_NOT_NULL(var); \
-	} while(0)
-#else
-	#define GL_BUFFER_MAKE(ID, var, size) \
-	do { \
-		var = (typeof(var))malloc(size); \
-		glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[ID]); \
-		glBufferData(GL_ARRAY_BUFFER, size, var, GL_DYNAMIC_DRAW); \
+		var = siapp__bufferMake(win, ID, size); \
 		SI_ASSERT_NOT_NULL(var); \
 	} while(0)
-#endif
 
 static siOpenGLInfo glInfo = {false, {0, 0}, 0, 0, {0, 0}, 8, 4, false, 0, nil};
 
 static const char VSHADER_DEFAULT[] = MULTILINE_STR(
 	\x23version 150\n
 
-	in vec3 pos;
+	in vec2 pos;
 	in vec2 tex;
 	in vec4 clr;
 	in uvec2 info;
@@ -2100,12 +3957,14 @@ static const char VSHADER_DEFAULT[] = MULTILINE_STR(
 	out vec4 fragClr;
 	flat out uint fragTexID;
 	uniform mat4 mvp[%u];
+	uniform mat4 projection;
 
 	void main() {
 		fragTex = tex;
 		fragClr = clr;
 		fragTexID = info.x;
-		gl_Position = vec4(pos, 1.0);//* mvp[info.y];
+
+		gl_Position = projection * (mvp[info.y] * vec4(pos, 0.0, 1.0));
 	}
 );
 static const char FSHADER_4_0[] = MULTILINE_STR(
@@ -2157,28 +4016,451 @@ i32 si_OpenGLShaderMake(i32 shaderType, cstring source) {
 	return shader;
 }
 
-void siapp__addVertexesToCMD(siWinRenderingCtxOpenGL* gl, u32 count, u32 vertexCount) {
-	siOpenGLIDs* IDs = &gl->batchInfo[gl->drawCounter];
-	IDs->texID = gl->curTex->atlas->texID.opengl - 1;
-	IDs->matrixID = gl->drawCounter;
+/* NOTE(EimaMei): The GL 3.3 path writes straight into an unsynchronized mapping
+ * of a buffer that is several batches large. Every batch gets a fresh region
+ * after the previous one, so the GPU is never written to while it's reading
+ * from it. Once the end is reached, the buffer gets orphaned and the driver
+ * hands out new storage instead of stalling. */
+F_TRAITS(intern)
+rawptr siapp__streamMap(siWinRenderingCtxOpenGL* gl, siVboIndex ID) {
+	siOpenGLStream* stream = &gl->streams[ID];
 
-	siOpenGLDrawCMD* cmd = &gl->CMDs[gl->drawCounter];
-	cmd->count = count;
-	cmd->instanceCount = 1;
-	cmd->firstIndex = 0;
-	cmd->baseVertex = gl->vertexCounter - vertexCount;
-	cmd->baseInstance = gl->drawCounter;
+	glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[ID]);
+	if (stream->offset + stream->regionSize > stream->size) {
+		glBufferData(GL_ARRAY_BUFFER, stream->size, nil, GL_STREAM_DRAW);
+		stream->offset = 0;
+	}
+
+	return glMapBufferRange(GL_ARRAY_BUFFER, stream->offset, stream->regionSize, SI__STREAM_MAP_FLAGS);
+}
+F_TRAITS(intern)
+rawptr siapp__streamMake(siWinRenderingCtxOpenGL* gl, siVboIndex ID, usize size) {
+	siOpenGLStream* stream = &gl->streams[ID];
+	stream->regionSize = size;
+	stream->size = size * SI_OPENGL_STREAM_REGIONS;
+	stream->offset = 0;
+
+	glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[ID]);
+	glBufferData(GL_ARRAY_BUFFER, stream->size, nil, GL_STREAM_DRAW);
+
+	return siapp__streamMap(gl, ID);
+}
+F_TRAITS(intern)
+void siapp__streamUnmap(siWinRenderingCtxOpenGL* gl, siVboIndex ID, usize used) {
+	glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[ID]);
+	SI_STOPIF(used != 0, glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, used));
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+/* Size of a tile in the deferred overlap grid in pixels. */
+#define SI__DEFERRED_TILE 64
+#define SI__DEFERRED_DEPTH_MAX 0xFFFFFF
+
+/* Sorts 'len' keys and their values with an LSD radix sort. Passes where every
+ * key has the same byte get skipped. */
+F_TRAITS(intern)
+void siapp__radixSort(u64* keys, u32* values, u64* keysTmp, u32* valuesTmp, u32 len) {
+	SI_STOPIF(len < 2, return);
+	u64* srcKeys = keys;
+	u32* srcValues = values;
+
+	for (u32 shift = 0; shift < 64; shift += 8) {
+		u32 offsets[256] = {0};
+		for_range (i, 0, len) {
+			offsets[(srcKeys[i] >> shift) & 0xFF] += 1;
+		}
+		SI_STOPIF(offsets[(srcKeys[0] >> shift) & 0xFF] == len, continue);
+
+		u32 sum = 0;
+		for_range (i, 0, countof(offsets)) {
+			u32 count = offsets[i];
+			offsets[i] = sum;
+			sum += count;
+		}
+
+		for_range (i, 0, len) {
+			u32 dst = offsets[(srcKeys[i] >> shift) & 0xFF]++;
+			keysTmp[dst] = srcKeys[i];
+			valuesTmp[dst] = srcValues[i];
+		}
+
+		u64* tmpKeys = srcKeys; srcKeys = keysTmp; keysTmp = tmpKeys;
+		u32* tmpValues = srcValues; srcValues = valuesTmp; valuesTmp = tmpValues;
+	}
+
+	if (srcKeys != keys) {
+		memcpy(keys, srcKeys, len * sizeof(u64));
+		memcpy(values, srcValues, len * sizeof(u32));
+	}
+}
+/* Allocates the overlap grid for the current size of the context. */
+F_TRAITS(intern)
+void siapp__deferredTilesMake(siWinRenderingCtxOpenGL* gl) {
+	siOpenGLDeferred* d = gl->deferred;
+	d->tilesWidth = gl->size.width / SI__DEFERRED_TILE + 1;
+	d->tilesHeight = gl->size.height / SI__DEFERRED_TILE + 1;
+
+	free(d->tiles);
+	d->tiles = calloc(d->tilesWidth * d->tilesHeight, sizeof(siOpenGLTile));
+	SI_ASSERT_NOT_NULL(d->tiles);
+}
+/* (Re)allocates the deferred storage to match the capacity of the batch. */
+F_TRAITS(intern)
+void siapp__deferredResize(siWinRenderingCtxOpenGL* gl) {
+	siOpenGLDeferred* d = gl->deferred;
+	d->vertices = realloc(d->vertices, gl->maxVertexCount * sizeof(siOpenGLVertex));
+	d->keys = realloc(d->keys, gl->maxDrawCount * sizeof(u64));
+	d->keysTmp = realloc(d->keysTmp, gl->maxDrawCount * sizeof(u64));
+	d->order = realloc(d->order, gl->maxDrawCount * sizeof(u32));
+	d->orderTmp = realloc(d->orderTmp, gl->maxDrawCount * sizeof(u32));
+	d->CMDs = realloc(d->CMDs, gl->maxDrawCount * sizeof(siOpenGLDrawCMD));
+	SI_ASSERT(
+		d->vertices != nil && d->keys != nil && d->keysTmp != nil
+		&& d->order != nil && d->orderTmp != nil && d->CMDs != nil
+	);
+}
+/* Points the emitted vertices at the mapped buffer, or the staging buffer when
+ * draws are deferred. */
+F_TRAITS(intern)
+void siapp__verticesSet(siWinRenderingCtxOpenGL* gl, siOpenGLVertex* mapped) {
+	if (gl->deferred != nil) {
+		gl->deferred->mapped = mapped;
+		gl->vertices = gl->deferred->vertices;
+	}
+	else {
+		gl->vertices = mapped;
+	}
+}
+/* Records a deferred draw. Its depth is the lowest one that still keeps it above
+ * every earlier draw it overlaps with a different state. */
+F_TRAITS(intern)
+void siapp__deferredAdd(siWinRenderingCtxOpenGL* gl, siOpenGLPrimitive type,
+		u32 texID, u32 matrixID, u32 baseVertex, u32 vertexCount) {
+	/* NOTE(EimaMei): The texture ID is the texture's unit, which also indexes
+	 * the shader's sampler array, so it always stays far below the limit. */
+	SI_ASSERT_MSG(texID <= 0xFFFF, "The texture unit doesn't fit into the deferred state.");
+	SI_ASSERT_MSG(matrixID <= 0x3FFF, "The matrix ID doesn't fit into the deferred state.");
+
+	siOpenGLDeferred* d = gl->deferred;
+	u32 state = (texID << 16) | (matrixID << 2) | (u32)type;
+
+	const siOpenGLVertex* first = &d->vertices[baseVertex];
+	f32 minX = first->x, minY = first->y,
+		maxX = first->x, maxY = first->y;
+	for_range (i, baseVertex + 1, baseVertex + vertexCount) {
+		const siOpenGLVertex* v = &d->vertices[i];
+		minX = si_minf(minX, v->x); maxX = si_maxf(maxX, v->x);
+		minY = si_minf(minY, v->y); maxY = si_maxf(maxY, v->y);
+	}
+
+	/* NOTE(EimaMei): The bounding box is moved into screen space, otherwise
+	 * draws with different transforms couldn't be compared. */
+	siVec4 box = siapp__rectTransform(&gl->matrices[matrixID], SI_VEC4(
+		minX, minY, maxX - minX, maxY - minY
+	));
+	f32 x1 = box.x, y1 = box.y,
+		x2 = box.x + box.z, y2 = box.y + box.w;
+
+	i32 tileX1 = si_max(0, si_min((i32)x1 / SI__DEFERRED_TILE, d->tilesWidth - 1)),
+		tileY1 = si_max(0, si_min((i32)y1 / SI__DEFERRED_TILE, d->tilesHeight - 1)),
+		tileX2 = si_max(0, si_min((i32)x2 / SI__DEFERRED_TILE, d->tilesWidth - 1)),
+		tileY2 = si_max(0, si_min((i32)y2 / SI__DEFERRED_TILE, d->tilesHeight - 1));
+
+	u32 depth = 0;
+	for_range (y, tileY1, tileY2 + 1) {
+		const siOpenGLTile* row = &d->tiles[y * d->tilesWidth];
+		for_range (x, tileX1, tileX2 + 1) {
+			SI_STOPIF(row[x].depth == 0, continue);
+			u32 tileDepth = row[x].depth - 1 + (row[x].state != state);
+			depth = si_max(depth, tileDepth);
+		}
+	}
+	depth = si_min(depth, SI__DEFERRED_DEPTH_MAX);
+
+	for_range (y, tileY1, tileY2 + 1) {
+		siOpenGLTile* row = &d->tiles[y * d->tilesWidth];
+		for_range (x, tileX1, tileX2 + 1) {
+			siOpenGLTile* tile = &row[x];
+			if (tile->depth < depth + 1) {
+				tile->depth = depth + 1;
+				tile->state = state;
+			}
+			else if (tile->depth == depth + 1 && tile->state != state) {
+				/* NOTE(EimaMei): Mixed states get a state no draw can have, so
+				 * that the next overlapping draw always goes one level up. */
+				tile->state = UINT32_MAX;
+			}
+		}
+	}
+
+	d->keys[gl->drawCounter] = ((u64)gl->layer << 56) | ((u64)depth << 32) | state;
 
+	siOpenGLDrawCMD* cmd = &gl->CMDs[gl->drawCounter];
+	cmd->count = vertexCount;
+	cmd->baseVertex = baseVertex;
 	gl->drawCounter += 1;
+}
+/* Sorts the deferred draws, copies their vertices into the mapped buffer in that
+ * order and merges every run of draws with the same state. */
+F_TRAITS(intern)
+void siapp__deferredResolve(siWinRenderingCtxOpenGL* gl) {
+	siOpenGLDeferred* d = gl->deferred;
+	for_range (i, 0, gl->drawCounter) {
+		d->order[i] = i;
+	}
+	siapp__radixSort(d->keys, d->order, d->keysTmp, d->orderTmp, gl->drawCounter);
+
+	u32 dst = 0, count = 0;
+	u32 lastState = UINT32_MAX;
+	for_range (i, 0, gl->drawCounter) {
+		const siOpenGLDrawCMD* src = &gl->CMDs[d->order[i]];
+		u32 state = (u32)d->keys[i];
+		siOpenGLPrimitive type = state & 3;
+		u32 indexCount = (type == SI_PRIMITIVE_QUAD) ? src->count / 4 * 6 : src->count;
+
+		memcpy(&d->mapped[dst], &d->vertices[src->baseVertex], src->count * sizeof(siOpenGLVertex));
+
+		if (count != 0 && state == lastState && type != SI_PRIMITIVE_FAN) {
+			d->CMDs[count - 1].count += indexCount;
+		}
+		else {
+			siOpenGLDrawCMD* cmd = &d->CMDs[count];
+			cmd->count = indexCount;
+			cmd->instanceCount = 1;
+			cmd->firstIndex = (type == SI_PRIMITIVE_QUAD) ? 0 : UINT32_MAX;
+			cmd->baseVertex = dst;
+			cmd->baseInstance = count;
+			cmd->mode = (type == SI_PRIMITIVE_FAN) ? GL_TRIANGLE_FAN : GL_TRIANGLES;
+
+			gl->batchInfo[count].texID = state >> 16;
+			gl->batchInfo[count].matrixID = (state >> 2) & 0x3FFF;
+			count += 1;
+			lastState = state;
+		}
+		dst += src->count;
+	}
+
+	siOpenGLDrawCMD* CMDs = gl->CMDs;
+	gl->CMDs = d->CMDs;
+	d->CMDs = CMDs;
+	gl->drawCounter = count;
+
+	if (
+		d->tilesWidth != (u32)gl->size.width / SI__DEFERRED_TILE + 1
+		|| d->tilesHeight != (u32)gl->size.height / SI__DEFERRED_TILE + 1
+	) {
+		siapp__deferredTilesMake(gl);
+	}
+	else {
+		memset(d->tiles, 0, d->tilesWidth * d->tilesHeight * sizeof(siOpenGLTile));
+	}
+}
+
+/* Creates the storage of a batch buffer, where 'size' is the size of a single
+ * batch. GL 4.4 maps the whole buffer persistently and cycles through its regions
+ * with fences, GL 3.3 streams through it instead. */
+F_TRAITS(intern)
+rawptr siapp__bufferMake(siWindow* win, siVboIndex ID, usize size) {
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	siOpenGLStream* stream = &gl->streams[ID];
+	stream->mapping = nil;
+
+#if !defined(SIAPP_PLATFORM_API_COCOA)
+	if ((win->renderType & SI_RENDERING_OPENGL_BITS) == SI_RENDERINGVER_OPENGL_4_4) {
+		stream->regionSize = size;
+		stream->size = size * SI_OPENGL_STREAM_REGIONS;
+		stream->offset = 0;
+
+		glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[ID]);
+		glBufferStorage(GL_ARRAY_BUFFER, stream->size, nil, SI__PERSISTENT_MAP_FLAGS);
+		stream->mapping = glMapBufferRange(GL_ARRAY_BUFFER, 0, stream->size, SI__PERSISTENT_MAP_FLAGS);
+		return stream->mapping;
+	}
+#endif
+	return siapp__streamMake(gl, ID, size);
+}
+/* Uploads quad indices for 'quadCount' quads. */
+F_TRAITS(intern)
+void siapp__indicesMake(siWinRenderingCtxOpenGL* gl, u32 quadCount) {
+	typedef u32 siOpenGLIndices[6];
+	siOpenGLIndices* indices = malloc(sizeof(siOpenGLIndices) * quadCount);
+	SI_ASSERT_NOT_NULL(indices);
+
+	u32 k = 0;
+	for_range (i, 0, quadCount) {
+		indices[i][0] = k + 0;
+		indices[i][1] = k + 1;
+		indices[i][2] = k + 2;
+
+		indices[i][3] = k + 0;
+		indices[i][4] = k + 2;
+		indices[i][5] = k + 3;
+
+		k += 4;
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl->VBOs[SI_VBO_ELM]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(siOpenGLIndices) * quadCount, indices, GL_STATIC_DRAW);
+	free(indices);
+}
+/* Points the vertex attributes at the vertex buffer. */
+F_TRAITS(intern)
+void siapp__vertexFormatSet(u32 VBO) {
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glVertexAttribPointer(SI_SHADER_POS, 2, GL_FLOAT, GL_FALSE, sizeof(siOpenGLVertex), (rawptr)offsetof(siOpenGLVertex, x));
+	glVertexAttribPointer(SI_SHADER_TEX, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(siOpenGLVertex), (rawptr)offsetof(siOpenGLVertex, u));
+	glVertexAttribPointer(SI_SHADER_CLR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(siOpenGLVertex), (rawptr)offsetof(siOpenGLVertex, color));
+}
+/* Reallocates the batch storage. The batch has to be empty. */
+F_TRAITS(intern)
+void siapp__batchGrow(siWindow* win, u32 maxVertexCount, u32 maxDrawCount) {
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	SI_ASSERT(gl->vertexCounter == 0 && gl->drawCounter == 0);
+
+	for_range (i, 0, SI_OPENGL_STREAM_REGIONS) {
+		SI_STOPIF(gl->fences[i] == nil, continue);
+		glDeleteSync(gl->fences[i]);
+		gl->fences[i] = nil;
+	}
+
+	siVboIndex IDs[] = {SI_VBO_VERTEX, SI_VBO_ID};
+	for_range (i, 0, countof(IDs)) {
+		if (gl->streams[IDs[i]].mapping != nil) {
+			/* NOTE(EimaMei): Immutable storage cannot be resized, so a new
+			 * buffer is made. The driver keeps the old one alive until the GPU
+			 * is done with it. */
+			glDeleteBuffers(1, &gl->VBOs[IDs[i]]);
+			glGenBuffers(1, &gl->VBOs[IDs[i]]);
+		}
+		else {
+			siapp__streamUnmap(gl, IDs[i], 0);
+		}
+	}
+
+	siOpenGLVertex* vertices;
+	GL_BUFFER_MAKE(SI_VBO_VERTEX, vertices, sizeof(siOpenGLVertex) * maxVertexCount);
+	GL_BUFFER_MAKE(SI_VBO_ID,     gl->batchInfo, sizeof(siOpenGLIDs) * maxDrawCount);
+	siapp__vertexFormatSet(gl->VBOs[SI_VBO_VERTEX]);
+
+	if (maxVertexCount > gl->maxVertexCount) {
+		siapp__indicesMake(gl, maxVertexCount / 4);
+	}
+
+	gl->CMDs = realloc(gl->CMDs, sizeof(siOpenGLDrawCMD) * maxDrawCount);
+	SI_ASSERT_NOT_NULL(gl->CMDs);
+
+	gl->maxVertexCount = maxVertexCount;
+	gl->maxDrawCount = maxDrawCount;
+	gl->stats.grows += 1;
+
+	SI_STOPIF(gl->deferred != nil, siapp__deferredResize(gl));
+	siapp__verticesSet(gl, vertices);
+}
+/* Makes sure that 'vertexCount' vertices and a draw command fit inside the batch.
+ * If they don't, the batch gets submitted and its storage doubled, so that the
+ * next frames don't have to be split. */
+F_TRAITS(intern)
+void siapp__batchReserve(siWindow* win, u32 vertexCount) {
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	SI_STOPIF(
+		gl->vertexCounter + vertexCount <= gl->maxVertexCount && gl->drawCounter < gl->maxDrawCount,
+		return
+	);
+
+	siOpenGLRecording* rec = gl->recording;
+	if (rec != nil) {
+		while (gl->vertexCounter + vertexCount > gl->maxVertexCount) { gl->maxVertexCount *= 2; }
+		rec->vertices = realloc(rec->vertices, gl->maxVertexCount * sizeof(siOpenGLVertex));
+		SI_ASSERT_NOT_NULL(rec->vertices);
+		gl->vertices = rec->vertices;
+		return ;
+	}
+
+	siapp_windowRender(win);
+	SI__COUNTER_ADD(&gl->counters, flushes, 1);
+	SI_STOPIF((win->renderType & SI_RENDERING_OPENGL_BITS) == SI_RENDERINGVER_OPENGL_LEGACY, return);
+	gl->stats.flushes += 1;
+
+	u32 maxVertexCount = gl->maxVertexCount,
+		maxDrawCount = gl->maxDrawCount;
+	if (gl->frameVertices + vertexCount > maxVertexCount) {
+		while (maxVertexCount < gl->frameVertices + vertexCount) { maxVertexCount *= 2; }
+	}
+	if (gl->frameDraws + 1 > maxDrawCount) {
+		while (maxDrawCount < gl->frameDraws + 1) { maxDrawCount *= 2; }
+	}
+	siapp__batchGrow(win, maxVertexCount, maxDrawCount);
+}
+
+/* Adds the last 'vertexCount' vertices to the batch as a single primitive. Quads
+ * and triangles get merged into the previous command when they share its texture
+ * and transform. */
+void siapp__addVertexesToCMD(siWinRenderingCtxOpenGL* gl, siOpenGLPrimitive type, u32 vertexCount) {
+	u32 texID = gl->curTex->atlas->texID.opengl - 1;
+	u32 matrixID = gl->matrixCounter - 1;
+	u32 baseVertex = gl->vertexCounter - vertexCount;
+	u32 count = (type == SI_PRIMITIVE_QUAD) ? 6 : vertexCount;
+	u32 mode = (type == SI_PRIMITIVE_FAN) ? GL_TRIANGLE_FAN : GL_TRIANGLES;
 
 	SI_ASSERT(gl->gradientLen <= vertexCount);
 	for_range (i, 0, gl->gradientLen) {
-		siColor tmp = gl->gradient[i];
-
-		siVec4 color = SI_VEC4(tmp.r / 255.0f, tmp.g / 255.0f, tmp.b / 255.0f, tmp.a / 255.0f);
-		gl->colors[cmd->baseVertex + i] = color;
+		gl->vertices[baseVertex + i].color = gl->gradient[i];
 	}
 	gl->gradientLen = 0;
+
+	siOpenGLRecording* rec = gl->recording;
+	if (rec != nil) {
+		if (rec->primLen == rec->primCap) {
+			rec->primCap *= 2;
+			rec->prims = realloc(rec->prims, rec->primCap * sizeof(siOpenGLRecorded));
+			SI_ASSERT_NOT_NULL(rec->prims);
+		}
+		siOpenGLRecorded* prim = &rec->prims[rec->primLen];
+		prim->vertexCount = vertexCount;
+		prim->texID = texID;
+		prim->type = type;
+		rec->primLen += 1;
+		return ;
+	}
+	gl->matrixUsed = true;
+
+	if (gl->deferred != nil) {
+		siapp__deferredAdd(gl, type, texID, matrixID, baseVertex, vertexCount);
+		return ;
+	}
+
+	if (gl->drawCounter != 0 && type != SI_PRIMITIVE_FAN) {
+		siOpenGLDrawCMD* prev = &gl->CMDs[gl->drawCounter - 1];
+		b32 prevIndexed = (prev->firstIndex != UINT32_MAX);
+		u32 prevVertices = prevIndexed ? prev->count / 6 * 4 : prev->count;
+
+		if (
+			prev->mode == mode && prevIndexed == (type == SI_PRIMITIVE_QUAD)
+			&& gl->lastIDs.texID == texID && gl->lastIDs.matrixID == matrixID
+			&& prev->baseVertex + prevVertices == baseVertex
+		) {
+			prev->count += count;
+			return ;
+		}
+	}
+
+	SI_STOPIF(gl->drawCounter != 0, SI__COUNTER_ADD(&gl->counters, batchBreaks, 1));
+
+	siOpenGLIDs* IDs = &gl->batchInfo[gl->drawCounter];
+	IDs->texID = texID;
+	IDs->matrixID = matrixID;
+	gl->lastIDs = *IDs;
+
+	siOpenGLDrawCMD* cmd = &gl->CMDs[gl->drawCounter];
+	cmd->count = count;
+	cmd->instanceCount = 1;
+	/* NOTE(EimaMei): Only quads go through the index buffer, the rest are drawn
+	 * straight from the vertices. */
+	cmd->firstIndex = (type == SI_PRIMITIVE_QUAD) ? 0 : UINT32_MAX;
+	cmd->baseVertex = baseVertex;
+	cmd->baseInstance = gl->drawCounter;
+	cmd->mode = mode;
+
+	gl->drawCounter += 1;
 }
 
 void RGL_opengl_getError(void) {
@@ -2216,18 +4498,36 @@ siMatrix rglMatrixIdentity(void) {
 		}
 	};
 }
-#endif
 
-#endif
+F_TRAITS(intern)
+void siapp__transformCommit(siWindow* win) {
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	const siMatrix* transform = &gl->transforms[gl->transformLen];
 
+	/* NOTE(EimaMei): Transforms that no draw has referenced yet get overwritten,
+	 * so that only the ones actually used take up space in the batch. */
+	if (!gl->matrixUsed) {
+		gl->matrices[gl->matrixCounter - 1] = *transform;
+		return;
+	}
+	if (gl->matrixCounter == SI_OPENGL_MATRIX_COUNT) {
+		siapp_windowRender(win);
+		return;
+	}
 
-siWindow* siapp_windowMake(cstring name, siArea size, siWindowArg arg) {
-	return siapp_windowMakeEx(name, SI_POINT(0, 0), size, arg);
+	gl->matrices[gl->matrixCounter] = *transform;
+	gl->matrixCounter += 1;
+	gl->matrixUsed = false;
 }
-siWindow* siapp_windowMakeEx(cstring name, siPoint pos, siArea size, siWindowArg arg) {
-	SI_ASSERT_NOT_NULL(name);
+#endif
+
+#endif
+
 
+F_TRAITS(intern)
+siWindow* siapp__windowAlloc(siWindowArg arg) {
 	siWindow* win = (siWindow*)malloc(sizeof(siWindow));
+	SI_ASSERT_NOT_NULL(win);
 	memset(win, 0, sizeof(siWindow));
 	win->arg = arg;
 	win->scaleFactor = SI_VEC2(1, 1);
@@ -2236,6 +4536,33 @@ siWindow* siapp_windowMakeEx(cstring name, siPoint pos, siArea size, siWindowArg
 	win->renderType = SI_RENDERING_UNSET;
 	win->textColor = SI_VEC4(1, 1, 1, 1);
 	win->dndHead = (rawptr)USIZE_MAX;
+	win->clock.start = siapp__clockNs();
+	win->clock.last = win->clock.start;
+	siapp__userEventsInit(&win->userEvents);
+	win->redraw = true;
+
+	return win;
+}
+
+siWindow* siapp_windowMake(cstring name, siArea size, siWindowArg arg) {
+	return siapp_windowMakeEx(name, SI_POINT(0, 0), size, arg);
+}
+siWindow* siapp_windowMakeHeadless(siArea size, siWindowArg arg) {
+	SI_ASSERT(size.width > 0 && size.height > 0);
+
+	/* NOTE(EimaMei): None of the arguments that need a screen make sense here. */
+	arg &= SI_WINDOW_SCALING | SI_WINDOW_KEEP_ASPECT_RATIO;
+	siWindow* win = siapp__windowAlloc(arg | SI_WINDOW_HEADLESS);
+	win->originalSize = size;
+	win->e.windowSize = size;
+
+	return win;
+}
+siWindow* siapp_windowMakeEx(cstring name, siPoint pos, siArea size, siWindowArg arg) {
+	SI_ASSERT_NOT_NULL(name);
+	SI_ASSERT_MSG(!(arg & SI_WINDOW_HEADLESS), "Use 'siapp_windowMakeHeadless' to create a headless window.");
+
+	siWindow* win = siapp__windowAlloc(arg);
 
 #if defined(SIAPP_PLATFORM_API_COCOA)
 	if (NSApp == nil) {
@@ -2319,15 +4646,16 @@ siWindow* siapp_windowMakeEx(cstring name, siPoint pos, siArea size, siWindowArg
 	siapp_windowWin32DarkModeSet(win, darkMode);
 #elif defined(SIAPP_PLATFORM_API_X11)
 	siapp__x11CheckStartup();
-	win->display = XOpenDisplay(nil);
-	SIAPP_ERROR_CHECK(win->display == nil, "XOpenDisplay(nil)");
+	/* NOTE(EimaMei): Every window shares the same connection, so that the
+	 * events only get read once for all of them. */
+	win->display = SI_X11_DISPLAY;
 
 	i32 screen = XDefaultScreen(win->display);
 	XSetWindowAttributes wa;
 	wa.event_mask =
 		KeyPressMask | KeyReleaseMask | ButtonPressMask | ButtonReleaseMask |
 		PointerMotionMask | StructureNotifyMask | FocusChangeMask | EnterWindowMask |
-		LeaveWindowMask;
+		LeaveWindowMask | ExposureMask | PropertyChangeMask;
 
 	win->hwnd = XCreateWindow(
 		win->display, XDefaultRootWindow(win->display),
@@ -2473,8 +4801,7 @@ siWindow* siapp_windowMakeEx(cstring name, siPoint pos, siArea size, siWindowArg
 			si_IOServiceClose(ioc);
 		}
 
-		siKeyState* key = &win->e.keys[SK_CAPS_LOCK];
-		key->pressed = caps;
+		SI_STOPIF(caps, win->e.keysPressed.bits[SK_CAPS_LOCK / 64] |= (u64)1 << (SK_CAPS_LOCK % 64));
 		SI_COCOA_OLD_MODIFIERS = NSEventModifierFlagCapsLock * caps;
 	}
 	if (!(arg & SI_WINDOW_COCOA_DISABLE_AUTOMATIC_MENUBAR)) {
@@ -2515,6 +4842,14 @@ siWindow* siapp_windowMakeEx(cstring name, siPoint pos, siArea size, siWindowArg
 	SI_WINDOWS_NUM += 1;
 	siapp__resizeWindow(win, size.width, size.height, false);
 
+#if defined(SIAPP_PLATFORM_API_X11)
+	XLockDisplay(win->display);
+	siapp__windowMapPut((u64)win->hwnd, win);
+	XUnlockDisplay(win->display);
+#else
+	siapp__windowMapPut((u64)(usize)win->hwnd, win);
+#endif
+
 	siWindowShowState state;
 	switch (arg & (SI_WINDOW_MINIMIZED | SI_WINDOW_MAXIMIZED | SI_WINDOW_HIDDEN)) {
 		case SI_WINDOW_MINIMIZED: state = SI_SHOW_MINIMIZE; break;
@@ -2534,494 +4869,1118 @@ siWindow* siapp_windowMakeEx(cstring name, siPoint pos, siArea size, siWindowArg
 	return win;
 }
 
-const siWindowEvent* siapp_windowUpdate(siWindow* win, b32 await) {
-	SI_ASSERT_NOT_NULL(win);
-	SI_ASSERT_MSG(
-		win->renderType != SI_RENDERING_UNSET, "You must call the 'siapp_windowRendererMake' function at least once."
-	);
-
-	siWindowEvent* out = &win->e;
 #if defined(SIAPP_PLATFORM_API_X11)
-	siEventType oldType = out->type;
-#endif
-	win->cursorSet = false;
-	out->charBufferLen = 0;
-
-	out->type = (siEventType){0};
-
-	{
-		u32 eventBits = SK_TO_INT(out->keys[SK__EVENT]);
+/* Returns how many bytes of the clipboard get sent in a single property. */
+F_TRAITS(intern)
+usize siapp__x11ClipboardChunk(Display* display) {
+	/* NOTE(EimaMei): The limit is given in 4 byte units, so using it as bytes
+	 * keeps every chunk at a quarter of the largest request. */
+	usize max = XExtendedMaxRequestSize(display);
+	SI_STOPIF(max == 0, max = XMaxRequestSize(display));
+	return max;
+}
+/* Marks that a request has failed instead of letting Xlib exit. */
+F_TRAITS(intern)
+int siapp__x11ErrorIgnore(Display* display, XErrorEvent* error) {
+	SI_X11_ERROR_TRAPPED = true;
+	return 0;
+	SI_UNUSED(display); SI_UNUSED(error);
+}
+/* Starts trapping the errors of requests made to another application's
+ * windows, which can get destroyed at any moment. */
+F_TRAITS(intern)
+void siapp__x11ErrorTrapBegin(Display* display) {
+	XSync(display, False);
+	SI_X11_ERROR_TRAPPED = false;
+	SI_X11_ERROR_PREV = XSetErrorHandler(siapp__x11ErrorIgnore);
+}
+/* Stops trapping the errors and returns whether any of the requests failed. */
+F_TRAITS(intern)
+b32 siapp__x11ErrorTrapEnd(Display* display) {
+	XSync(display, False);
+	XSetErrorHandler(SI_X11_ERROR_PREV);
+	return SI_X11_ERROR_TRAPPED;
+}
 
-		if (SI_NUM_BIT_GET(eventBits, SI_BIT(7))) { // Keys.
-			usize* keyCacheLen = &out->__private.keyCacheLen;
-			siKeyType* keyCache = out->__private.keyCache;
+/* Stops the INCR transfer at the index. */
+F_TRAITS(intern)
+void siapp__x11ClipboardSendEnd(usize index) {
+	Window requestor = SI_X11_CLIPBOARD_SENDS[index].requestor;
+	SI_X11_CLIPBOARD_SENDS[index].requestor = 0;
+	SI_STOPIF(!SI_X11_CLIPBOARD_SENDS[index].selected, return);
+	SI_X11_CLIPBOARD_SENDS[index].selected = false;
+
+	/* NOTE(EimaMei): Another transfer to the same window still needs its
+	 * events, in which case it takes over the deselection. */
+	for_range (i, 0, SI_CLIPBOARD_INCR_COUNT) {
+		SI_STOPIF(SI_X11_CLIPBOARD_SENDS[i].requestor != requestor, continue);
+		SI_X11_CLIPBOARD_SENDS[i].selected = true;
+		return;
+	}
+
+	Display* display = SI_X11_DISPLAY;
+	XLockDisplay(display);
+	siapp__x11ErrorTrapBegin(display);
+	XSelectInput(display, requestor, NoEventMask);
+	siapp__x11ErrorTrapEnd(display);
+	XUnlockDisplay(display);
+}
+/* Drops the INCR transfers that haven't made any progress in time. */
+F_TRAITS(intern)
+void siapp__x11ClipboardSendExpire(void) {
+	u64 now = siapp__clockNs();
+	for_range (i, 0, SI_CLIPBOARD_INCR_COUNT) {
+		SI_STOPIF(SI_X11_CLIPBOARD_SENDS[i].requestor == 0, continue);
+		SI_STOPIF(SI_X11_CLIPBOARD_SENDS[i].deadline > now, continue);
+		siapp__x11ClipboardSendEnd(i);
+	}
+}
+/* Sends the next chunk of the INCR transfer at the index. */
+F_TRAITS(intern)
+void siapp__x11ClipboardSendNext(usize index) {
+	Display* display = SI_X11_DISPLAY;
+	usize offset = SI_X11_CLIPBOARD_SENDS[index].offset;
+	usize len = si_min(SI_X11_CLIPBOARD_LEN - offset, siapp__x11ClipboardChunk(display));
 
-			for_range (i, 0, *keyCacheLen) { // TODO(EimaMei): Optimize this like the mouse button clear (len might not even be required).
-				siKeyState* s = &out->keys[keyCache[i]];
-				SK_TO_INT(*s) &= ~0x5; // Clear the clicked and released state at once.
-			}
+	XLockDisplay(display);
+	siapp__x11ErrorTrapBegin(display);
+	XChangeProperty(
+		display, SI_X11_CLIPBOARD_SENDS[index].requestor, SI_X11_CLIPBOARD_SENDS[index].property,
+		SI_X11_CLIPBOARD_SENDS[index].target, 8, PropModeReplace,
+		(u8*)&SI_X11_CLIPBOARD_TEXT[offset], (i32)len
+	);
+	b32 failed = siapp__x11ErrorTrapEnd(display);
+	XUnlockDisplay(display);
 
-			SK_TO_INT(out->keys[SK__EVENT]) &= ~SI_BIT(7);
-			*keyCacheLen= 0;
-		}
-		if (SI_NUM_BIT_GET(eventBits, SI_BIT(6))) { // Mouse buttons.
-			u64* mouseButtons = (u64*)out->mouseButtons;
-			*mouseButtons &= ~0x505050505; // Clears the clicked and released states of every mouse button at once.
-			SK_TO_INT(out->keys[SK__EVENT]) &= ~SI_BIT(6);
-		}
+	if (failed) {
+		/* NOTE(EimaMei): The requestor is most likely gone. */
+		SI_X11_CLIPBOARD_SENDS[index].selected = false;
+		siapp__x11ClipboardSendEnd(index);
+		return;
 	}
+	SI_X11_CLIPBOARD_SENDS[index].offset += len;
+	SI_X11_CLIPBOARD_SENDS[index].deadline = siapp__clockNs() + (u64)SI_CLIPBOARD_INCR_TIMEOUT * 1000000;
 
-#if defined(SIAPP_PLATFORM_API_WIN32)
-	{
-		//if (win->keyListenerEnabled) {
-		GetKeyState(VK_SHIFT);
-		GetKeyState(VK_MENU);
-		GetKeyboardState(SI_WIN32_KBSTATE);
+	/* NOTE(EimaMei): The empty chunk at the end tells the requestor that the
+	 * transfer is over. */
+	SI_STOPIF(len == 0, siapp__x11ClipboardSendEnd(index));
+}
+/* Forgets the served clipboard text and stops every transfer of it. */
+F_TRAITS(intern)
+void siapp__x11ClipboardClear(void) {
+	for_range (i, 0, SI_CLIPBOARD_INCR_COUNT) {
+		SI_STOPIF(SI_X11_CLIPBOARD_SENDS[i].requestor != 0, siapp__x11ClipboardSendEnd(i));
 	}
 
+	free(SI_X11_CLIPBOARD_TEXT);
+	SI_X11_CLIPBOARD_TEXT = nil;
+	SI_X11_CLIPBOARD_LEN = 0;
+	SI_X11_CLIPBOARD_OWNER = 0;
+}
+/* Writes the served text into the requestor's property in the target's format.
+ * Returns false if the target isn't supported. */
+F_TRAITS(intern)
+b32 siapp__x11ClipboardConvert(siWindow* win, Window requestor, Atom target, Atom property) {
+	SI_STOPIF(target != UTF8_STRING && target != XA_STRING, return false);
+	Display* display = win->display;
 
-	{
-		GetCursorPos((POINT*)&out->mouseRoot);
-		siPoint point = out->mouseRoot;
-		siRect rect = SI_RECT_PA(out->windowPos, out->windowSize);
-		out->mouseInside = siapp__collideRectPoint(rect, point);
+	if (SI_X11_CLIPBOARD_LEN <= siapp__x11ClipboardChunk(display)) {
+		XChangeProperty(
+			display, requestor, property, target, 8, PropModeReplace,
+			(u8*)SI_X11_CLIPBOARD_TEXT, (i32)SI_X11_CLIPBOARD_LEN
+		);
+		return true;
 	}
 
-	if (await) {
-		WaitMessage();
+	/* NOTE(EimaMei): The text is too large for a single request, so it gets sent
+	 * with the INCR protocol. The property only gets the size at first, after
+	 * which a new chunk is sent every time the requestor deletes it. */
+	siapp__x11ClipboardSendExpire();
+
+	usize index = 0;
+	while (index < SI_CLIPBOARD_INCR_COUNT && SI_X11_CLIPBOARD_SENDS[index].requestor != 0) {
+		index += 1;
 	}
+	SI_STOPIF(index == SI_CLIPBOARD_INCR_COUNT, return false);
+
+	SI_X11_CLIPBOARD_SENDS[index].requestor = requestor;
+	SI_X11_CLIPBOARD_SENDS[index].property = property;
+	SI_X11_CLIPBOARD_SENDS[index].target = target;
+	SI_X11_CLIPBOARD_SENDS[index].offset = 0;
+	SI_X11_CLIPBOARD_SENDS[index].deadline = siapp__clockNs() + (u64)SI_CLIPBOARD_INCR_TIMEOUT * 1000000;
+	SI_X11_CLIPBOARD_SENDS[index].selected = (siapp__windowMapGet(requestor) == nil);
+
+	/* NOTE(EimaMei): The requestor's property and destroy events get routed
+	 * to the owner by 'siapp__x11EventOwner'. Our own windows already get them. */
+	long size = (long)SI_X11_CLIPBOARD_LEN;
+	XLockDisplay(display);
+	siapp__x11ErrorTrapBegin(display);
+	SI_STOPIF(
+		SI_X11_CLIPBOARD_SENDS[index].selected,
+		XSelectInput(display, requestor, PropertyChangeMask | StructureNotifyMask)
+	);
+	XChangeProperty(display, requestor, property, INCR, 32, PropModeReplace, (u8*)&size, 1);
+	b32 failed = siapp__x11ErrorTrapEnd(display);
+	XUnlockDisplay(display);
 
-	MSG msg = {0};
-	while (true) {
-		b32 isOkay = PeekMessageW(&msg, 0, 0, 0, PM_REMOVE);
-		if (!isOkay) break;
+	if (failed) {
+		SI_X11_CLIPBOARD_SENDS[index].selected = false;
+		siapp__x11ClipboardSendEnd(index);
+		return false;
+	}
+	return true;
+}
+/* Answers another application's request for the clipboard. */
+F_TRAITS(intern)
+void siapp__x11ClipboardServe(siWindow* win, const XSelectionRequestEvent* request) {
+	Display* display = win->display;
+	/* NOTE(EimaMei): Obsolete clients don't give a property, in which case the
+	 * target is used as one. */
+	Atom property = (request->property != None) ? request->property : request->target;
+
+	XEvent reply = { SelectionNotify };
+	reply.xselection.display = request->display;
+	reply.xselection.requestor = request->requestor;
+	reply.xselection.selection = request->selection;
+	reply.xselection.target = request->target;
+	reply.xselection.time = request->time;
+	reply.xselection.property = None;
+
+	if (request->selection == CLIPBOARD && SI_X11_CLIPBOARD_TEXT != nil) {
+		if (request->target == TARGETS) {
+			const Atom targets[] = {TARGETS, MULTIPLE, UTF8_STRING, XA_STRING};
+			XChangeProperty(
+				display, request->requestor, property, 4, 32, PropModeReplace,
+				(u8*)targets, countof(targets)
+			);
+			reply.xselection.property = property;
+		}
+		else if (request->target == MULTIPLE) {
+			Atom* targets;
+			Atom actualType;
+			i32 actualFormat;
+			unsigned long count, bytesAfter;
 
-		TranslateMessage(&msg);
-		DispatchMessageW(&msg);
+			XGetWindowProperty(
+				display, request->requestor, property, 0, INT32_MAX / 4, False, ATOM_PAIR,
+				&actualType, &actualFormat, &count, &bytesAfter, (u8**)&targets
+			);
+
+			for (unsigned long i = 0; i + 1 < count; i += 2) {
+				b32 res = siapp__x11ClipboardConvert(win, request->requestor, targets[i], targets[i + 1]);
+				SI_STOPIF(!res, targets[i + 1] = None);
+			}
+
+			XChangeProperty(
+				display, request->requestor, property, ATOM_PAIR, 32, PropModeReplace,
+				(u8*)targets, (i32)count
+			);
+			XFree(targets);
+			reply.xselection.property = property;
+		}
+		else if (siapp__x11ClipboardConvert(win, request->requestor, request->target, property)) {
+			reply.xselection.property = property;
+		}
 	}
-#elif defined(SIAPP_PLATFORM_API_X11)
-	SI_ROOT_WINDOW = win;
 
-	typedef struct {
-		long source, version;
-		i32 format;
-	} XDND; /* data structure for xdnd events */
-	static XDND xdnd;
-	static siDropEvent* curNode = nil;
+	XSendEvent(display, request->requestor, False, NoEventMask, &reply);
+	XFlush(display);
+}
+/* Reads the next part of the requested clipboard text from the window's
+ * property. 'first' is set for the part that came with 'SelectionNotify'. */
+F_TRAITS(intern)
+void siapp__x11ClipboardRead(siWindow* win, b32 first) {
+	siClipboardText* clip = &win->e.clipboard;
 
+	Atom type;
+	i32 format;
+	unsigned long count, bytesAfter;
+	siByte* data = nil;
+
+	/* NOTE(EimaMei): Deleting the property asks the owner for the next chunk. */
+	i32 res = XGetWindowProperty(
+		win->display, win->hwnd, XSEL_DATA, 0, INT32_MAX / 4, True, AnyPropertyType,
+		&type, &format, &count, &bytesAfter, &data
+	);
+	XFlush(win->display);
+	SI_STOPIF(res != Success, siapp__clipboardNotify(win, SI_CLIPBOARD_FAILED); return);
 
-	XEvent event;
-	if (await) {
-		/* blocks until next event is recv'd, but DOES NOT REMOVE said event from queue so that
-		it will still be caught during the while loop below */
-		XPeekEvent(win->display, &event);
+	if (first && type == INCR) {
+		clip->__incr = true;
+		XFree(data);
+		return ;
 	}
 
+	siapp__clipboardAppend(clip, data, (format == 8) ? count : 0);
+	SI_STOPIF(data != nil, XFree(data));
+	siapp__clipboardNotify(win, (clip->__incr && count != 0) ? SI_CLIPBOARD_RECEIVING : SI_CLIPBOARD_DONE);
+}
+/* Handles the events of the clipboard for the window. Returns false if the
+ * event has nothing to do with it. */
+F_TRAITS(intern)
+b32 siapp__x11ClipboardEvent(siWindow* win, const XEvent* event) {
+	siClipboardText* clip = &win->e.clipboard;
 
-	#define SI_CHECK_WIN(struct, win) SI_STOPIF(struct.window != win, break)
+	switch (event->type) {
+		case SelectionNotify: {
+			SI_STOPIF(event->xselection.selection != CLIPBOARD, return false);
+			SI_STOPIF(clip->state != SI_CLIPBOARD_RECEIVING || clip->__incr, return true);
 
-	while (XEventsQueued(win->display, QueuedAlready) + XEventsQueued(win->display, QueuedAfterReading)) {
-		XNextEvent(win->display, &event);
+			if (event->xselection.property == None) {
+				siapp__clipboardAppend(clip, nil, 0);
+				siapp__clipboardNotify(win, SI_CLIPBOARD_FAILED);
+			}
+			else {
+				siapp__x11ClipboardRead(win, true);
+			}
+			return true;
+		}
+		case SelectionRequest: {
+			siapp__x11ClipboardServe(win, &event->xselectionrequest);
+			return true;
+		}
+		case SelectionClear: {
+			SI_STOPIF(event->xselectionclear.selection != CLIPBOARD, return false);
+			/* NOTE(EimaMei): Another one of our windows might've taken over. */
+			SI_STOPIF(event->xselectionclear.window == SI_X11_CLIPBOARD_OWNER, siapp__x11ClipboardClear());
+			return true;
+		}
+		case PropertyNotify: {
+			const XPropertyEvent* prop = &event->xproperty;
 
-		switch (event.type) {
-			case ClientMessage: {
-				SI_CHECK_WIN(event.xclient, win->hwnd);
-				out->type.isClosed = (event.xclient.data.l[0] == (long)WM_DELETE_WINDOW);
+			if (prop->state == PropertyNewValue) {
+				SI_STOPIF(prop->window != win->hwnd || prop->atom != XSEL_DATA, return true);
+				SI_STOPIF(clip->state == SI_CLIPBOARD_RECEIVING && clip->__incr, siapp__x11ClipboardRead(win, false));
+				return true;
+			}
 
-				/* NOTE(EimaMei): All of this is from 'https://github.com/ColleagueRiley/RGFW/blob/main/RGFW.h'. */
-				if (event.xclient.message_type == XdndEnter) {
-					u64 count;
-					Atom* formats = si_salloc(SI_KILO(2));
-					Bool list = event.xclient.data.l[1] & 1;
+			for_range (i, 0, SI_CLIPBOARD_INCR_COUNT) {
+				SI_STOPIF(SI_X11_CLIPBOARD_SENDS[i].requestor != prop->window, continue);
+				SI_STOPIF(SI_X11_CLIPBOARD_SENDS[i].property != prop->atom, continue);
 
-					xdnd.source  = event.xclient.data.l[0];
-					xdnd.version = event.xclient.data.l[1] >> 24;
-					xdnd.format  = None;
+				siapp__x11ClipboardSendNext(i);
+				break;
+			}
+			return true;
+		}
+		case DestroyNotify: {
+			/* NOTE(EimaMei): A requestor got destroyed in the middle of a
+			 * transfer, its events can't be deselected anymore. */
+			b32 found = false;
+			for_range (i, 0, SI_CLIPBOARD_INCR_COUNT) {
+				SI_STOPIF(SI_X11_CLIPBOARD_SENDS[i].requestor != event->xdestroywindow.window, continue);
+				SI_STOPIF(!SI_X11_CLIPBOARD_SENDS[i].selected, continue);
+
+				SI_X11_CLIPBOARD_SENDS[i].selected = false;
+				siapp__x11ClipboardSendEnd(i);
+				found = true;
+			}
+			return found;
+		}
+	}
 
-					if (xdnd.version > 5)
-						break;
+	return false;
+}
+/* Predicate for 'XIfEvent' that only takes out the events of the clipboard. */
+F_TRAITS(intern)
+Bool siapp__x11ClipboardIsEvent(Display* display, XEvent* event, XPointer arg) {
+	switch (event->type) {
+		case SelectionNotify: return event->xselection.selection == CLIPBOARD;
+		case SelectionRequest: return event->xselectionrequest.selection == CLIPBOARD;
+		case SelectionClear: return event->xselectionclear.selection == CLIPBOARD;
+		case PropertyNotify: return True;
+	}
 
-					if (list) {
-						Atom actualType;
-						i32 actualFormat;
-						u64 bytesAfter;
+	return False;
+	SI_UNUSED(display); SI_UNUSED(arg);
+}
+/* Requests the clipboard's text and waits until all of it has arrived, leaving
+ * the other events in the queue. */
+F_TRAITS(intern)
+const siClipboardText* siapp__x11ClipboardFetch(siWindow* win) {
+	siClipboardText* clip = &win->e.clipboard;
+	SI_STOPIF(clip->state != SI_CLIPBOARD_RECEIVING, siapp_clipboardTextRequest(win));
 
-						XGetWindowProperty(
-							win->display, xdnd.source, XdndTypeList,
-							0, INT64_MAX, False, 4,
-							&actualType, &actualFormat, &count, &bytesAfter,
-							(u8**)&formats
-						);
-					}
-					else {
-						count = 0;
-
-						if (event.xclient.data.l[2] != None)
-							formats[count++] = event.xclient.data.l[2];
-						if (event.xclient.data.l[3] != None)
-							formats[count++] = event.xclient.data.l[3];
-						if (event.xclient.data.l[4] != None)
-							formats[count++] = event.xclient.data.l[4];
-					}
+	while (clip->state == SI_CLIPBOARD_RECEIVING) {
+		XEvent event;
+		XIfEvent(win->display, &event, siapp__x11ClipboardIsEvent, nil);
 
-					for_range (i, 0, count) {
-						char* name = XGetAtomName(win->display, formats[i]);
-						char* links[2] = {"text/uri-list", "text/plain"};
+		siWindow* owner = siapp__windowMapGet(event.xany.window);
+		siapp__x11ClipboardEvent((owner != nil) ? owner : win, &event);
+	}
 
-						while (true) {
-							for_range (j, 0, 2) {
-								if (*links[j] != *name) {
-									links[j] = "\1";
-									continue;
-								}
+	return clip;
+}
+/* Loads XInput and returns true if it's version 2.1 or newer. */
+F_TRAITS(intern)
+b32 siapp__x11XiStartup(void) {
+	SI_STOPIF(SI_X11_XI_OPCODE != 0, return SI_X11_XI_OPCODE != -1);
+	SI_X11_XI_OPCODE = -1;
 
-								if (*links[j] == '\0' && *name == '\0')
-									xdnd.format = formats[i];
+	i32 opcode, firstEvent, firstError;
+	if (!XQueryExtension(SI_X11_DISPLAY, "XInputExtension", &opcode, &firstEvent, &firstError)) {
+		return false;
+	}
 
-								if (*links[j] != '\0' && *links[j] != '\1')
-									links[j]++;
-							}
+	SI_X11_XI = si_dllLoad("libXi.so.6");
+	SI_STOPIF(SI_X11_XI == nil, SI_X11_XI = si_dllLoad("libXi.so"));
+	SI_STOPIF(SI_X11_XI == nil, return false);
 
-							if (*name == '\0')
-								break;
+	si_XIQueryVersion = si_dllProcAddressFuncEx(SI_X11_XI, XIQueryVersion, XIQueryVersionProc);
+	si_XISelectEvents = si_dllProcAddressFuncEx(SI_X11_XI, XISelectEvents, XISelectEventsProc);
+	si_XIQueryDevice = si_dllProcAddressFuncEx(SI_X11_XI, XIQueryDevice, XIQueryDeviceProc);
+	si_XIFreeDeviceInfo = si_dllProcAddressFuncEx(SI_X11_XI, XIFreeDeviceInfo, XIFreeDeviceInfoProc);
 
-							name += 1;
-						}
-					}
+	/* NOTE(EimaMei): 2.1 is the version that added smooth scrolling. */
+	i32 major = 2, minor = 1;
+	if (si_XIQueryVersion(SI_X11_DISPLAY, &major, &minor) != Success || (major == 2 && minor < 1)) {
+		si_dllUnload(SI_X11_XI);
+		SI_X11_XI = nil;
+		return false;
+	}
 
-					if (list) {
-						XFree(formats);
-					}
-				}
-				else if (event.xclient.message_type == XdndPosition) {
-					const i32 xabs = (event.xclient.data.l[2] >> 16) & 0xffff;
-					const i32 yabs = (event.xclient.data.l[2]) & 0xffff;
-					Window dummy;
-					i32 xpos, ypos;
+	SI_X11_XI_OPCODE = opcode;
+	return true;
+}
+/* Selects or deselects the raw motion of every pointer on the root window. */
+F_TRAITS(intern)
+void siapp__x11XiSelect(b32 enable) {
+	siByte rawBits[XIMaskLen(XI_LASTEVENT)] = {0},
+		   hierarchyBits[XIMaskLen(XI_LASTEVENT)] = {0};
+	if (enable) {
+		XISetMask(rawBits, XI_RawMotion);
+		XISetMask(hierarchyBits, XI_HierarchyChanged);
+	}
+
+	/* NOTE(EimaMei): The server only accepts hierarchy events that are selected
+	 * for every device, for anything else it returns 'BadValue'. */
+	XIEventMask masks[2];
+	masks[0].deviceid = XIAllMasterDevices;
+	masks[0].mask_len = sizeof(rawBits);
+	masks[0].mask = rawBits;
+	masks[1].deviceid = XIAllDevices;
+	masks[1].mask_len = sizeof(hierarchyBits);
+	masks[1].mask = hierarchyBits;
+
+	si_XISelectEvents(SI_X11_DISPLAY, DefaultRootWindow(SI_X11_DISPLAY), masks, countof(masks));
+	SI_X11_XI_DEVICES_LEN = 0;
+}
+/* Returns the cached valuators of the device, querying them on the first use. */
+F_TRAITS(intern)
+siX11XiDevice* siapp__x11XiDevice(i32 id) {
+	for_range (i, 0, SI_X11_XI_DEVICES_LEN) {
+		SI_STOPIF(SI_X11_XI_DEVICES[i].id == id, return &SI_X11_XI_DEVICES[i]);
+	}
+
+	/* NOTE(EimaMei): The cache only gets cleared when the devices change, so
+	 * it can only fill up if there are more devices than it can hold. */
+	u32 slot = (SI_X11_XI_DEVICES_LEN < countof(SI_X11_XI_DEVICES))
+		? SI_X11_XI_DEVICES_LEN++
+		: countof(SI_X11_XI_DEVICES) - 1;
+	siX11XiDevice* device = &SI_X11_XI_DEVICES[slot];
+	memset(device, 0, sizeof(*device));
+	device->id = id;
+
+	i32 len;
+	XIDeviceInfo* info = si_XIQueryDevice(SI_X11_DISPLAY, id, &len);
+	SI_STOPIF(info == nil, return device);
+
+	for_range (i, 0, info->num_classes) {
+		const XIAnyClassInfo* any = info->classes[i];
+
+		switch (any->type) {
+			case XIValuatorClass: {
+				const XIValuatorClassInfo* valuator = (const XIValuatorClassInfo*)any;
+				SI_STOPIF(valuator->number >= (i32)countof(device->axes), break);
+
+				siX11XiAxis* axis = &device->axes[valuator->number];
+				axis->absolute = (valuator->mode == XIModeAbsolute);
+				SI_STOPIF(valuator->number < 2, axis->kind = valuator->number + 1);
+				break;
+			}
+			case XIScrollClass: {
+				const XIScrollClassInfo* scroll = (const XIScrollClassInfo*)any;
+				SI_STOPIF(scroll->number >= (i32)countof(device->axes), break);
 
-					if (xdnd.version > 5)
-						break;
+				siX11XiAxis* axis = &device->axes[scroll->number];
+				axis->kind = (scroll->scroll_type == XIScrollTypeVertical) ? 3 : 4;
+				axis->increment = (scroll->increment != 0) ? scroll->increment : 1;
+				break;
+			}
+		}
+	}
+	si_XIFreeDeviceInfo(info);
 
-					XTranslateCoordinates(
-						win->display, XDefaultRootWindow(win->display), win->hwnd,
-						xabs, yabs, &xpos, &ypos, &dummy
-					);
+	return device;
+}
+/* Returns the window that raw input goes to: the focused window, or the one
+ * the mouse is inside of. */
+F_TRAITS(intern)
+siWindow* siapp__x11XiTarget(void) {
+	siWindow* target = nil;
+
+	for_range (i, 0, SI_WINDOW_MAP_CAP) {
+		siWindow* win = SI_WINDOW_MAP[i].win;
+		SI_STOPIF(win == nil || win->rawMouse == SI_RAW_MOUSE_OFF, continue);
+		SI_STOPIF(win->e.focus, return win);
+		SI_STOPIF(win->e.mouseInside, target = win);
+	}
 
-					siPoint pos = SI_POINT(xpos, ypos);
-					siDropEvent* node = siapp__findDndNode(win, pos);
+	return target;
+}
+/* Adds the raw event's motion and scrolling to the window. */
+F_TRAITS(intern)
+void siapp__x11XiRawMotion(siWindow* win, const XIRawEvent* raw) {
+	siWindowEvent* out = &win->e;
+	siX11XiDevice* device = siapp__x11XiDevice(raw->sourceid);
 
-					out->type.mouseMove = true;
-					out->mouse = pos;
+	siVec2 delta = SI_VEC2(0, 0), scroll = SI_VEC2(0, 0);
+	i32 index = 0;
 
-					if (curNode != nil && curNode != node) {
-						curNode->state = SI_DRAG_LEAVE;
-						curNode = nil;
-					}
-					if (node) {
-						node->state = (curNode == nil) ? SI_DRAG_ENTER : SI_DRAG_OVER;
-						curNode = node;
-					}
+	for_range (i, 0, si_min(raw->valuators.mask_len * 8, (i32)countof(device->axes))) {
+		SI_STOPIF(!XIMaskIsSet(raw->valuators.mask, i), continue);
+		siX11XiAxis* axis = &device->axes[i];
 
+		/* NOTE(EimaMei): The raw values skip the pointer acceleration, the
+		 * others are needed for scrolling as the increment is given in them. */
+		f64 value = (axis->kind <= 2) ? raw->raw_values[index] : raw->valuators.values[index];
+		index += 1;
 
-					XEvent reply = { ClientMessage };
-					reply.xclient.window = xdnd.source;
-					reply.xclient.message_type = XdndStatus;
-					reply.xclient.format = 32;
-					reply.xclient.data.l[0] = win->hwnd;
-					reply.xclient.data.l[2] = 0;
-					reply.xclient.data.l[3] = 0;
+		if (axis->absolute) {
+			f64 last = axis->last;
+			b32 lastValid = axis->lastValid;
+			axis->last = value;
+			axis->lastValid = true;
 
-					if (xdnd.format && node) {
-						reply.xclient.data.l[1] = 1;
-						if (xdnd.version >= 2)
-							reply.xclient.data.l[4] = XdndActionCopy;
-					}
+			SI_STOPIF(!lastValid, continue);
+			value -= last;
+		}
 
-					XSendEvent(win->display, xdnd.source, False, NoEventMask, &reply);
-					XFlush(win->display);
+		switch (axis->kind) {
+			case 1: delta.x += value; break;
+			case 2: delta.y += value; break;
+			case 3: scroll.y += value / axis->increment; break;
+			case 4: scroll.x += value / axis->increment; break;
+		}
+	}
+
+	SI_STOPIF(!out->focus, delta = SI_VEC2(0, 0));
+	SI_STOPIF(!out->mouseInside, scroll = SI_VEC2(0, 0));
+	SI_STOPIF(delta.x == 0 && delta.y == 0 && scroll.x == 0 && scroll.y == 0, return);
+
+	out->type.mouseRaw = true;
+	out->mouseDelta.x += delta.x;
+	out->mouseDelta.y += delta.y;
+	out->mouseScroll.x += scroll.x;
+	out->mouseScroll.y += scroll.y;
+
+	if (win->rawMouse == SI_RAW_MOUSE_HISTORY) {
+		siEvent* queued = siapp__eventPush(win, SI_EVENT_MOUSE_RAW, raw->time);
+		queued->delta = delta;
+		queued->scroll = scroll;
+		queued->pos = out->mouse;
+	}
+}
+/* Handles the XInput events, returns false if the event isn't one. */
+F_TRAITS(intern)
+b32 siapp__x11XiEvent(siWindow* win, XEvent* event) {
+	XGenericEventCookie* cookie = &event->xcookie;
+	SI_STOPIF(event->type != GenericEvent || cookie->extension != SI_X11_XI_OPCODE, return false);
+	SI_STOPIF(!XGetEventData(win->display, cookie), return true);
+
+	switch (cookie->evtype) {
+		case XI_RawMotion: {
+			siapp__x11XiRawMotion(win, (const XIRawEvent*)cookie->data);
+			break;
+		}
+		case XI_HierarchyChanged: {
+			SI_X11_XI_DEVICES_LEN = 0;
+			break;
+		}
+	}
+
+	XFreeEventData(win->display, cookie);
+	return true;
+}
+/* Hands a single event over to the window it's for. */
+F_TRAITS(intern)
+void siapp__x11EventDispatch(siWindow* win, XEvent* event) {
+	siWindowEvent* out = &win->e;
+
+	typedef struct {
+		long source, version;
+		i32 format;
+	} XDND; /* data structure for xdnd events */
+	static XDND xdnd;
+	static siDropEvent* curNode = nil;
+
+	SI_STOPIF(siapp__x11ClipboardEvent(win, event), return);
+	SI_STOPIF(siapp__x11XiEvent(win, event), return);
+
+	#define SI_CHECK_WIN(struct, win) SI_STOPIF(struct.window != win, break)
+
+	switch (event->type) {
+		case ClientMessage: {
+			SI_CHECK_WIN(event->xclient, win->hwnd);
+			out->type.isClosed = (event->xclient.data.l[0] == (long)WM_DELETE_WINDOW);
+			SI_STOPIF(out->type.isClosed, siapp__eventPush(win, SI_EVENT_CLOSE, 0));
+
+			/* NOTE(EimaMei): All of this is from 'https://github.com/ColleagueRiley/RGFW/blob/main/RGFW.h'. */
+			if (event->xclient.message_type == XdndEnter) {
+				u64 count;
+				Atom* formats = si_salloc(SI_KILO(2));
+				Bool list = event->xclient.data.l[1] & 1;
+
+				xdnd.source  = event->xclient.data.l[0];
+				xdnd.version = event->xclient.data.l[1] >> 24;
+				xdnd.format  = None;
+
+				if (xdnd.version > 5)
+					break;
+
+				if (list) {
+					Atom actualType;
+					i32 actualFormat;
+					u64 bytesAfter;
+
+					XGetWindowProperty(
+						win->display, xdnd.source, XdndTypeList,
+						0, INT64_MAX, False, 4,
+						&actualType, &actualFormat, &count, &bytesAfter,
+						(u8**)&formats
+					);
+				}
+				else {
+					count = 0;
+
+					if (event->xclient.data.l[2] != None)
+						formats[count++] = event->xclient.data.l[2];
+					if (event->xclient.data.l[3] != None)
+						formats[count++] = event->xclient.data.l[3];
+					if (event->xclient.data.l[4] != None)
+						formats[count++] = event->xclient.data.l[4];
 				}
-				else if (event.xclient.message_type == XdndDrop) {
-					if (xdnd.version > 5)
-						break;
 
-					if (xdnd.format) {
-						Time time = (xdnd.version >= 1)
-							? event.xclient.data.l[2]
-							: CurrentTime;
+				for_range (i, 0, count) {
+					char* name = XGetAtomName(win->display, formats[i]);
+					char* links[2] = {"text/uri-list", "text/plain"};
 
-						XConvertSelection(
-							win->display, XdndSelection, xdnd.format,
-							XdndSelection, win->hwnd, time
-						);
-					}
-					else if (xdnd.version >= 2) {
-						XEvent reply = { ClientMessage };
-						reply.xclient.window = xdnd.source;
-						reply.xclient.message_type = XdndFinished;
-						reply.xclient.format = 32;
-						reply.xclient.data.l[0] = win->hwnd;
-						reply.xclient.data.l[1] = 0;
-						reply.xclient.data.l[2] = None;
-
-						XSendEvent(win->display, xdnd.source, False, NoEventMask, &reply);
-						XFlush(win->display);
+					while (true) {
+						for_range (j, 0, 2) {
+							if (*links[j] != *name) {
+								links[j] = "\1";
+								continue;
+							}
+
+							if (*links[j] == '\0' && *name == '\0')
+								xdnd.format = formats[i];
+
+							if (*links[j] != '\0' && *links[j] != '\1')
+								links[j]++;
+						}
+
+						if (*name == '\0')
+							break;
+
+						name += 1;
 					}
 				}
-				else if (event.xclient.message_type == XdndLeave && curNode != nil) {
+
+				if (list) {
+					XFree(formats);
+				}
+			}
+			else if (event->xclient.message_type == XdndPosition) {
+				const i32 xabs = (event->xclient.data.l[2] >> 16) & 0xffff;
+				const i32 yabs = (event->xclient.data.l[2]) & 0xffff;
+				Window dummy;
+				i32 xpos, ypos;
+
+				if (xdnd.version > 5)
+					break;
+
+				XTranslateCoordinates(
+					win->display, XDefaultRootWindow(win->display), win->hwnd,
+					xabs, yabs, &xpos, &ypos, &dummy
+				);
+
+				siPoint pos = SI_POINT(xpos, ypos);
+				siDropEvent* node = siapp__findDndNode(win, pos);
+
+				out->type.mouseMove = true;
+				out->mouse = pos;
+
+				if (curNode != nil && curNode != node) {
 					curNode->state = SI_DRAG_LEAVE;
 					curNode = nil;
 				}
+				if (node) {
+					node->state = (curNode == nil) ? SI_DRAG_ENTER : SI_DRAG_OVER;
+					curNode = node;
+				}
 
-				break;
-			}
-			case SelectionNotify: {
-				SI_STOPIF(event.xselection.property != XdndSelection, break);
-				SI_CHECK_WIN(event.xclient, win->hwnd);
 
-				char* data;
-				u64 result;
+				XEvent reply = { ClientMessage };
+				reply.xclient.window = xdnd.source;
+				reply.xclient.message_type = XdndStatus;
+				reply.xclient.format = 32;
+				reply.xclient.data.l[0] = win->hwnd;
+				reply.xclient.data.l[2] = 0;
+				reply.xclient.data.l[3] = 0;
 
-				Atom actualType;
-				i32 actualFormat;
-				u64 bytesAfter;
+				if (xdnd.format && node) {
+					reply.xclient.data.l[1] = 1;
+					if (xdnd.version >= 2)
+						reply.xclient.data.l[4] = XdndActionCopy;
+				}
 
-				XGetWindowProperty(
-					win->display, event.xselection.requestor, event.xselection.property,
-					0, INT64_MAX, False, event.xselection.target,
-					&actualType, &actualFormat, &result, &bytesAfter, (u8**)&data
-				);
-				curNode->state = SI_DRAG_DROP;
-				curNode->data = data;
-				curNode = nil;
+				XSendEvent(win->display, xdnd.source, False, NoEventMask, &reply);
+				XFlush(win->display);
+			}
+			else if (event->xclient.message_type == XdndDrop) {
+				if (xdnd.version > 5)
+					break;
 
-				if (xdnd.version >= 2) {
+				if (xdnd.format) {
+					Time time = (xdnd.version >= 1)
+						? event->xclient.data.l[2]
+						: CurrentTime;
+
+					XConvertSelection(
+						win->display, XdndSelection, xdnd.format,
+						XdndSelection, win->hwnd, time
+					);
+				}
+				else if (xdnd.version >= 2) {
 					XEvent reply = { ClientMessage };
 					reply.xclient.window = xdnd.source;
 					reply.xclient.message_type = XdndFinished;
 					reply.xclient.format = 32;
 					reply.xclient.data.l[0] = win->hwnd;
-					reply.xclient.data.l[1] = result;
-					reply.xclient.data.l[2] = XdndActionCopy;
+					reply.xclient.data.l[1] = 0;
+					reply.xclient.data.l[2] = None;
 
 					XSendEvent(win->display, xdnd.source, False, NoEventMask, &reply);
 					XFlush(win->display);
 				}
+			}
+			else if (event->xclient.message_type == XdndLeave && curNode != nil) {
+				curNode->state = SI_DRAG_LEAVE;
+				curNode = nil;
+			}
 
-				break;
+			break;
+		}
+		case SelectionNotify: {
+			SI_STOPIF(event->xselection.property != XdndSelection, break);
+			SI_CHECK_WIN(event->xclient, win->hwnd);
+
+			char* data;
+			u64 result;
+
+			Atom actualType;
+			i32 actualFormat;
+			u64 bytesAfter;
+
+			XGetWindowProperty(
+				win->display, event->xselection.requestor, event->xselection.property,
+				0, INT64_MAX, False, event->xselection.target,
+				&actualType, &actualFormat, &result, &bytesAfter, (u8**)&data
+			);
+			curNode->state = SI_DRAG_DROP;
+			curNode->data = data;
+			curNode = nil;
+
+			if (xdnd.version >= 2) {
+				XEvent reply = { ClientMessage };
+				reply.xclient.window = xdnd.source;
+				reply.xclient.message_type = XdndFinished;
+				reply.xclient.format = 32;
+				reply.xclient.data.l[0] = win->hwnd;
+				reply.xclient.data.l[1] = result;
+				reply.xclient.data.l[2] = XdndActionCopy;
+
+				XSendEvent(win->display, xdnd.source, False, NoEventMask, &reply);
+				XFlush(win->display);
 			}
-			case KeyPress: {
-				SI_CHECK_WIN(event.xkey, win->hwnd);
-				KeySym sym = XLookupKeysym(&event.xkey, 0);
-				siKeyType key = siapp_osKeyToSili(sym);
 
-				out->type.keyPress = true;
-				out->curKey = key;
+			break;
+		}
+		case KeyPress: {
+			SI_CHECK_WIN(event->xkey, win->hwnd);
+			KeySym sym = XLookupKeysym(&event->xkey, 0);
+			siKeyType key = siapp_osKeyToSili(sym);
 
-				siKeyState* keyState = &out->keys[key];
-				keyState->clicked = !keyState->pressed;
-				keyState->pressed = true;
-				keyState->released = false;
+			out->type.keyPress = true;
+			out->curKey = key;
 
-				if (keyState->clicked) {
-					SK_TO_INT(out->keys[SK__EVENT]) |= SI_BIT(7);
-					out->__private.keyCache[out->__private.keyCacheLen % 16] = key;
-					out->__private.keyCacheLen += 1;
-				}
+			b32 clicked = siapp__keyPress(out, key);
 
-				int len = Xutf8LookupString(
-					win->__x11Xic, &event.xkey,
-					&out->charBuffer[out->charBufferLen], sizeof(out->charBuffer) - out->charBufferLen,
-					nil, nil
-				);
-				out->charBufferLen += len;
+			siEvent* queued = siapp__eventPush(win, SI_EVENT_KEY_PRESS, event->xkey.time);
+			queued->key = key;
+			queued->pos = SI_POINT(event->xkey.x, event->xkey.y);
+			queued->state = !clicked;
+
+			int len = Xutf8LookupString(
+				win->__x11Xic, &event->xkey,
+				&out->charBuffer[out->charBufferLen], sizeof(out->charBuffer) - out->charBufferLen,
+				nil, nil
+			);
+			out->charBufferLen += len;
 #if 0
-				if (isDown && !isE1 && !isE0) {
-					u16 buf[4];
-					i32 numChars = ToUnicode(vk, scanCode, SI_WIN32_KBSTATE, buf, countof(buf) - 1, 0);
-					SI_STOPIF(numChars == 0, break);
+			if (isDown && !isE1 && !isE0) {
+				u16 buf[4];
+				i32 numChars = ToUnicode(vk, scanCode, SI_WIN32_KBSTATE, buf, countof(buf) - 1, 0);
+				SI_STOPIF(numChars == 0, break);
 
-					usize len = e->charBufferLen;
-					usize addedLen;
+				usize len = e->charBufferLen;
+				usize addedLen;
 
-					siAllocator tmp = si_allocatorMakeTmp(&e->charBuffer[len], sizeof(e->charBuffer) - len);
-					si_utf16ToUtf8Str(&tmp, buf, &addedLen);
-					e->charBufferLen += addedLen;
-				}
-#endif
-				break;
+				siAllocator tmp = si_allocatorMakeTmp(&e->charBuffer[len], sizeof(e->charBuffer) - len);
+				si_utf16ToUtf8Str(&tmp, buf, &addedLen);
+				e->charBufferLen += addedLen;
 			}
-			case KeyRelease: {
-				SI_CHECK_WIN(event.xkey, win->hwnd);
-				if (XEventsQueued(win->display, QueuedAfterReading)) { /* get next event if there is one*/
-					XEvent next;
-					XPeekEvent(win->display, &next);
-
-					if (event.xkey.time == next.xkey.time
-						&& event.xkey.keycode == next.xkey.keycode) {
-						break;
-					}
+#endif
+			break;
+		}
+		case KeyRelease: {
+			SI_CHECK_WIN(event->xkey, win->hwnd);
+			if (XEventsQueued(win->display, QueuedAfterReading)) { /* get next event if there is one*/
+				XEvent next;
+				XPeekEvent(win->display, &next);
+
+				if (event->xkey.time == next.xkey.time
+					&& event->xkey.keycode == next.xkey.keycode) {
+					break;
 				}
+			}
 
-				KeySym sym = XLookupKeysym(&event.xkey, 0);
-				siKeyType key = siapp_osKeyToSili(sym);
+			KeySym sym = XLookupKeysym(&event->xkey, 0);
+			siKeyType key = siapp_osKeyToSili(sym);
 
-				out->type.keyRelease = true;
-				out->curKey = key;
+			out->type.keyRelease = true;
+			out->curKey = key;
 
-				siKeyState* keyState = &out->keys[key];
-				keyState->clicked = false;
-				keyState->pressed = false;
-				keyState->released = true;
+			siapp__keyRelease(out, key);
 
-				SK_TO_INT(out->keys[SK__EVENT]) |= SI_BIT(7);
-				out->__private.keyCache[out->__private.keyCacheLen % 16] = key;
-				out->__private.keyCacheLen += 1;
-				break;
+			siEvent* queued = siapp__eventPush(win, SI_EVENT_KEY_RELEASE, event->xkey.time);
+			queued->key = key;
+			queued->pos = SI_POINT(event->xkey.x, event->xkey.y);
+			break;
+		}
+		case MotionNotify: {
+			SI_CHECK_WIN(event->xmotion, win->hwnd);
+			out->type.mouseMove = true;
+
+			out->mouseRoot = SI_POINT(event->xmotion.x_root, event->xmotion.y_root);
+			out->mouse = SI_POINT(event->xmotion.x, event->xmotion.y);
+			siapp__eventPush(win, SI_EVENT_MOUSE_MOVE, event->xmotion.time)->pos = out->mouse;
+			out->mouseScaled = SI_VEC2(
+				(f32)out->mouse.x / win->scaleFactor.x,
+				(f32)out->mouse.y / win->scaleFactor.y
+			);
+
+			#if !defined(SIAPP_NO_X11_RESIZABLE_WINDOW)
+			if (win->arg & SI_WINDOW_BORDERLESS && !(win->arg & SI_WINDOW_NO_RESIZE)) {
+				static b32 ismoving = false;
+				if (!ismoving) {
+					siResizeOperation op = siapp_windowResizeOperationFind(win);
+					static siResizeOperation lastOp = -1;
+
+					Cursor cursor;
+					#define SI_DEF_CUR(val, cursorVal) op = val; cursor = siapp__x11GetCursor(cursorVal); break
+					switch (op) {
+						case SI_RESIZE_OPERATION_LEFT:        SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_LEFT,        SI_CURSOR_RESIZE_LEFT);
+						case SI_RESIZE_OPERATION_RIGHT:       SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_RIGHT,       SI_CURSOR_RESIZE_RIGHT);
+						case SI_RESIZE_OPERATION_TOP:         SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_TOP,         SI_CURSOR_RESIZE_TOP);
+						case SI_RESIZE_OPERATION_BOTTOM:      SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_BOTTOM,      SI_CURSOR_RESIZE_BOTTOM);
+						case SI_RESIZE_OPERATION_TOPLEFT:     SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_TOPLEFT,     SI_CURSOR_RESIZE_TOPLEFT);
+						case SI_RESIZE_OPERATION_TOPRIGHT:    SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_TOPRIGHT,    SI_CURSOR_RESIZE_TOPRIGHT);
+						case SI_RESIZE_OPERATION_BOTTOMLEFT:  SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_BOTTOMLEFT,  SI_CURSOR_RESIZE_BOTTOMLEFT);
+						case SI_RESIZE_OPERATION_BOTTOMRIGHT: SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_BOTTOMRIGHT, SI_CURSOR_RESIZE_BOTTOMRIGHT);
+						default: op = _NET_WM_MOVERESIZE_MOVE; cursor = (win->cursor > 0) ? siapp__x11GetCursor(win->cursor) : (Cursor)(-win->cursor);
+					}
+					#undef SI_DEF_CUR
+					ismoving = (out->mousePressed & SI_BIT(SI_MOUSE_LEFT - 1)) != 0;
+
+					if (ismoving) {
+						siapp__x11SendResizeEvent(win, op);
+					}
+					else if (op != lastOp) {
+						XDefineCursor(win->display, win->hwnd, cursor);
+						lastOp = op;
+					}
+				}
+				else if (ismoving && win->__x11LastType.windowMouseChange && out->mouseInside) {
+					ismoving = false;
+					siapp__mouseButtonRelease(out, SI_MOUSE_LEFT);
+					siapp__x11SendResizeEvent(win, _NET_WM_MOVERESIZE_CANCEL);
+				}
 			}
-			case MotionNotify: {
-				SI_CHECK_WIN(event.xmotion, win->hwnd);
-				out->type.mouseMove = true;
+			#endif
+			break;
+		}
+		case ButtonPress: {
+			SI_CHECK_WIN(event->xbutton, win->hwnd);
+
+			i32 button = event->xbutton.button;
 
-				out->mouseRoot = SI_POINT(event.xmotion.x_root, event.xmotion.y_root);
-				out->mouse = SI_POINT(event.xmotion.x, event.xmotion.y);
+			if (si_between(button, 4, 7)) { // Mouse wheel up/down/left/right
+				out->type.mouseScroll = true;
+
+				out->mouseWheel = button - 3;
+				out->mouseRoot = SI_POINT(event->xbutton.x_root, event->xbutton.y_root);
+				out->mouse = SI_POINT(event->xbutton.x, event->xbutton.y);
 				out->mouseScaled = SI_VEC2(
 					(f32)out->mouse.x / win->scaleFactor.x,
 					(f32)out->mouse.y / win->scaleFactor.y
 				);
 
-				#if !defined(SIAPP_NO_X11_RESIZABLE_WINDOW)
-				if (win->arg & SI_WINDOW_BORDERLESS && !(win->arg & SI_WINDOW_NO_RESIZE)) {
-					static b32 ismoving = false;
-					if (!ismoving) {
-						siResizeOperation op = siapp_windowResizeOperationFind(win);
-						static siResizeOperation lastOp = -1;
-
-						Cursor cursor;
-						#define SI_DEF_CUR(val, cursorVal) op = val; cursor = siapp__x11GetCursor(cursorVal); break
-						switch (op) {
-							case SI_RESIZE_OPERATION_LEFT:        SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_LEFT,        SI_CURSOR_RESIZE_LEFT);
-							case SI_RESIZE_OPERATION_RIGHT:       SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_RIGHT,       SI_CURSOR_RESIZE_RIGHT);
-							case SI_RESIZE_OPERATION_TOP:         SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_TOP,         SI_CURSOR_RESIZE_TOP);
-							case SI_RESIZE_OPERATION_BOTTOM:      SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_BOTTOM,      SI_CURSOR_RESIZE_BOTTOM);
-							case SI_RESIZE_OPERATION_TOPLEFT:     SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_TOPLEFT,     SI_CURSOR_RESIZE_TOPLEFT);
-							case SI_RESIZE_OPERATION_TOPRIGHT:    SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_TOPRIGHT,    SI_CURSOR_RESIZE_TOPRIGHT);
-							case SI_RESIZE_OPERATION_BOTTOMLEFT:  SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_BOTTOMLEFT,  SI_CURSOR_RESIZE_BOTTOMLEFT);
-							case SI_RESIZE_OPERATION_BOTTOMRIGHT: SI_DEF_CUR(_NET_WM_MOVERESIZE_SIZE_BOTTOMRIGHT, SI_CURSOR_RESIZE_BOTTOMRIGHT);
-							default: op = _NET_WM_MOVERESIZE_MOVE; cursor = (win->cursor > 0) ? siapp__x11GetCursor(win->cursor) : (Cursor)(-win->cursor);
-						}
-						#undef SI_DEF_CUR
-						ismoving = out->mouseButtons[0].pressed;
+				siEvent* queued = siapp__eventPush(win, SI_EVENT_MOUSE_SCROLL, event->xbutton.time);
+				queued->button = out->mouseWheel;
+				queued->pos = out->mouse;
 
-						if (ismoving) {
-							siapp__x11SendResizeEvent(win, op);
-						}
-						else if (op != lastOp) {
-							XDefineCursor(win->display, win->hwnd, cursor);
-							lastOp = op;
-						}
-					}
-					else if (ismoving && oldType.windowMouseChange && out->mouseInside) {
-						ismoving = false;
-						siapp__mouseButtonRelease(out, SI_MOUSE_LEFT);
-						siapp__x11SendResizeEvent(win, _NET_WM_MOVERESIZE_CANCEL);
-					}
-				}
-				#endif
 				break;
 			}
-			case ButtonPress: {
-				SI_CHECK_WIN(event.xbutton, win->hwnd);
+			else if (button > 7) { button -= 4; } // X1/X2 buttons
+
+			siapp__mouseButtonPress(out, button);
+			out->type.mousePress = true;
 
-				i32 button = event.xbutton.button;
+			out->mouseRoot = SI_POINT(event->xbutton.x_root, event->xbutton.y_root);
+			out->mouse = SI_POINT(event->xbutton.x, event->xbutton.y);
+			out->mouseScaled = SI_VEC2(
+				(f32)out->mouse.x / win->scaleFactor.x,
+				(f32)out->mouse.y / win->scaleFactor.y
+			);
 
-				if (si_between(button, 4, 7)) { // Mouse wheel up/down/left/right
-					out->type.mouseScroll = true;
+			siEvent* queued = siapp__eventPush(win, SI_EVENT_MOUSE_PRESS, event->xbutton.time);
+			queued->button = button;
+			queued->pos = out->mouse;
 
-					out->mouseWheel = button - 3;
-					out->mouseRoot = SI_POINT(event.xbutton.x_root, event.xbutton.y_root);
-					out->mouse = SI_POINT(event.xbutton.x, event.xbutton.y);
-					out->mouseScaled = SI_VEC2(
-						(f32)out->mouse.x / win->scaleFactor.x,
-						(f32)out->mouse.y / win->scaleFactor.y
-					);
 
-					break;
-				}
-				else if (button > 7) { button -= 4; } // X1/X2 buttons
+			break;
+		}
+		case ButtonRelease: {
+			SI_CHECK_WIN(event->xbutton, win->hwnd);
 
-				siapp__mouseButtonPress(out, button);
-				out->type.mousePress = true;
+			i32 button = event->xbutton.button;
+			if (si_between(button, 4, 7)) { // Mouse wheel up/down/left/right
+				break;
+			}
+			else if (button > 7) { button -= 4; } // X1/X2 buttons
+
+			siapp__mouseButtonRelease(out, button);
+			out->type.mouseRelease = true;
+			out->mouseRoot = SI_POINT(event->xbutton.x_root, event->xbutton.y_root);
+			out->mouse = SI_POINT(event->xbutton.x, event->xbutton.y);
+			out->mouseScaled = SI_VEC2(
+				(f32)out->mouse.x / win->scaleFactor.x,
+				(f32)out->mouse.y / win->scaleFactor.y
+			);
 
-				out->mouseRoot = SI_POINT(event.xbutton.x_root, event.xbutton.y_root);
-				out->mouse = SI_POINT(event.xbutton.x, event.xbutton.y);
-				out->mouseScaled = SI_VEC2(
-					(f32)out->mouse.x / win->scaleFactor.x,
-					(f32)out->mouse.y / win->scaleFactor.y
-				);
+			siEvent* queued = siapp__eventPush(win, SI_EVENT_MOUSE_RELEASE, event->xbutton.time);
+			queued->button = button;
+			queued->pos = out->mouse;
+			break;
+		}
+		case ConfigureNotify: {
+			SI_CHECK_WIN(event->xconfigure, win->hwnd);
+			siPoint pos = SI_POINT(event->xconfigure.x, event->xconfigure.y);
+			siArea size = SI_AREA(event->xconfigure.width, event->xconfigure.height);
+
+			if (!si_pointCmp(out->windowPos, pos)) {
+				out->type.windowMove = true;
+				out->windowPos = pos;
+				siapp__eventPush(win, SI_EVENT_WINDOW_MOVE, 0)->pos = pos;
+			}
+
+			if (!si_areaCmp(out->windowSize, size)) {
+				siapp__resizeWindow(win, size.width, size.height, true);
+				siapp__eventPush(win, SI_EVENT_WINDOW_RESIZE, 0)->pos = SI_POINT(size.width, size.height);
+			}
+
+			break;
+		}
+		case Expose: {
+			SI_CHECK_WIN(event->xexpose, win->hwnd);
+			win->redraw = true;
+			break;
+		}
+		case FocusIn: {
+			SI_CHECK_WIN(event->xfocus, win->hwnd);
+			out->type.windowFocusChange = true;
+			out->focus = true;
+			siapp__eventPush(win, SI_EVENT_WINDOW_FOCUS, 0)->state = true;
+			break;
+		}
+		case FocusOut: {
+			SI_CHECK_WIN(event->xfocus, win->hwnd);
+			out->type.windowFocusChange = true;
+			out->focus = false;
+			siapp__eventPush(win, SI_EVENT_WINDOW_FOCUS, 0)->state = false;
+			break;
+		}
+		case EnterNotify: {
+			out->type.windowMouseChange = true;
+			out->mouseInside = true;
+
+			siEvent* queued = siapp__eventPush(win, SI_EVENT_WINDOW_MOUSE_CHANGE, event->xcrossing.time);
+			queued->pos = SI_POINT(event->xcrossing.x, event->xcrossing.y);
+			queued->state = true;
+			break;
+		}
+		case LeaveNotify: {
+			out->type.windowMouseChange = true;
+			out->mouseInside = false;
+
+			siEvent* queued = siapp__eventPush(win, SI_EVENT_WINDOW_MOUSE_CHANGE, event->xcrossing.time);
+			queued->pos = SI_POINT(event->xcrossing.x, event->xcrossing.y);
+			queued->state = false;
+			break;
+		}
+	}
+	#undef SI_CHECK_WIN
+}
+/* Returns the window that the event is for, 'nil' if it's for none of them. */
+F_TRAITS(intern)
+siWindow* siapp__x11EventOwner(const XEvent* event) {
+	/* NOTE(EimaMei): Generic events aren't sent to any window, raw input goes
+	 * to the window that currently wants it. */
+	SI_STOPIF(event->type == GenericEvent, return siapp__x11XiTarget());
+
+	siWindow* owner = siapp__windowMapGet(event->xany.window);
+	SI_STOPIF(owner != nil || (event->type != PropertyNotify && event->type != DestroyNotify), return owner);
+
+	/* NOTE(EimaMei): The property and destroy events of another application's
+	 * window only matter while the clipboard is being sent to it. */
+	for_range (i, 0, SI_CLIPBOARD_INCR_COUNT) {
+		SI_STOPIF(SI_X11_CLIPBOARD_SENDS[i].requestor != event->xany.window, continue);
+		return siapp__windowMapGet(SI_X11_CLIPBOARD_OWNER);
+	}
+
+	return nil;
+}
+/* Predicate for 'XCheckIfEvent' that only takes out the window's own events
+ * and the events of windows that don't exist anymore. */
+F_TRAITS(intern)
+Bool siapp__x11EventIsFor(Display* display, XEvent* event, XPointer arg) {
+	const siWindow* win = (const siWindow*)arg;
+	SI_STOPIF(event->type != GenericEvent && event->xany.window == win->hwnd, return True);
+	siWindow* owner = siapp__x11EventOwner(event);
+
+	/* NOTE(EimaMei): The events of other windows stay queued for their own
+	 * update. It gets woken up, as it might be waiting on the socket that
+	 * this window has just read the events from. */
+	SI_STOPIF(owner == nil || owner == win, return True);
+
+	siapp_windowWake(owner);
+	return False;
+	SI_UNUSED(display);
+}
+/* Predicate for 'XCheckIfEvent' that leaves every event in the queue, only
+ * noting if one of them would be taken out by 'siapp__x11EventIsFor'. */
+F_TRAITS(intern)
+Bool siapp__x11EventIsQueuedFor(Display* display, XEvent* event, XPointer arg) {
+	const siWindow** win = (const siWindow**)arg;
+	SI_STOPIF(*win != nil && siapp__x11EventIsFor(display, event, (XPointer)*win), *win = nil);
+	return False;
+}
+#endif
+
+/* Clears the state that only lasts for a single update. */
+F_TRAITS(intern)
+void siapp__windowUpdateBegin(siWindow* win) {
+	siWindowEvent* out = &win->e;
+#if defined(SIAPP_PLATFORM_API_X11)
+	win->__x11LastType = out->type;
+#endif
+	win->cursorSet = false;
+	out->charBufferLen = 0;
+
+	out->type = (siEventType){0};
 
+	/* NOTE(EimaMei): Clicks and releases only last for a single update. The
+	 * sets are only a few words long, so clearing them costs less than finding
+	 * out if they changed. */
+	for_range (i, 0, countof(out->keysClicked.bits)) {
+		out->keysClicked.bits[i] = 0;
+		out->keysReleased.bits[i] = 0;
+	}
+	out->mouseClicked = 0;
+	out->mouseReleased = 0;
+	out->mouseDelta = SI_VEC2(0, 0);
+	out->mouseScroll = SI_VEC2(0, 0);
 
-				break;
-			}
-			case ButtonRelease: {
-				SI_CHECK_WIN(event.xbutton, win->hwnd);
+#if defined(SIAPP_PLATFORM_API_WIN32)
+	SI_STOPIF(win->arg & SI_WINDOW_HEADLESS, return);
 
-				i32 button = event.xbutton.button;
-				if (si_between(button, 4, 7)) { // Mouse wheel up/down/left/right
-					break;
-				}
-				else if (button > 7) { button -= 4; } // X1/X2 buttons
+	{
+		//if (win->keyListenerEnabled) {
+		GetKeyState(VK_SHIFT);
+		GetKeyState(VK_MENU);
+		GetKeyboardState(SI_WIN32_KBSTATE);
+	}
 
-				siapp__mouseButtonRelease(out, button);
-				out->type.mouseRelease = true;
-				out->mouseRoot = SI_POINT(event.xbutton.x_root, event.xbutton.y_root);
-				out->mouse = SI_POINT(event.xbutton.x, event.xbutton.y);
-				out->mouseScaled = SI_VEC2(
-					(f32)out->mouse.x / win->scaleFactor.x,
-					(f32)out->mouse.y / win->scaleFactor.y
-				);
-				break;
-			}
-			case ConfigureNotify: {
-				SI_CHECK_WIN(event.xconfigure, win->hwnd);
-				siPoint pos = SI_POINT(event.xconfigure.x, event.xconfigure.y);
-				siArea size = SI_AREA(event.xconfigure.width, event.xconfigure.height);
-
-				if (!si_pointCmp(out->windowPos, pos)) {
-					out->type.windowMove = true;
-					out->windowPos = pos;
-				}
 
-				if (!si_areaCmp(out->windowSize, size)) {
-					siapp__resizeWindow(win, size.width, size.height, true);
-				}
+	{
+		GetCursorPos((POINT*)&out->mouseRoot);
+		siPoint point = out->mouseRoot;
+		siRect rect = SI_RECT_PA(out->windowPos, out->windowSize);
+		out->mouseInside = siapp__collideRectPoint(rect, point);
+	}
+#endif
+}
+/* Reads the window's events from the platform, waiting for them first if
+ * 'await' is set. */
+F_TRAITS(intern)
+void siapp__windowDispatch(siWindow* win, b32 await) {
+	siWindowEvent* out = &win->e;
 
-				break;
-			}
-			case FocusIn: {
-				SI_CHECK_WIN(event.xfocus, win->hwnd);
-				out->type.windowFocusChange = true;
-				out->focus = true;
-				break;
-			}
-			case FocusOut: {
-				SI_CHECK_WIN(event.xfocus, win->hwnd);
-				out->type.windowFocusChange = true;
-				out->focus = false;
-				break;
-			}
-			case EnterNotify: {
-				out->type.windowMouseChange = true;
-				out->mouseInside = true;
-				break;
-			}
-			case LeaveNotify: {
-				out->type.windowMouseChange = true;
-				out->mouseInside = false;
-				break;
-			}
-		}
+#if defined(SIAPP_PLATFORM_API_WIN32)
+	if (await) {
+		MsgWaitForMultipleObjectsEx(1, &win->userEvents.wake[0], INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
 	}
-	#undef SI_CHECK_WIN
+
+	MSG msg = {0};
+	SIAPP_TRACE_BEGIN("siapp_windowUpdate: dispatch");
+	while (true) {
+		b32 isOkay = PeekMessageW(&msg, 0, 0, 0, PM_REMOVE);
+		if (!isOkay) break;
+
+		TranslateMessage(&msg);
+		DispatchMessageW(&msg);
+	}
+	SIAPP_TRACE_END();
+	SI_UNUSED(out);
+#elif defined(SIAPP_PLATFORM_API_X11)
+	SI_ROOT_WINDOW = win;
+	Display* display = win->display;
+	XEvent event;
+
+	SIAPP_TRACE_BEGIN("siapp_windowUpdate: dispatch");
+	while (true) {
+		/* NOTE(EimaMei): Every window shares the same display connection, so
+		 * only the window's own events get taken out of the queue. */
+		b32 found = false;
+		XEventsQueued(display, QueuedAfterFlush);
+
+		while (XCheckIfEvent(display, &event, siapp__x11EventIsFor, (XPointer)win)) {
+			b32 isOurs = (event.type != GenericEvent && event.xany.window == win->hwnd)
+				|| siapp__x11EventOwner(&event) == win;
+			SI_STOPIF(!isOurs, continue);
+			siapp__x11EventDispatch(win, &event);
+			found = true;
+		}
+		SI_STOPIF(!await || found, break);
+
+		/* NOTE(EimaMei): Unlike 'XPeekEvent', this also wakes up for
+		 * 'siapp_windowWake'. The queue gets checked once more after it. */
+		siWaitSource sources = siapp__waitPoll(win, ConnectionNumber(display), false, -1);
+		SI_STOPIF(sources & SI_WAIT_WAKE, await = false);
+	}
+	SIAPP_TRACE_END();
+	SI_UNUSED(out);
 #elif defined(SIAPP_PLATFORM_API_COCOA)
 	NSEvent* event;
 	if (await) {
@@ -3077,16 +6036,18 @@ eventLoop:
 				b32* type = (b32*)&out->type;
 				*type |= SI_BIT(SI_EVENT_KEY_PRESS + !click);
 
-				siKeyState* keyState = &out->keys[key];
-				keyState->clicked = click;
-				keyState->pressed = click;
-				keyState->released = !click;
-
-				SK_TO_INT(out->keys[SK__EVENT]) |= SI_BIT(7);
-				out->__private.keyCache[out->__private.keyCacheLen % 16] = key;
-				out->__private.keyCacheLen += 1;
+				if (click) {
+					siapp__keyPress(out, key);
+				}
+				else {
+					siapp__keyRelease(out, key);
+				}
 				SI_COCOA_OLD_MODIFIERS = modifiers;
 
+				siEvent* queued = siapp__eventPush(win, click ? SI_EVENT_KEY_PRESS : SI_EVENT_KEY_RELEASE, 0);
+				queued->key = key;
+				queued->pos = out->mouse;
+
 				break;
 			}
 			case NSEventTypeKeyDown: {
@@ -3095,16 +6056,12 @@ eventLoop:
 				out->type.keyPress = true;
 				out->curKey = key;
 
-				siKeyState* keyState = &out->keys[key];
-				keyState->clicked = !keyState->pressed;
-				keyState->pressed = true;
-				keyState->released = false;
+				b32 clicked = siapp__keyPress(out, key);
 
-				if (keyState->clicked) {
-					SK_TO_INT(out->keys[SK__EVENT]) |= SI_BIT(7);
-					out->__private.keyCache[out->__private.keyCacheLen % 16] = key;
-					out->__private.keyCacheLen += 1;
-				}
+				siEvent* queued = siapp__eventPush(win, SI_EVENT_KEY_PRESS, 0);
+				queued->key = key;
+				queued->pos = out->mouse;
+				queued->state = !clicked;
 
 				cstring buf = NSEvent_characters(event);
 				usize len = si_cstrLen(buf);
@@ -3119,14 +6076,11 @@ eventLoop:
 				out->type.keyRelease = true;
 				out->curKey = key;
 
-				siKeyState* keyState = &out->keys[key];
-				keyState->clicked = false;
-				keyState->pressed = false;
-				keyState->released = true;
+				siapp__keyRelease(out, key);
 
-				SK_TO_INT(out->keys[SK__EVENT]) |= SI_BIT(7);
-				out->__private.keyCache[out->__private.keyCacheLen % 16] = key;
-				out->__private.keyCacheLen += 1;
+				siEvent* queued = siapp__eventPush(win, SI_EVENT_KEY_RELEASE, 0);
+				queued->key = key;
+				queued->pos = out->mouse;
 				break;
 			}
 			case NSEventTypeLeftMouseDragged:
@@ -3145,25 +6099,31 @@ eventLoop:
 					pos.x / win->scaleFactor.y
 				);
 				out->mouseInside = (out->mouse.x >= 0 && out->mouse.y >= 0 && out->mouse.x <= out->windowSize.width && out->mouse.y <= out->windowSize.height);
+				siapp__eventPush(win, SI_EVENT_MOUSE_MOVE, 0)->pos = out->mouse;
 				break;
 			}
 			case NSEventTypeLeftMouseDown: {
 				out->type.mousePress = true;
 				siapp__mouseButtonPress(out, SI_MOUSE_LEFT);
+				siapp__cocoaEventPushButton(win, SI_EVENT_MOUSE_PRESS, SI_MOUSE_LEFT);
 				break;
 			}
 			case NSEventTypeLeftMouseUp: {
 				out->type.mouseRelease = true;
 				siapp__mouseButtonRelease(out, SI_MOUSE_LEFT);
+				siapp__cocoaEventPushButton(win, SI_EVENT_MOUSE_RELEASE, SI_MOUSE_LEFT);
+				break;
 			}
 			case NSEventTypeRightMouseDown: {
 				out->type.mousePress = true;
 				siapp__mouseButtonPress(out, SI_MOUSE_RIGHT);
+				siapp__cocoaEventPushButton(win, SI_EVENT_MOUSE_PRESS, SI_MOUSE_RIGHT);
 				break;
 			}
 			case NSEventTypeRightMouseUp: {
 				out->type.mouseRelease = true;
 				siapp__mouseButtonRelease(out, SI_MOUSE_RIGHT);
+				siapp__cocoaEventPushButton(win, SI_EVENT_MOUSE_RELEASE, SI_MOUSE_RIGHT);
 				break;
 			}
 			case NSEventTypeOtherMouseDown: {
@@ -3177,6 +6137,7 @@ eventLoop:
 				}
 				out->type.mouseMove = true;
 				siapp__mouseButtonPress(out, type);
+				siapp__cocoaEventPushButton(win, SI_EVENT_MOUSE_PRESS, type);
 				break;
 			}
 			case NSEventTypeOtherMouseUp: {
@@ -3190,6 +6151,7 @@ eventLoop:
 				}
 				out->type.mouseRelease = true;
 				siapp__mouseButtonRelease(out, type);
+				siapp__cocoaEventPushButton(win, SI_EVENT_MOUSE_RELEASE, type);
 				break;
 			}
 			case NSEventTypeScrollWheel: {
@@ -3209,6 +6171,7 @@ eventLoop:
 				else if (deltaX < 0) {
 					out->mouseWheel = SI_MOUSE_WHEEL_RIGHT;
 				}
+				siapp__cocoaEventPushButton(win, SI_EVENT_MOUSE_SCROLL, out->mouseWheel);
 				break;
 			}
 		}
@@ -3219,21 +6182,335 @@ eventLoop:
 		siapp_windowClear(win);
 	}
 #endif
+}
+/* Finishes the update once every event has been read. */
+F_TRAITS(intern)
+void siapp__windowUpdateEnd(siWindow* win) {
+#if !defined(SIAPP_PLATFORM_API_X11)
+	siClipboardText* clip = &win->e.clipboard;
+	if (clip->state == SI_CLIPBOARD_RECEIVING) {
+		/* NOTE(EimaMei): UTF-8 is at most 1.5 times larger than UTF-16. */
+		usize capacity = siapp_clipboardTextLen() * 2 + 1;
+		siapp__clipboardAppend(clip, nil, 0);
+		if (clip->__capacity < capacity) {
+			char* text = realloc(clip->text, capacity);
+			SI_STOPIF(text != nil, clip->text = text; clip->__capacity = capacity);
+		}
+
+		clip->len = siapp_clipboardTextGet(clip->text, clip->__capacity);
+		siapp__clipboardNotify(win, (clip->len != 0) ? SI_CLIPBOARD_DONE : SI_CLIPBOARD_FAILED);
+	}
+#endif
+	siapp__userEventsRead(win);
+	siapp__frameClockTick(win);
+	siapp__redrawUpdate(win);
+}
+
+const siWindowEvent* siapp_windowUpdate(siWindow* win, b32 await) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT_MSG(
+		win->renderType != SI_RENDERING_UNSET, "You must call the 'siapp_windowRendererMake' function at least once."
+	);
+
+	u64 updateStart = siapp__clockNs();
+	SIAPP_TRACE_BEGIN("siapp_windowUpdate");
+
+	/* NOTE(EimaMei): A frame is due, so it can't wait on the next event. */
+	await = await && !siapp__redrawPending(win);
+	siapp__windowUpdateBegin(win);
+	SI_STOPIF(!(win->arg & SI_WINDOW_HEADLESS), siapp__windowDispatch(win, await));
+	siapp__windowUpdateEnd(win);
+	win->frameHistory.current[SI_FRAME_TIME_EVENTS] += siapp__clockNs() - updateStart;
+
+	SIAPP_TRACE_END();
+	return &win->e;
+}
+void siapp_appUpdate(b32 await) {
+	u64 updateStart = siapp__clockNs();
+	SIAPP_TRACE_BEGIN("siapp_appUpdate");
+
+	for_range (i, 0, SI_WINDOW_MAP_CAP) {
+		siWindow* win = SI_WINDOW_MAP[i].win;
+		SI_STOPIF(win == nil, continue);
+		SI_ASSERT_MSG(
+			win->renderType != SI_RENDERING_UNSET, "You must call the 'siapp_windowRendererMake' function at least once."
+		);
+
+		await = await && !siapp__redrawPending(win);
+		siapp__windowUpdateBegin(win);
+	}
+
+#if defined(SIAPP_PLATFORM_API_WIN32)
+	if (await) {
+		HANDLE handles[MAXIMUM_WAIT_OBJECTS - 1];
+		DWORD len = 0;
+
+		for_range (i, 0, SI_WINDOW_MAP_CAP) {
+			SI_STOPIF(len == countof(handles), break);
+			siWindow* win = SI_WINDOW_MAP[i].win;
+			SI_STOPIF(win == nil, continue);
+
+			handles[len] = win->userEvents.wake[0];
+			len += 1;
+		}
+		MsgWaitForMultipleObjectsEx(len, handles, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+	}
+
+	/* NOTE(EimaMei): 'WindowProc' already hands the messages to their windows. */
+	MSG msg = {0};
+	SIAPP_TRACE_BEGIN("siapp_appUpdate: dispatch");
+	while (PeekMessageW(&msg, 0, 0, 0, PM_REMOVE)) {
+		TranslateMessage(&msg);
+		DispatchMessageW(&msg);
+	}
+	SIAPP_TRACE_END();
+#elif defined(SIAPP_PLATFORM_API_X11)
+	Display* display = SI_X11_DISPLAY;
+	SI_STOPIF(display == nil, SIAPP_TRACE_END(); return);
+
+	if (await && XPending(display) == 0) {
+		struct pollfd* fds = malloc(sizeof(struct pollfd) * (SI_WINDOW_MAP_LEN + 1));
+		SI_ASSERT_NOT_NULL(fds);
+		u32 len = 1;
+		fds[0].fd = ConnectionNumber(display);
+		fds[0].events = POLLIN;
+
+		for_range (i, 0, SI_WINDOW_MAP_CAP) {
+			siWindow* win = SI_WINDOW_MAP[i].win;
+			SI_STOPIF(win == nil, continue);
+
+			fds[len].fd = win->userEvents.wake[0];
+			fds[len].events = POLLIN;
+			len += 1;
+		}
+		while (poll(fds, len, -1) == -1 && errno == EINTR) {}
+		free(fds);
+	}
+
+	XEvent event;
+	SIAPP_TRACE_BEGIN("siapp_appUpdate: dispatch");
+	while (XEventsQueued(display, QueuedAfterFlush)) {
+		XNextEvent(display, &event);
+
+		siWindow* win = siapp__x11EventOwner(&event);
+		SI_STOPIF(win == nil, continue);
+
+		SI_ROOT_WINDOW = win;
+		siapp__x11EventDispatch(win, &event);
+	}
+	SIAPP_TRACE_END();
+#elif defined(SIAPP_PLATFORM_API_COCOA)
+	if (await) {
+		NSApplication_nextEventMatchingMask(
+			NSApp, NSEventMaskAny,
+			NSDate_distantFuture(),
+			NSDefaultRunLoopMode, false
+		);
+	}
+
+	/* NOTE(EimaMei): Cocoa's event loop has to be read through the windows
+	 * themselves, as the events of other windows get sent off to them. */
+	for_range (i, 0, SI_WINDOW_MAP_CAP) {
+		siWindow* win = SI_WINDOW_MAP[i].win;
+		SI_STOPIF(win == nil, continue);
+		siapp__windowDispatch(win, false);
+	}
+#endif
+
+	u64 elapsed = siapp__clockNs() - updateStart;
+	for_range (i, 0, SI_WINDOW_MAP_CAP) {
+		siWindow* win = SI_WINDOW_MAP[i].win;
+		SI_STOPIF(win == nil, continue);
+
+		siapp__windowUpdateEnd(win);
+		win->frameHistory.current[SI_FRAME_TIME_EVENTS] += elapsed;
+	}
+	SIAPP_TRACE_END();
+}
+siWaitSource siapp_windowUpdateTimeout(siWindow* win, i64 timeout) {
+	SI_ASSERT_NOT_NULL(win);
+
+	siWaitSource sources = 0;
+	SIAPP_TRACE_BEGIN("siapp_windowUpdateTimeout: wait");
+	SI_STOPIF(siapp__redrawPending(win), timeout = 0);
+
+#if defined(SIAPP_PLATFORM_API_WIN32)
+	const siWaitSet* set = &win->waitSet;
+	HANDLE handles[SI_WINDOW_FD_COUNT + 1];
+	u32 indices[SI_WINDOW_FD_COUNT + 1];
+	DWORD len = 1;
+	handles[0] = win->userEvents.wake[0];
+
+	for_range (i, 0, SI_WINDOW_FD_COUNT) {
+		SI_STOPIF((set->used & SI_BIT(i)) == 0, continue);
+		handles[len] = set->fds[i];
+		indices[len] = i;
+		len += 1;
+	}
+
+	/* NOTE(EimaMei): The time gets rounded up to not wake up before the deadline. */
+	DWORD ms = (timeout < 0) ? INFINITE : (DWORD)si_min((timeout + 999999) / 1000000, INFINITE - 1);
+	DWORD res;
+	if (win->arg & SI_WINDOW_HEADLESS) {
+		res = WaitForMultipleObjects(len, handles, false, ms);
+	}
+	else {
+		res = MsgWaitForMultipleObjectsEx(len, handles, ms, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+	}
+
+	if (res == WAIT_OBJECT_0) {
+		sources |= SI_WAIT_WAKE;
+	}
+	else if (res < WAIT_OBJECT_0 + len) {
+		sources |= SI_WAIT_FD << indices[res - WAIT_OBJECT_0];
+	}
+	else if (res == WAIT_OBJECT_0 + len) {
+		sources |= SI_WAIT_EVENTS;
+	}
+#elif defined(SIAPP_PLATFORM_API_X11)
+	i32 displayFd = -1;
+	if (!(win->arg & SI_WINDOW_HEADLESS)) {
+		displayFd = ConnectionNumber(win->display);
+
+		/* NOTE(EimaMei): Xlib might've already read the events from the socket,
+		 * in which case it'd never become readable. The flush also sends the
+		 * requests, which the server has to see before it can reply. Only the
+		 * window's own events count, as the connection is shared and the
+		 * others' events are left for their own updates. */
+		if (XEventsQueued(win->display, QueuedAfterFlush) != 0) {
+			const siWindow* pending = win;
+			XEvent event;
+			XCheckIfEvent(win->display, &event, siapp__x11EventIsQueuedFor, (XPointer)&pending);
+
+			if (pending == nil) {
+				sources |= SI_WAIT_EVENTS;
+				timeout = 0;
+			}
+		}
+	}
+	sources |= siapp__waitPoll(win, displayFd, true, timeout);
+#elif defined(SIAPP_PLATFORM_API_COCOA)
+	if (!(win->arg & SI_WINDOW_HEADLESS)) {
+		NSDate* date = (timeout < 0)
+			? NSDate_distantFuture()
+			: ((id (*)(id, SEL, double))objc_msgSend)(
+				(id)objc_getClass("NSDate"), sel_registerName("dateWithTimeIntervalSinceNow:"),
+				(f64)timeout / SI_CLOCKS_PER_SECOND
+			);
+
+		/* NOTE(EimaMei): The event is left in the queue for 'siapp_windowUpdate'. */
+		NSEvent* event = NSApplication_nextEventMatchingMask(
+			NSApp, NSEventMaskAny, date,
+			NSDefaultRunLoopMode, false
+		);
+		SI_STOPIF(event != nil, sources |= SI_WAIT_EVENTS);
+		timeout = 0;
+	}
+	sources |= siapp__waitPoll(win, -1, true, timeout);
+#endif
+	SIAPP_TRACE_END();
+
+	siapp_windowUpdate(win, false);
+	return sources;
+}
+i32 siapp_windowFdAdd(siWindow* win, siFd fd) {
+	SI_ASSERT_NOT_NULL(win);
+
+	siWaitSet* set = &win->waitSet;
+	for_range (i, 0, SI_WINDOW_FD_COUNT) {
+		SI_STOPIF(set->used & SI_BIT(i), continue);
+
+		set->fds[i] = fd;
+		set->used |= SI_BIT(i);
+		return (i32)i;
+	}
+
+	return -1;
+}
+void siapp_windowFdRemove(siWindow* win, siFd fd) {
+	SI_ASSERT_NOT_NULL(win);
+
+	siWaitSet* set = &win->waitSet;
+	for_range (i, 0, SI_WINDOW_FD_COUNT) {
+		SI_STOPIF((set->used & SI_BIT(i)) && set->fds[i] == fd, set->used &= ~SI_BIT(i));
+	}
+}
+b32 siapp_windowPostEvent(siWindow* win, rawptr data) {
+	SI_ASSERT_NOT_NULL(win);
+
+	siUserEventQueue* queue = &win->userEvents;
+	u32 pos = siapp__atomicLoad32(&queue->tail);
+	siUserEventSlot* slot;
+
+	/* NOTE(EimaMei): A slot is free for position 'pos' once its sequence equals
+	 * 'pos' and holds an event once it's 'pos + 1'. The posting threads race for
+	 * the position with a CAS, so none of them ever wait on each other. */
+	while (true) {
+		slot = &queue->slots[pos % SI_USER_EVENT_CAPACITY];
+		u32 sequence = siapp__atomicLoad32(&slot->sequence);
+		i32 diff = (i32)(sequence - pos);
+
+		if (diff == 0) {
+			b32 claimed = siapp__atomicCas32(&queue->tail, &pos, pos + 1);
+			SI_STOPIF(claimed, break);
+		}
+		else if (diff < 0) {
+			return false;
+		}
+		else {
+			pos = siapp__atomicLoad32(&queue->tail);
+		}
+	}
+
+	slot->data = data;
+	siapp__atomicStore32(&slot->sequence, pos + 1);
+	siapp_windowWake(win);
+
+	return true;
+}
+void siapp_windowWake(siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+
+#if defined(SIAPP_PLATFORM_API_WIN32)
+	SetEvent(win->userEvents.wake[1]);
+#else
+	/* NOTE(EimaMei): If the pipe is full, there's already a wake up in it. */
+	u64 value = 1;
+	isize res = write(win->userEvents.wake[1], &value, sizeof(value));
+	SI_UNUSED(res);
+#endif
 
-	f64 curTime = (f64)si_RDTSC() / si_cpuClockSpeed();
-	f64 prevTime = out->curTime;
-	out->curTime = curTime;
-	out->timeDelta = curTime - prevTime;
+#if defined(SIAPP_PLATFORM_API_COCOA)
+	SI_STOPIF(win->arg & SI_WINDOW_HEADLESS, return);
 
-	return out;
+	/* NOTE(EimaMei): Cocoa waits on its own run loop, which only an event can end. */
+	NSEvent* event = ((id (*)(id, SEL, NSUInteger, NSPoint, NSUInteger, f64, NSInteger, id, i16, NSInteger, NSInteger))objc_msgSend)(
+		(id)objc_getClass("NSEvent"),
+		sel_registerName("otherEventWithType:location:modifierFlags:timestamp:windowNumber:context:subtype:data1:data2:"),
+		NSEventTypeApplicationDefined, (NSPoint){0, 0}, 0, 0, 0, nil, 0, 0, 0
+	);
+	NSApplication_postEvent(NSApp, event, false);
+#endif
+}
+void siapp_windowRequestRedraw(siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+	win->redraw = true;
+	win->e.needsRedraw = true;
+}
+void siapp_windowAnimateUntil(siWindow* win, f64 time) {
+	SI_ASSERT_NOT_NULL(win);
+	win->animateUntil = si_max(win->animateUntil, time);
+	SI_STOPIF(win->e.curTime < time, win->e.needsRedraw = true);
 }
 void siapp_windowRender(siWindow* win) {
 	SI_ASSERT_NOT_NULL(win);
+	SIAPP_TRACE_BEGIN("siapp_windowRender");
 
 	switch (win->renderType & SI_RENDERING_BITS) {
 		case SI_RENDERING_OPENGL: siapp_windowOpenGLRender(win); break;
 		case SI_RENDERING_CPU: siapp_windowCPURender(win); break;
 	}
+	SIAPP_TRACE_END();
 }
 void siapp_windowClear(const siWindow* win) {
 	SI_ASSERT_NOT_NULL(win);
@@ -3248,50 +6525,225 @@ void siapp_windowClear(const siWindow* win) {
 		case SI_RENDERING_CPU: {
 			const siWinRenderingCtxCPU* cpu = &win->render.cpu;
 
-			for_range (y, 0, (i32)win->e.windowSize.height) {
-				usize index = y * cpu->width;
-
-				for_range (x, 0, (i32)win->e.windowSize.width) {
-					memcpy(&cpu->buffer[index], &cpu->bgColor, SI__CHANNEL_COUNT);
-					index += SI__CHANNEL_COUNT;
+			for_range (y, 0, (i32)win->e.windowSize.height) {
+				usize index = y * cpu->width;
+
+				for_range (x, 0, (i32)win->e.windowSize.width) {
+					memcpy(&cpu->buffer[index], &cpu->bgColor, SI__CHANNEL_COUNT);
+					index += SI__CHANNEL_COUNT;
+				}
+			}
+			break;
+		}
+	}
+}
+void siapp_windowSwapBuffers(siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+	u64 swapStart = siapp__clockNs();
+	SIAPP_TRACE_BEGIN("siapp_windowSwapBuffers");
+
+	switch (win->renderType & SI_RENDERING_BITS) {
+		case SI_RENDERING_OPENGL: {
+			siapp__timerFrameEnd(win);
+		#if defined(SIAPP_PLATFORM_API_WIN32)
+			SwapBuffers(win->hdc);
+		#elif defined(SIAPP_PLATFORM_API_X11)
+			glXSwapBuffers(win->display, win->hwnd);
+		#elif defined(SIAPP_PLATFORM_API_COCOA)
+			NSOpenGLContext_flushBuffer(win->render.opengl.context);
+		#endif
+			win->render.opengl.frameVertices = 0;
+			win->render.opengl.frameDraws = 0;
+			break;
+		}
+#if defined (SIAPP_PLATFORM_API_COCOA)
+		case SI_RENDERING_CPU: {
+			SI_STOPIF(win->arg & SI_WINDOW_HEADLESS, break);
+			siWinRenderingCtxCPU* cpu = &win->render.cpu;
+			cpu->redraw = true;
+			siapp__framePace(&win->pacer);
+			siapp__frameEnd(&win->frameHistory, swapStart);
+			SIAPP_TRACE_END();
+			return ;
+		}
+#endif
+	}
+
+	siapp_windowClear(win);
+	siapp__framePace(&win->pacer);
+	siapp__frameEnd(&win->frameHistory, swapStart);
+	SIAPP_TRACE_END();
+}
+siRenderCounters siapp_windowCountersGet(const siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+
+	switch (win->renderType & SI_RENDERING_BITS) {
+		case SI_RENDERING_OPENGL: return win->render.opengl.counters;
+		case SI_RENDERING_CPU: return win->render.cpu.counters;
+	}
+	return (siRenderCounters){0};
+}
+void siapp_windowCountersReset(siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+
+	switch (win->renderType & SI_RENDERING_BITS) {
+		case SI_RENDERING_OPENGL: {
+			memset(&win->render.opengl.counters, 0, sizeof(siRenderCounters));
+			break;
+		}
+		case SI_RENDERING_CPU: {
+			memset(&win->render.cpu.counters, 0, sizeof(siRenderCounters));
+			break;
+		}
+	}
+}
+siFrameStats siapp_windowFrameStatsGet(const siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+	const siFrameHistory* h = &win->frameHistory;
+
+	siFrameStats stats = {0};
+	stats.missedDeadlines = win->pacer.missed;
+	for_range (i, 0, SI_FRAME_TIME_COUNT) {
+		u32 len = h->len[i];
+		SI_STOPIF(len == 0, continue);
+
+		u64 sorted[SI_FRAME_HISTORY];
+		u64 sum = 0;
+		for (u32 j = 0; j < len; j += 1) {
+			u64 sample = h->samples[i][j];
+			sum += sample;
+
+			u32 k = j;
+			while (k != 0 && sorted[k - 1] > sample) {
+				sorted[k] = sorted[k - 1];
+				k -= 1;
+			}
+			sorted[k] = sample;
+		}
+
+		siFrameTiming* t = &stats.times[i];
+		t->last = h->samples[i][(h->next[i] + SI_FRAME_HISTORY - 1) % SI_FRAME_HISTORY];
+		t->average = sum / len;
+		t->p50 = sorted[(len - 1) * 50 / 100];
+		t->p95 = sorted[(len - 1) * 95 / 100];
+		t->p99 = sorted[(len - 1) * 99 / 100];
+		t->max = sorted[len - 1];
+		t->samples = len;
+	}
+
+	return stats;
+}
+void siapp_windowPixelsRead(const siWindow* win, siRect region, siByte* out) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT_NOT_NULL(out);
+	SI_ASSERT(region.x >= 0 && region.y >= 0 && region.width >= 0 && region.height >= 0);
+	SI_ASSERT(
+		region.x + region.width <= (i32)win->e.windowSize.width
+		&& region.y + region.height <= (i32)win->e.windowSize.height
+	);
+
+	switch (win->renderType & SI_RENDERING_BITS) {
+		case SI_RENDERING_OPENGL: {
+			siapp_OpenGLCurrentContextSet((siWindow*)win);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glReadPixels(
+				region.x, win->e.windowSize.height - region.y - region.height,
+				region.width, region.height, GL_RGB, GL_UNSIGNED_BYTE, out
+			);
+
+			/* NOTE(EimaMei): OpenGL reads the rows bottom to top. */
+			usize stride = region.width * 3;
+			siByte* row = malloc(stride);
+			SI_ASSERT_NOT_NULL(row);
+
+			for (i32 y = 0; y < region.height / 2; y += 1) {
+				siByte* top = &out[y * stride];
+				siByte* bottom = &out[(region.height - y - 1) * stride];
+				memcpy(row, top, stride);
+				memcpy(top, bottom, stride);
+				memcpy(bottom, row, stride);
+			}
+			free(row);
+			break;
+		}
+		case SI_RENDERING_CPU: {
+			const siWinRenderingCtxCPU* cpu = &win->render.cpu;
+
+			for (i32 y = 0; y < region.height; y += 1) {
+				const siByte* src = &cpu->buffer[(region.y + y) * cpu->width + region.x * SI__CHANNEL_COUNT];
+			#if defined(SIAPP_PLATFORM_API_COCOA)
+				memcpy(out, src, region.width * 3);
+				out += region.width * 3;
+			#else
+				for (i32 x = 0; x < region.width; x += 1) {
+					out[0] = src[2];
+					out[1] = src[1];
+					out[2] = src[0];
+					out += 3;
+					src += SI__CHANNEL_COUNT;
 				}
+			#endif
 			}
 			break;
 		}
 	}
 }
-void siapp_windowSwapBuffers(siWindow* win) {
+b32 siapp_windowImageWrite(const siWindow* win, cstring path) {
 	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT_NOT_NULL(path);
 
-	switch (win->renderType & SI_RENDERING_BITS) {
-		case SI_RENDERING_OPENGL: {
-		#if defined(SIAPP_PLATFORM_API_WIN32)
-			SwapBuffers(win->hdc);
-		#elif defined(SIAPP_PLATFORM_API_X11)
-			glXSwapBuffers(win->display, win->hwnd);
-		#elif defined(SIAPP_PLATFORM_API_COCOA)
-			const siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-			NSOpenGLContext_flushBuffer(gl->context);
-		#endif
-			break;
-		}
-#if defined (SIAPP_PLATFORM_API_COCOA)
-		case SI_RENDERING_CPU: {
-			siWinRenderingCtxCPU* cpu = &win->render.cpu;
-			cpu->redraw = true;
-			return ;
-		}
-#endif
+	siArea size = win->e.windowSize;
+#if defined(SIAPP_PLATFORM_API_COCOA)
+	/* NOTE(EimaMei): The buffer is already in RGB, so it gets encoded as is. */
+	if ((win->renderType & SI_RENDERING_BITS) == SI_RENDERING_CPU) {
+		const siWinRenderingCtxCPU* cpu = &win->render.cpu;
+		i32 written = SIAPP_IMAGE_WRITE(path, size.width, size.height, 3, cpu->buffer, cpu->width);
+		return written != 0;
 	}
+#endif
 
-	siapp_windowClear(win);
+	siByte* pixels = malloc(size.width * size.height * 3);
+	SI_STOPIF(pixels == nil, return false);
+	siapp_windowPixelsRead(win, SI_RECT(0, 0, size.width, size.height), pixels);
+
+	i32 written = SIAPP_IMAGE_WRITE(path, size.width, size.height, 3, pixels, size.width * 3);
+	free(pixels);
+
+	return written != 0;
 }
 void siapp_windowClose(siWindow* win) {
 	SI_ASSERT_NOT_NULL(win);
 	siapp_windowRendererDestroy(win);
+	siapp__userEventsFree(&win->userEvents);
+	free(win->e.clipboard.text);
+
+	if (win->arg & SI_WINDOW_HEADLESS) {
+		free(win);
+		return ;
+	}
 	SI_WINDOWS_NUM -= 1;
 
+#if defined(SIAPP_PLATFORM_API_X11)
+	siapp_windowRawMouseSet(win, SI_RAW_MOUSE_OFF);
+	XLockDisplay(win->display);
+	siapp__windowMapRemove((u64)win->hwnd);
+	XUnlockDisplay(win->display);
+	SI_STOPIF(SI_X11_CLIPBOARD_OWNER == win->hwnd, siapp__x11ClipboardClear());
+
+	if (SI_ROOT_WINDOW == win) {
+		SI_ROOT_WINDOW = nil;
+		for_range (i, 0, SI_WINDOW_MAP_CAP) {
+			SI_STOPIF(SI_WINDOW_MAP[i].win == nil, continue);
+			SI_ROOT_WINDOW = SI_WINDOW_MAP[i].win;
+			break;
+		}
+	}
+#else
+	siapp__windowMapRemove((u64)(usize)win->hwnd);
+#endif
+
 #if defined(SIAPP_PLATFORM_API_WIN32)
+	SI_STOPIF(win->pacer.timer != nil, CloseHandle(win->pacer.timer));
 	ReleaseDC(win->hwnd, win->hdc);
 	DestroyWindow(win->hwnd);
 
@@ -3301,18 +6753,20 @@ void siapp_windowClose(siWindow* win) {
 #elif defined(SIAPP_PLATFORM_API_X11)
 	SI_STOPIF(win->__x11BlankCursor, XFreeCursor(win->display, win->__x11BlankCursor));
 	SI_STOPIF(win->hwnd, XDestroyWindow(win->display, win->hwnd));
-	SI_STOPIF(win->display, XCloseDisplay(win->display));
 	win->__x11BlankCursor = 0;
 
 	if (SI_WINDOWS_NUM == 0) {
 		for_range (i, 0, countof(SI_X11_CURSORS)) {
 			if (SI_X11_CURSORS[i] != 0) {
-				XFreeCursor(SI_ROOT_WINDOW->display, SI_X11_CURSORS[i]);
+				XFreeCursor(SI_X11_DISPLAY, SI_X11_CURSORS[i]);
 				SI_X11_CURSORS[i] = 0;
 			}
 		}
 		si_dllUnload(SI_X11_XCURSOR);
 		SI_X11_XCURSOR = nil;
+		SI_STOPIF(SI_X11_XI != nil, si_dllUnload(SI_X11_XI));
+		SI_X11_XI = nil;
+		SI_X11_XI_OPCODE = 0;
 
 		XCloseDisplay(SI_X11_DISPLAY);
 		SI_X11_DISPLAY = nil;
@@ -3496,25 +6950,36 @@ void siapp_windowFullscreen(siWindow* win, b32 fullscreen) {
 #endif
 }
 
-b32 siapp_windowVSyncSet(siWindow* win, b32 value) {
+b32 siapp_windowVSyncSet(siWindow* win, siVSyncMode mode) {
 	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT(si_between(mode, SI_VSYNC_ADAPTIVE, SI_VSYNC_ON));
+	b32 res = true;
 
 	switch (win->renderType & SI_RENDERING_BITS) {
 		case SI_RENDERING_OPENGL: {
 #if defined(SIAPP_PLATFORM_API_WIN32)
-			wglSwapIntervalEXT(value & 1);
+			res = wglSwapIntervalEXT(mode);
+			SI_STOPIF(!res && mode == SI_VSYNC_ADAPTIVE, wglSwapIntervalEXT(SI_VSYNC_ON));
 #elif defined(SIAPP_PLATFORM_API_X11)
-			glXSwapIntervalEXT(win->display, win->hwnd, value & 1);
+			if (mode == SI_VSYNC_ADAPTIVE) {
+				cstring extensions = glXQueryExtensionsString(win->display, XDefaultScreen(win->display));
+				res = (extensions != nil && strstr(extensions, "GLX_EXT_swap_control_tear") != nil);
+				SI_STOPIF(!res, mode = SI_VSYNC_ON);
+			}
+			glXSwapIntervalEXT(win->display, win->hwnd, mode);
 #elif defined(SIAPP_PLATFORM_API_COCOA)
 			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-			GLint swapInt = value & 1;
+			GLint swapInt = (mode != SI_VSYNC_OFF);
+			res = (mode != SI_VSYNC_ADAPTIVE);
 			NSOpenGLContext_setValues(gl->context, &swapInt, NSOpenGLContextParameterSwapInterval);
 #endif
 			break;
 		}
 		case SI_RENDERING_CPU: {
-			siWinRenderingCtxCPU* cpu = &win->render.cpu;
-			SI_STOPIF(SI_UNLIKELY(!value), cpu->fps = 0; break);
+			SI_STOPIF(
+				SI_UNLIKELY(mode == SI_VSYNC_OFF) || (win->arg & SI_WINDOW_HEADLESS),
+				siapp_windowFrameRateSet(win, 0); break
+			);
 			i32 fps;
 
 #if defined(SIAPP_PLATFORM_API_COCOA)
@@ -3523,18 +6988,54 @@ b32 siapp_windowVSyncSet(siWindow* win, b32 value) {
 #elif defined(SIAPP_PLATFORM_API_X11)
 			XRRScreenConfiguration* config = XRRGetScreenInfo(win->display, win->hwnd);
 			fps = XRRConfigCurrentRate(config);
+			XRRFreeScreenConfigInfo(config);
 #elif defined(SIAPP_PLATFORM_API_WIN32)
 			DEVMODEW mode = {0};
 			EnumDisplaySettingsW(nil, ENUM_CURRENT_SETTINGS, &mode);
 			fps = mode.dmDisplayFrequency;
 #endif
 
-			cpu->fps = (1.0f / fps) * 1000;
+			/* NOTE(EimaMei): Virtual displays can report a rate of 0. */
+			siapp_windowFrameRateSet(win, (fps > 0) ? fps : 60);
 			break;
 		}
 	}
 
+	return res;
+}
+void siapp_windowFrameRateSet(siWindow* win, f64 fps) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT(fps >= 0);
+
+	siFramePacer* pacer = &win->pacer;
+	pacer->interval = (fps != 0) ? (u64)(SI_CLOCKS_PER_SECOND / fps) : 0;
+	pacer->deadline = 0;
+}
+b32 siapp_windowRawMouseSet(siWindow* win, siRawMouseMode mode) {
+	SI_ASSERT_NOT_NULL(win);
+
+#if defined(SIAPP_PLATFORM_API_X11)
+	SI_STOPIF(win->arg & SI_WINDOW_HEADLESS, return false);
+	SI_STOPIF(mode == win->rawMouse, return true);
+
+	if (mode == SI_RAW_MOUSE_OFF) {
+		win->rawMouse = mode;
+		SI_X11_XI_USERS -= 1;
+		SI_STOPIF(SI_X11_XI_USERS == 0, siapp__x11XiSelect(false));
+		return true;
+	}
+	SI_STOPIF(!siapp__x11XiStartup(), return false);
+
+	if (win->rawMouse == SI_RAW_MOUSE_OFF) {
+		SI_X11_XI_USERS += 1;
+		SI_STOPIF(SI_X11_XI_USERS == 1, siapp__x11XiSelect(true));
+	}
+	win->rawMouse = mode;
+
 	return true;
+#else
+	return mode == SI_RAW_MOUSE_OFF;
+#endif
 }
 void siapp_windowWin32DarkModeSet(siWindow* win, b32 lightMode) {
 #if defined(SIAPP_PLATFORM_API_WIN32)
@@ -3618,6 +7119,19 @@ b32 siapp_windowEventPoll(const siWindow* win, siEventTypeEnum* out) {
 
 	return bit != 0 && bit < SI_EVENT_COUNT;
 }
+b32 siapp_windowEventNext(siWindow* win, siEvent* out) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT_NOT_NULL(out);
+
+	siEventQueue* queue = &win->events;
+	SI_STOPIF(queue->len == 0, return false);
+
+	*out = queue->events[queue->head];
+	queue->head = (queue->head + 1) % SI_EVENT_QUEUE_CAPACITY;
+	queue->len -= 1;
+
+	return true;
+}
 
 
 siCursorType siapp_windowCursorGet(const siWindow* win) {
@@ -4124,37 +7638,13 @@ usize siapp_clipboardTextGet(char* outBuffer, usize capacity) {
 	return len;
 #elif defined (SIAPP_PLATFORM_API_X11)
 	siapp__x11CheckStartup();
+	SI_STOPIF(SI_ROOT_WINDOW == nil || capacity == 0, return 0);
 
-	Atom type;
-	int di;
-	unsigned long size, dul;
-	siByte* allocatedStr = nil;
-
-	siWindow* win = SI_ROOT_WINDOW;
-	XConvertSelection(
-		win->display, CLIPBOARD, UTF8_STRING, XSEL_DATA, win->hwnd, CurrentTime
-	);
-
-	XEvent event;
-	do {
-		XNextEvent(win->display, &event);
-	} while (event.type != SelectionNotify || event.xselection.selection != CLIPBOARD);
-
-	XGetWindowProperty(
-		SI_X11_DISPLAY, win->hwnd, XSEL_DATA, 0, 0, False, AnyPropertyType,
-		&type, &di, &dul, &size, &allocatedStr
-	);
-	XFree(allocatedStr);
-
-	usize len = si_min(capacity - 1, size);
-	XGetWindowProperty(
-		SI_X11_DISPLAY, win->hwnd, XSEL_DATA, 0, len, False, AnyPropertyType,
-		&type, &di, &dul, &size, &allocatedStr
-	);
+	const siClipboardText* clip = siapp__x11ClipboardFetch(SI_ROOT_WINDOW);
+	usize len = si_min(capacity - 1, clip->len);
 
-	memcpy(outBuffer, allocatedStr, len);
+	memcpy(outBuffer, clip->text, len);
 	outBuffer[len] = '\0';
-	XFree(allocatedStr);
 
 	return len;
 #elif defined(SIAPP_PLATFORM_API_COCOA)
@@ -4168,6 +7658,28 @@ usize siapp_clipboardTextGet(char* outBuffer, usize capacity) {
 	return len;
 #endif
 }
+b32 siapp_clipboardTextRequest(siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT_MSG(!(win->arg & SI_WINDOW_HEADLESS), "Headless windows can't use the clipboard.");
+
+	siClipboardText* clip = &win->e.clipboard;
+	SI_STOPIF(clip->state == SI_CLIPBOARD_RECEIVING, return false);
+
+	clip->state = SI_CLIPBOARD_RECEIVING;
+	clip->len = 0;
+	clip->__incr = false;
+	SI_STOPIF(clip->text != nil, clip->text[0] = '\0');
+
+#if defined(SIAPP_PLATFORM_API_X11)
+	XConvertSelection(win->display, CLIPBOARD, UTF8_STRING, XSEL_DATA, win->hwnd, CurrentTime);
+	XFlush(win->display);
+#else
+	/* NOTE(EimaMei): The text gets read at the end of the next update. */
+	siapp_windowWake(win);
+#endif
+
+	return true;
+}
 b32 siapp_clipboardTextSet(cstring text) {
 #if defined(SIAPP_PLATFORM_API_WIN32)
 	usize len;
@@ -4193,105 +7705,25 @@ b32 siapp_clipboardTextSet(cstring text) {
 	return status;
 #elif defined (SIAPP_PLATFORM_API_X11)
 	siapp__x11CheckStartup();
-	// clipboard still doesn't work for some reason.
-
 	siWindow* win = SI_ROOT_WINDOW;
+	SI_STOPIF(win == nil, return false);
 
-	XSetSelectionOwner(win->display, CLIPBOARD, win->hwnd, CurrentTime);
-	XConvertSelection(win->display, CLIPBOARD_MANAGER, SAVE_TARGETS, None, win->hwnd, CurrentTime);
-
-	for (;;) {
-		XEvent event;
-
-		XNextEvent(win->display, &event);
-		if (event.type != SelectionRequest)
-			return true;
-
-		const XSelectionRequestEvent* request = &event.xselectionrequest;
-
-		XEvent reply = { SelectionNotify };
-
-		char* selectionString = NULL;
-		const Atom formats[] = { UTF8_STRING, XA_STRING };
-		const i32 formatCount = sizeof(formats) / sizeof(formats[0]);
-
-		selectionString = (char*)text;
-
-		if (request->target == TARGETS) {
-			const Atom targets[] = { TARGETS,
-									MULTIPLE,
-									UTF8_STRING,
-									XA_STRING };
-
-			XChangeProperty(win->display,
-							request->requestor,
-							request->property,
-							4,
-							32,
-							PropModeReplace,
-							(u8*) targets,
-							sizeof(targets) / sizeof(targets[0]));
-
-			reply.xselection.property = request->property;
-		}
-
-		if (request->target == MULTIPLE) {
-
-			Atom* targets;
-
-			Atom actualType;
-			i32 actualFormat;
-			u64 count, bytesAfter;
-
-			XGetWindowProperty(win->display, request->requestor, request->property, 0, INT64_MAX, False, ATOM_PAIR,  &actualType, &actualFormat, &count, &bytesAfter, (u8**) &targets);
+	usize len = si_cstrLen(text);
+	char* copy = malloc(len + 1);
+	SI_STOPIF(copy == nil, return false);
+	memcpy(copy, text, len + 1);
 
-			u64 i;
-			for (i = 0;  i < count;  i += 2) {
-				i32 j;
+	siapp__x11ClipboardClear();
+	SI_X11_CLIPBOARD_TEXT = copy;
+	SI_X11_CLIPBOARD_LEN = len;
+	SI_X11_CLIPBOARD_OWNER = win->hwnd;
 
-				for (j = 0;  j < formatCount;  j++) {
-					if (targets[i] == formats[j])
-						break;
-				}
-
-				if (j < formatCount)
-				{
-					XChangeProperty(win->display,
-									request->requestor,
-									targets[i + 1],
-									targets[i],
-									8,
-									PropModeReplace,
-									(u8 *) selectionString,
-									si_cstrLen(selectionString));
-				}
-				else
-					targets[i + 1] = None;
-			}
-
-			XChangeProperty(win->display,
-							request->requestor,
-							request->property,
-							ATOM_PAIR,
-							32,
-							PropModeReplace,
-							(u8*) targets,
-							count);
-
-			XFree(targets);
-
-			reply.xselection.property = request->property;
-		}
-
-		reply.xselection.display = request->display;
-		reply.xselection.requestor = request->requestor;
-		reply.xselection.selection = request->selection;
-		reply.xselection.target = request->target;
-		reply.xselection.time = request->time;
+	/* NOTE(EimaMei): The requests for the text get answered by the updates of
+	 * the windows, see 'siapp__x11ClipboardServe'. */
+	XSetSelectionOwner(win->display, CLIPBOARD, win->hwnd, CurrentTime);
+	XConvertSelection(win->display, CLIPBOARD_MANAGER, SAVE_TARGETS, None, win->hwnd, CurrentTime);
 
-		XSendEvent(win->display, request->requestor, False, 0, &reply);
-	}
-	return true;
+	return XGetSelectionOwner(win->display, CLIPBOARD) == win->hwnd;
 #elif defined(SIAPP_PLATFORM_API_COCOA)
 	SILICON_ALLOCATOR = si_salloc(512);
 	siArray(NSPasteboardType) array = sic_arrayInit((NSPasteboardType[]){NSPasteboardTypeString}, sizeof(NSPasteboardType), 1);
@@ -4319,29 +7751,9 @@ usize siapp_clipboardTextLen(void) {
 	return len;
 #elif defined(SIAPP_PLATFORM_API_X11)
 	siapp__x11CheckStartup();
+	SI_STOPIF(SI_ROOT_WINDOW == nil, return 0);
 
-	Atom type;
-	int di;
-	unsigned long size, dul;
-	siByte* allocatedStr = nil;
-
-	siWindow* win = SI_ROOT_WINDOW;
-	XConvertSelection(
-		win->display, CLIPBOARD, UTF8_STRING, XSEL_DATA, win->hwnd, CurrentTime
-	);
-
-	XEvent event;
-	do {
-		XNextEvent(win->display, &event);
-	} while (event.type != SelectionNotify || event.xselection.selection != CLIPBOARD);
-
-	XGetWindowProperty(
-		SI_X11_DISPLAY, win->hwnd, XSEL_DATA, 0, 0, False, AnyPropertyType,
-		&type, &di, &dul, &size, &allocatedStr
-	);
-	XFree(allocatedStr);
-
-	return size;
+	return siapp__x11ClipboardFetch(SI_ROOT_WINDOW)->len;
 #elif defined(SIAPP_PLATFORM_API_COCOA)
 	char* str = NSPasteboard_stringForType(NSPasteboard_generalPasteboard(), NSPasteboardTypeString);
 	usize len = sic_stringLen(str);
@@ -5151,6 +8563,11 @@ siTextureAtlas siapp_textureAtlasMake(const siWindow* win, siArea area, u32 maxT
 
 	siTextureAtlas atlas;
 	atlas.render = win->renderType & SI_RENDERING_BITS;
+	/* NOTE(EimaMei): Counting uploads is the only thing the atlas changes in
+	 * the window. */
+	atlas.counters = (atlas.render == SI_RENDERING_OPENGL)
+		? (siRenderCounters*)&win->render.opengl.counters
+		: (siRenderCounters*)&win->render.cpu.counters;
 	atlas.texWidth = area.width;
 	atlas.texHeight = area.height;
 	atlas.curCount = 0;
@@ -5178,7 +8595,7 @@ siTextureAtlas siapp_textureAtlasMake(const siWindow* win, siArea area, u32 maxT
 		case SI_RENDERING_CPU: {
 			atlas.texID.cpu = malloc(sizeof(*atlas.texID.cpu));
 			atlas.texID.cpu->data = (siColor*)calloc(atlas.totalWidth * area.height, sizeof(siColor));
-			memcpy(atlas.texID.cpu->mask, si_buf(i32, SI_SWIZZLE_R, SI_SWIZZLE_G, SI_SWIZZLE_B, SI_SWIZZLE_A), sizeof(i32) * 4);
+			memcpy(atlas.texID.cpu->mask, si_buf(i32, SI_SWIZZLE_VAL_R, SI_SWIZZLE_VAL_G, SI_SWIZZLE_VAL_B, SI_SWIZZLE_VAL_A), sizeof(i32) * 4);
 			atlas.texID.cpu->resizeMethod = enumName;
 			break;
 		}
@@ -5244,6 +8661,7 @@ void siapp_textureAtlasResizeMethodSet(siTextureAtlas* atlas, siTextureResizeEnu
 siImage siapp_imageLoad(siTextureAtlas* atlas, cstring filename) {
 	SI_ASSERT_NOT_NULL(atlas);
 	SI_ASSERT_NOT_NULL(filename);
+	SIAPP_TRACE_BEGIN("siapp_imageLoad");
 
 	siFile file = si_fileOpen(filename);
 
@@ -5259,6 +8677,8 @@ siImage siapp_imageLoad(siTextureAtlas* atlas, cstring filename) {
 
 	si_fileClose(file);
 	si_allocatorFree(tmp);
+
+	SIAPP_TRACE_END();
 	return res;
 }
 
@@ -5296,6 +8716,7 @@ siImage siapp_imageLoadEx(siTextureAtlas* atlas, const siByte* buffer, u32 width
 				default: SI_PANIC();
 			}
 
+			SIAPP_TRACE_BEGIN("siapp_textureUpload");
 			glTexSubImage2D(
 				GL_TEXTURE_2D,
 				0,
@@ -5304,6 +8725,8 @@ siImage siapp_imageLoadEx(siTextureAtlas* atlas, const siByte* buffer, u32 width
 				GL_UNSIGNED_BYTE,
 				buffer
 			);
+			SI__COUNTER_ADD(atlas->counters, uploadBytes, width * height * channels);
+			SIAPP_TRACE_END();
 
 			break;
 		}
@@ -5450,6 +8873,7 @@ void siapp_spriteSheetSpriteSetEx(siSpriteSheet sheet, usize index, siByte* data
 
 			glActiveTexture(GL_TEXTURE0 + atlas->texID.opengl - 1);
 			glBindTexture(GL_TEXTURE_2D, atlas->texID.opengl);
+			SIAPP_TRACE_BEGIN("siapp_textureUpload");
 			glTexSubImage2D(
 				GL_TEXTURE_2D, 0,
 				xOffset + XY.x, XY.y,
@@ -5457,6 +8881,8 @@ void siapp_spriteSheetSpriteSetEx(siSpriteSheet sheet, usize index, siByte* data
 				c, GL_UNSIGNED_BYTE,
 				data
 			);
+			SI__COUNTER_ADD(atlas->counters, uploadBytes, sheet.spriteSize.width * sheet.spriteSize.height * channels);
+			SIAPP_TRACE_END();
 			break;
 		}
 
@@ -5483,7 +8909,7 @@ void siapp_spriteSheetSpriteSetEx(siSpriteSheet sheet, usize index, siByte* data
 						break;
 					}
 					case SI_SWIZZLE_VAL_G: {
-						*c = &buffer[2 * (channels != 1)];
+						*c = &buffer[1 * (channels != 1)];
 						inc.a[i] = channels;
 						break;
 					}
@@ -5593,6 +9019,7 @@ siFont siapp_fontLoadEx(const siWindow* win, cstring path, i32 size, siGlyphSet*
 		u32 extraChars) {
 	SI_ASSERT_NOT_NULL(win);
 	SI_ASSERT_NOT_NULL(glyphs);
+	SIAPP_TRACE_BEGIN("siapp_fontLoad");
 
 	siAllocator* tmpAlloc;
 	siFont font;
@@ -5745,9 +9172,14 @@ siFont siapp_fontLoadEx(const siWindow* win, cstring path, i32 size, siGlyphSet*
 	}
 	si_allocatorFree(tmpAlloc);
 
+	SIAPP_TRACE_END();
 	return font;
 }
 void siapp_fontFree(siFont font) {
+	if (SI_TEXT_WRAP_ALLOC == font.alloc) {
+		siapp_textLayoutFree(&SI_TEXT_WRAP_LAYOUT);
+		SI_TEXT_WRAP_ALLOC = nil;
+	}
 	siapp_textureAtlasFree(*font.sheet.base.atlas);
 	si_allocatorFree(font.alloc);
 }
@@ -5835,104 +9267,278 @@ void siapp_windowTitleSetEx(const siWindow* win, cstring title, usize len) {
 #endif
 }
 
+/* Returns the state of the bit in each of the sets. */
+F_TRAITS(inline intern)
+siKeyState siapp__keyStateMake(u64 clicked, u64 pressed, u64 released, u64 bit) {
+	siKeyState state;
+	state.clicked = (clicked & bit) != 0;
+	state.pressed = (pressed & bit) != 0;
+	state.released = (released & bit) != 0;
+	return state;
+}
+
 siKeyState siapp_windowKeyGet(const siWindow* win, siKeyType key) {
 	SI_ASSERT_NOT_NULL(win);
-	return win->e.keys[key];
+	const siWindowEvent* e = &win->e;
+	usize word = key / 64;
+
+	return siapp__keyStateMake(
+		e->keysClicked.bits[word], e->keysPressed.bits[word], e->keysReleased.bits[word],
+		(u64)1 << (key % 64)
+	);
 }
 b32 siapp_windowKeyClicked(const siWindow* win, siKeyType key) {
 	SI_ASSERT_NOT_NULL(win);
-	return win->e.keys[key].clicked;
+	return siapp_keySetHas(win->e.keysClicked, key);
 }
 b32 siapp_windowKeyPressed(const siWindow* win, siKeyType key) {
 	SI_ASSERT_NOT_NULL(win);
-	return win->e.keys[key].pressed;
+	return siapp_keySetHas(win->e.keysPressed, key);
 }
 b32 siapp_windowKeyReleased(const siWindow* win, siKeyType key) {
 	SI_ASSERT_NOT_NULL(win);
-	return win->e.keys[key].released;
+	return siapp_keySetHas(win->e.keysReleased, key);
 }
-b32 siapp__internWindowKeyMul(const siWindow* win, ...) {
-	va_list va;
-	va_start(va, win);
-
-	b32 clicked = false;
-	usize len = va_arg(va, usize); /* NOTE(EimaMei): The 'siapp_windowKeyMul' macro
-	sets the first 'va_arg' value as the length of how many keys are requested. */
 
+siKeySet siapp_keySetMake(const siKeyType* keys, usize len) {
+	siKeySet set = {0};
 	for_range (i, 0, len) {
-		siKeyType key = (siKeyType)va_arg(va, i32);
-		clicked = win->e.keys[key].pressed;
-		SI_STOPIF(clicked == false, break);
+		SI_ASSERT(keys[i] < SK_COUNT);
+		set.bits[keys[i] / 64] |= (u64)1 << (keys[i] % 64);
 	}
-	va_end(va);
 
-	return clicked;
+	return set;
+}
+b32 siapp_keySetHas(siKeySet set, siKeyType key) {
+	return (set.bits[key / 64] >> (key % 64)) & 1;
+}
+
+b32 siapp_windowKeyAnyClicked(const siWindow* win, siKeySet keys) {
+	SI_ASSERT_NOT_NULL(win);
+
+	u64 res = 0;
+	for_range (i, 0, countof(keys.bits)) {
+		res |= win->e.keysClicked.bits[i] & keys.bits[i];
+	}
+	return res != 0;
+}
+b32 siapp_windowKeyAnyReleased(const siWindow* win, siKeySet keys) {
+	SI_ASSERT_NOT_NULL(win);
+
+	u64 res = 0;
+	for_range (i, 0, countof(keys.bits)) {
+		res |= win->e.keysReleased.bits[i] & keys.bits[i];
+	}
+	return res != 0;
+}
+b32 siapp_windowKeyAllPressed(const siWindow* win, siKeySet keys) {
+	SI_ASSERT_NOT_NULL(win);
+
+	u64 missing = 0;
+	for_range (i, 0, countof(keys.bits)) {
+		missing |= keys.bits[i] & ~win->e.keysPressed.bits[i];
+	}
+	return missing == 0;
+}
+b32 siapp_windowKeyChord(const siWindow* win, siKeySet keys, b32 exact) {
+	SI_ASSERT_NOT_NULL(win);
+	const siWindowEvent* e = &win->e;
+
+	u64 missing = 0, clicked = 0, extra = 0;
+	for_range (i, 0, countof(keys.bits)) {
+		missing |= keys.bits[i] & ~e->keysPressed.bits[i];
+		clicked |= keys.bits[i] & e->keysClicked.bits[i];
+		extra |= e->keysPressed.bits[i] & ~keys.bits[i];
+	}
+	return missing == 0 && clicked != 0 && (!exact || extra == 0);
 }
 
 siKeyState siapp_windowMouseKeyGet(const siWindow* win, siMouseButtonType key)  {
 	SI_ASSERT_NOT_NULL(win);
-	return win->e.mouseButtons[key - 1];
+	const siWindowEvent* e = &win->e;
+	return siapp__keyStateMake(e->mouseClicked, e->mousePressed, e->mouseReleased, SI_BIT(key - 1));
 }
 b32 siapp_windowMouseKeyClicked(const siWindow* win, siMouseButtonType key) {
 	SI_ASSERT_NOT_NULL(win);
-	return win->e.mouseButtons[key - 1].clicked;
+	return (win->e.mouseClicked & SI_BIT(key - 1)) != 0;
 }
 b32 siapp_windowMouseKeyPressed(const siWindow* win, siMouseButtonType key) {
 	SI_ASSERT_NOT_NULL(win);
-	return win->e.mouseButtons[key - 1].pressed;
+	return (win->e.mousePressed & SI_BIT(key - 1)) != 0;
 }
 b32 siapp_windowMouseKeyReleased(const siWindow* win, siMouseButtonType key) {
 	SI_ASSERT_NOT_NULL(win);
-	return win->e.mouseButtons[key - 1].released;
+	return (win->e.mouseReleased & SI_BIT(key - 1)) != 0;
 }
 
-void siapp_drawVertex2f(siWindow* win, f32 x, f32 y) {
-	siapp_drawVertex3f(win, x, y, 0.0f);
-}
-void siapp_drawVertex3f(siWindow* win, f32 x, f32 y, f32 z) {
-	SI_ASSERT_NOT_NULL(win);
+/* Adds a vertex at the position in pixels. */
+F_TRAITS(intern)
+void siapp__drawVertex(siWindow* win, f32 x, f32 y) {
 	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
 	SI_ASSERT_MSG(gl->vertexCounter < gl->maxVertexCount, "Not enough space is left inside the buffer.");
 
-	gl->vertices[gl->vertexCounter] = SI_VEC3(x, y, z);
-	gl->texCoords[gl->vertexCounter] = gl->curTexCoords;
-	gl->colors[gl->vertexCounter] = gl->curColor;
+	siOpenGLVertex* vertex = &gl->vertices[gl->vertexCounter];
+	vertex->x = x;
+	vertex->y = y;
+	vertex->u = gl->curTexCoords[0];
+	vertex->v = gl->curTexCoords[1];
+	vertex->color = gl->curColor;
 
 	gl->vertexCounter += 1;
 }
+void siapp_drawVertex2f(siWindow* win, f32 x, f32 y) {
+	SI_ASSERT_NOT_NULL(win);
+	const siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	siArea size = (gl->target.width != 0) ? gl->target : gl->size;
+
+	siapp__drawVertex(win, (x + 1.0f) * size.width / 2.0f, (1.0f - y) * size.height / 2.0f);
+}
+void siapp_drawVertex3f(siWindow* win, f32 x, f32 y, f32 z) {
+	siapp_drawVertex2f(win, x, y);
+	SI_UNUSED(z);
+}
 void siapp_drawRect(siWindow* win, siRect rect, siColor color) {
 	siapp_drawRectF(win, SI_VEC4_R(rect), color);
 }
 
+/* Runs a CPU draw. While a draw list is being recorded, the draw goes into both
+ * of its scratch buffers instead of the window. */
+#define SI__CPU_DRAW(win, draw) \
+	do { \
+		siWinRenderingCtxCPU* cpu_ = &(win)->render.cpu; \
+		if (cpu_->recording[0] == nil) { \
+			draw; \
+			break; \
+		} \
+		siByte* buffer_ = cpu_->buffer; \
+		cpu_->buffer = cpu_->recording[0]; draw; \
+		cpu_->buffer = cpu_->recording[1]; draw; \
+		cpu_->buffer = buffer_; \
+	} while (0)
+
+F_TRAITS(inline intern)
+void siapp__cpuCountBlend(siWindow* win, u64 pixels) {
+	SI__COUNTER_ADD(&win->render.cpu.counters, pixelsFilled, pixels);
+	SI__COUNTER_ADD(&win->render.cpu.counters, pixelsBlended, pixels);
+#if defined(SIAPP_DISABLE_COUNTERS)
+	SI_UNUSED(win); SI_UNUSED(pixels);
+#endif
+}
+
+F_TRAITS(intern)
+void siapp__cpuFillRect(siWindow* win, siRect r, siColor color) {
+	siWinRenderingCtxCPU* cpu = &win->render.cpu;
+
+	f32 alpha = color.a / 255.0f;
+	color.r *= alpha;
+	color.g *= alpha;
+	color.b *= alpha;
+
+	alpha = 1.0f - alpha;
+
+	siRect clip = siapp__cpuClipGet(win);
+	i32 x1 = si_max(r.x, clip.x),
+		y1 = si_max(r.y, clip.y),
+		x2 = si_min(r.x + r.width, clip.x + clip.width),
+		y2 = si_min(r.y + r.height, clip.y + clip.height);
+	SI_STOPIF(x1 >= x2 || y1 >= y2, return);
+
+	SI__COUNTER_ADD(&cpu->counters, pixelsFilled, (x2 - x1) * (y2 - y1));
+	SI_STOPIF(alpha != 0, SI__COUNTER_ADD(&cpu->counters, pixelsBlended, (x2 - x1) * (y2 - y1)));
+
+	for_range (y, y1, y2) {
+		usize index = y * cpu->width + x1 * SI__CHANNEL_COUNT;
+
+		for_range (x, x1, x2) {
+			cpu->buffer[index + 0] *= alpha;
+			cpu->buffer[index + 1] *= alpha;
+			cpu->buffer[index + 2] *= alpha;
+
+#if defined(SIAPP_PLATFORM_API_X11) || defined(SIAPP_PLATFORM_API_WIN32)
+			cpu->buffer[index + 0] += color.b;
+			cpu->buffer[index + 1] += color.g;
+			cpu->buffer[index + 2] += color.r;
+#else
+			cpu->buffer[index + 0] += color.r;
+			cpu->buffer[index + 1] += color.g;
+			cpu->buffer[index + 2] += color.b;
+#endif
+
+			index += SI__CHANNEL_COUNT;
+		}
+	}
+}
+/* Returns the smallest integer that isn't less than 'x'.
+ * NOTE(EimaMei): 'si_ceil' rounds whole numbers up as well. */
+F_TRAITS(inline intern)
+i32 siapp__ceilI32(f32 x) {
+	i32 res = (i32)x;
+	return res + (x > (f32)res);
+}
+/* Fills the convex polygon, whose points are in pixels, a row at a time. A
+ * pixel gets filled if its center is inside of the polygon. */
+F_TRAITS(intern)
+void siapp__cpuFillConvex(siWindow* win, const siVec2* points, usize len, siColor color) {
+	f32 minY = points[0].y, maxY = points[0].y;
+	for_range (i, 1, len) {
+		minY = si_minf(minY, points[i].y);
+		maxY = si_maxf(maxY, points[i].y);
+	}
+
+	siRect clip = siapp__cpuClipGet(win);
+	i32 y1 = si_max(siapp__ceilI32(minY - 0.5f), clip.y),
+		y2 = si_min(siapp__ceilI32(maxY - 0.5f), clip.y + clip.height);
+
+	for_range (y, y1, y2) {
+		f32 center = y + 0.5f;
+		f32 left = (f32)INT32_MAX, right = (f32)INT32_MIN;
+
+		for_range (i, 0, len) {
+			siVec2 a = points[i],
+				   b = points[(i + 1) % len];
+			SI_STOPIF(center < si_minf(a.y, b.y) || center >= si_maxf(a.y, b.y), continue);
+
+			f32 x = a.x + (center - a.y) * (b.x - a.x) / (b.y - a.y);
+			left = si_minf(left, x);
+			right = si_maxf(right, x);
+		}
+		SI_STOPIF(left > right, continue);
+
+		i32 x1 = siapp__ceilI32(left - 0.5f),
+			x2 = siapp__ceilI32(right - 0.5f);
+		siapp__cpuFillRect(win, SI_RECT(x1, y, x2 - x1, 1), color);
+	}
+}
+
 
 void siapp_drawRectF(siWindow* win, siVec4 rect, siColor color) {
 	SI_ASSERT_NOT_NULL(win);
+	SI_STOPIF(siapp__clipRejects(win, rect), return);
+	SIAPP_TRACE_BEGIN("siapp_drawRect");
 
 	switch (win->renderType & SI_RENDERING_BITS) {
 		case SI_RENDERING_OPENGL: {
 			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-			SI_STOPIF(gl->vertexCounter + 4 > gl->maxVertexCount, siapp_windowRender(win));
+			siapp__batchReserve(win, 4);
 
-			f32 x1 = i32ToNDCX(rect.x, gl->size.width); // TODO(EimaMei): Optimize i32ToNDCX. SIMD MAYBE?
-			f32 y1 = i32ToNDCY(rect.y, gl->size.height);
-			f32 x2 = i32ToNDCX(rect.x + rect.z, gl->size.width);
-			f32 y2 = i32ToNDCY(rect.y + rect.w, gl->size.height);
+			f32 x1 = rect.x;
+			f32 y1 = rect.y;
+			f32 x2 = rect.x + rect.z;
+			f32 y2 = rect.y + rect.w;
 
-			siapp_color4f(win, color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f);
+			gl->curColor = color;
 
-			siapp_drawVertex2f(win, x1, y1);
-			siapp_drawVertex2f(win, x2, y1);
-			siapp_drawVertex2f(win, x2, y2);
-			siapp_drawVertex2f(win, x1, y2);
+			siapp__drawVertex(win, x1, y1);
+			siapp__drawVertex(win, x2, y1);
+			siapp__drawVertex(win, x2, y2);
+			siapp__drawVertex(win, x1, y2);
 
 			// NOTE(EimaMei): Check if this can be optimized with instances.
-			siapp__addVertexesToCMD(gl, 6, 4);
+			siapp__addVertexesToCMD(gl, SI_PRIMITIVE_QUAD, 4);
 			break;
 		}
 
 		case SI_RENDERING_CPU: {
-			siWinRenderingCtxCPU* cpu = &win->render.cpu;
-
 			siVec2 scale = win->scaleFactor;
 			siRect r = SI_RECT(
 				rect.x * scale.x,
@@ -5940,40 +9546,11 @@ void siapp_drawRectF(siWindow* win, siVec4 rect, siColor color) {
 				rect.z * scale.x,
 				rect.w * scale.y
 			);
-
-			f32 alpha = color.a / 255.0f;
-			color.r *= alpha;
-			color.g *= alpha;
-			color.b *= alpha;
-
-			alpha = 1.0f - alpha;
-
-			for_range (y, r.y, r.y + r.height) {
-				SI_STOPIF(y > win->e.windowSize.height, break);
-				usize index = y * cpu->width + r.x * SI__CHANNEL_COUNT;
-
-				for_range (x, r.x, r.x + r.width) {
-					SI_STOPIF(x > win->e.windowSize.width, break);
-					cpu->buffer[index + 0] *= alpha;
-					cpu->buffer[index + 1] *= alpha;
-					cpu->buffer[index + 2] *= alpha;
-
-#if defined(SIAPP_PLATFORM_API_X11) || defined(SIAPP_PLATFORM_API_WIN32)
-					cpu->buffer[index + 0] += color.b;
-					cpu->buffer[index + 1] += color.g;
-					cpu->buffer[index + 2] += color.r;
-#else
-					cpu->buffer[index + 0] += color.r;
-					cpu->buffer[index + 1] += color.g;
-					cpu->buffer[index + 2] += color.b;
-#endif
-
-					index += SI__CHANNEL_COUNT;
-				}
-			}
+			SI__CPU_DRAW(win, siapp__cpuFillRect(win, r, color));
 			break;
 		}
 	}
+	SIAPP_TRACE_END();
 }
 void siapp_drawImage(siWindow* win, siRect rect, siImage img) {
 	siapp_drawImageF(win, SI_VEC4_R(rect), img);
@@ -6001,16 +9578,22 @@ void siapp_drawImage(siWindow* win, siRect rect, siImage img) {
 void siapp__cpuDrawImage(siWindow* win, siPoint pos, siImage* img,
 		siVec4 tint) {
 	siTextureAtlas* atlas = img->atlas;
-	usize imgX = img->pos.cpu.x1;
-	usize imgY = img->pos.cpu.y1;
+	siRect clip = siapp__cpuClipGet(win);
+	i32 x1 = si_max(pos.x, clip.x),
+		y1 = si_max(pos.y, clip.y),
+		x2 = si_min(pos.x + (i32)img->size.width, clip.x + clip.width),
+		y2 = si_min(pos.y + (i32)img->size.height, clip.y + clip.height);
+
+	SI_STOPIF(x1 >= x2 || y1 >= y2, return);
+	siapp__cpuCountBlend(win, (x2 - x1) * (y2 - y1));
 
-	for_range (y, pos.y, pos.y + img->size.height) {
-		SI_STOPIF(y > win->e.windowSize.height, break);
+	usize imgX = img->pos.cpu.x1 + (x1 - pos.x);
+	usize imgY = img->pos.cpu.y1 + (y1 - pos.y);
 
-		usize index = y * win->render.cpu.width + pos.x * SI__CHANNEL_COUNT;
+	for_range (y, y1, y2) {
+		usize index = y * win->render.cpu.width + x1 * SI__CHANNEL_COUNT;
 		usize imgIndex = imgY * atlas->totalWidth + imgX;
-		for_range (x, pos.x, pos.x + img->size.width) {
-			SI_STOPIF(x > win->e.windowSize.width, break);
+		for_range (x, x1, x2) {
 			siapp_cpuBufferSetPixelFromImg(&win->render.cpu, index, imgIndex, tint);
 
 			index += SI__CHANNEL_COUNT;
@@ -6027,18 +9610,25 @@ void siapp__cpuDrawImageNearest(siWindow* win, siRect r, siImage* img,
 
 	f32 scaleW = img->size.width / (f32)r.width;
 	f32 scaleH = img->size.height / (f32)r.height;
-	f32 imgY = img->pos.cpu.y1;
 
+	siRect clip = siapp__cpuClipGet(win);
+	i32 x1 = si_max(r.x, clip.x),
+		y1 = si_max(r.y, clip.y),
+		x2 = si_min(r.x + r.width, clip.x + clip.width),
+		y2 = si_min(r.y + r.height, clip.y + clip.height);
+	SI_STOPIF(x1 >= x2 || y1 >= y2, return);
+	siapp__cpuCountBlend(win, (x2 - x1) * (y2 - y1));
 
-	for_range (y, r.y, r.y + r.height) {
-		SI_STOPIF(y > win->e.windowSize.height, break);
-		usize index = y * win->render.cpu.width + r.x * SI__CHANNEL_COUNT;
+	f32 imgY = img->pos.cpu.y1 + (y1 - r.y) * scaleH;
+
+	for_range (y, y1, y2) {
+		usize index = y * win->render.cpu.width + x1 * SI__CHANNEL_COUNT;
 		usize imgIndexY = (i32)imgY * atlas->totalWidth;
-		f32 imgIndexX = img->pos.cpu.x1;
+		f32 imgIndexX = img->pos.cpu.x1 + (x1 - r.x) * scaleW;
 
-		for_range (x, r.x, r.x + r.width) {
-			SI_STOPIF(x > win->e.windowSize.width, break);
+		for_range (x, x1, x2) {
 			siapp_cpuBufferSetPixelFromImg(&win->render.cpu, index, (usize)(imgIndexY + imgIndexX), tint);
+			index += SI__CHANNEL_COUNT;
 			imgIndexX += scaleW;
 		}
 		imgY += scaleH;
@@ -6051,15 +9641,22 @@ void siapp__cpuDrawImageLinear(siWindow* win, siRect r, siImage* img,
 
 	f32 scaleW = (img->size.width - 1) / (f32)r.width;
 	f32 scaleH = (img->size.height - 1) / (f32)r.height;
-	f32 imgY = img->pos.cpu.y1;
 
-	for_range (y, r.y, r.y + r.height) {
-		SI_STOPIF(y > win->e.windowSize.height, break);
-		usize index = y * win->render.cpu.width + r.x * SI__CHANNEL_COUNT;
-		f32 imgIndexX = img->pos.cpu.x1;
+	siRect clip = siapp__cpuClipGet(win);
+	i32 clipX1 = si_max(r.x, clip.x),
+		clipY1 = si_max(r.y, clip.y),
+		clipX2 = si_min(r.x + r.width, clip.x + clip.width),
+		clipY2 = si_min(r.y + r.height, clip.y + clip.height);
+	SI_STOPIF(clipX1 >= clipX2 || clipY1 >= clipY2, return);
+	siapp__cpuCountBlend(win, (clipX2 - clipX1) * (clipY2 - clipY1));
 
-		for_range (x, r.x, r.x + r.width) {
-			SI_STOPIF(x > win->e.windowSize.width, break);
+	f32 imgY = img->pos.cpu.y1 + (clipY1 - r.y) * scaleH;
+
+	for_range (y, clipY1, clipY2) {
+		usize index = y * win->render.cpu.width + clipX1 * SI__CHANNEL_COUNT;
+		f32 imgIndexX = img->pos.cpu.x1 + (clipX1 - r.x) * scaleW;
+
+		for_range (x, clipX1, clipX2) {
 			i32 x0 = (i32)imgIndexX;
 			i32 y0 = (i32)imgY * atlas->totalWidth;
 			i32 x1 = x0 + 1;
@@ -6098,34 +9695,141 @@ void siapp__cpuDrawImageLinear(siWindow* win, siRect r, siImage* img,
 			index += SI__CHANNEL_COUNT;
 			imgIndexX += scaleW;
 		}
-		imgY += scaleH;
+		imgY += scaleH;
+	}
+}
+
+#define SI__GLYPH_RUN_CAP 128
+
+typedef struct {
+	const siGlyphInfo* glyphs[SI__GLYPH_RUN_CAP];
+	siPoint pos[SI__GLYPH_RUN_CAP];
+	usize len;
+} siGlyphRun;
+
+F_TRAITS(intern)
+void siapp__cpuDrawGlyphRun(siWindow* win, const siFont* font, siGlyphRun* run) {
+	SI_STOPIF(run->len == 0, return);
+
+	siWinRenderingCtxCPU* cpu = &win->render.cpu;
+	const siSpriteSheet* sheet = &font->sheet;
+	const siColor* atlasData = sheet->base.atlas->texID.cpu->data;
+	usize atlasWidth = sheet->base.atlas->totalWidth;
+	siRect area = siapp__cpuClipGet(win);
+	i32 minX = area.x,
+		minY = area.y,
+		maxX = area.x + area.width,
+		maxY = area.y + area.height;
+
+	/* NOTE(EimaMei): Glyph masks only carry coverage in their alpha channel,
+	 * so the text colour gets converted into integers once for the whole run. */
+	siVec4 tint = win->textColor;
+	u32 alpha = (u32)(tint.w * 256.0f);
+#if defined(SIAPP_PLATFORM_API_X11) || defined(SIAPP_PLATFORM_API_WIN32)
+	u32 c0 = tint.z * 255.0f,
+		c2 = tint.x * 255.0f;
+#else
+	u32 c0 = tint.x * 255.0f,
+		c2 = tint.z * 255.0f;
+#endif
+	u32 c1 = tint.y * 255.0f;
+
+	/* NOTE(EimaMei): The run is clipped as a whole first. Per-glyph clipping
+	 * only happens if it sticks out of the clip. */
+	b32 clip = false;
+	for_range (i, 0, run->len) {
+		siPoint p = run->pos[i];
+		const siGlyphInfo* glyph = run->glyphs[i];
+		if (p.x < minX || p.y < minY || p.x + (i32)glyph->width > maxX || p.y + (i32)glyph->height > maxY) {
+			clip = true;
+			break;
+		}
+	}
+
+	for_range (i, 0, run->len) {
+		const siGlyphInfo* glyph = run->glyphs[i];
+		i32 x0 = run->pos[i].x,
+			y0 = run->pos[i].y,
+			x1 = x0 + (i32)glyph->width,
+			y1 = y0 + (i32)glyph->height;
+
+		usize atlasX = sheet->base.pos.cpu.x1 + glyph->texID % sheet->widthRatio * sheet->spriteSize.width,
+			  atlasY = sheet->base.pos.cpu.y1 + glyph->texID / sheet->widthRatio * sheet->spriteSize.height;
+
+		if (clip) {
+			SI_STOPIF(x0 < minX, atlasX += minX - x0; x0 = minX);
+			SI_STOPIF(y0 < minY, atlasY += minY - y0; y0 = minY);
+			x1 = si_min(x1, maxX);
+			y1 = si_min(y1, maxY);
+			SI_STOPIF(x0 >= x1 || y0 >= y1, continue);
+		}
+		siapp__cpuCountBlend(win, (x1 - x0) * (y1 - y0));
+
+		for_range (y, y0, y1) {
+			const siColor* src = &atlasData[(atlasY + (y - y0)) * atlasWidth + atlasX];
+			siByte* dst = &cpu->buffer[y * cpu->width + x0 * SI__CHANNEL_COUNT];
+
+			for_range (x, 0, x1 - x0) {
+				u32 a = (src[x].a * alpha) >> 8;
+				a += a >> 7;
+
+				if (a != 0) {
+					u32 inv = 256 - a;
+					dst[0] = (dst[0] * inv + c0 * a) >> 8;
+					dst[1] = (dst[1] * inv + c1 * a) >> 8;
+					dst[2] = (dst[2] * inv + c2 * a) >> 8;
+				}
+				dst += SI__CHANNEL_COUNT;
+			}
+		}
+	}
+}
+
+F_TRAITS(inline intern)
+b32 siapp__glyphRunUsable(const siWindow* win, f32 scaleFactor) {
+	return (win->renderType & SI_RENDERING_BITS) == SI_RENDERING_CPU
+		&& scaleFactor == 1.0f && win->scaleFactor.x == 1.0f && win->scaleFactor.y == 1.0f;
+}
+
+F_TRAITS(inline intern)
+void siapp__glyphRunPush(siWindow* win, const siFont* font, siGlyphRun* run,
+		const siGlyphInfo* glyph, siVec2 pos) {
+	if (run->len == SI__GLYPH_RUN_CAP) {
+		SI__CPU_DRAW(win, siapp__cpuDrawGlyphRun(win, font, run));
+		run->len = 0;
 	}
+
+	run->glyphs[run->len] = glyph;
+	run->pos[run->len] = SI_POINT(pos.x + glyph->x, pos.y + font->size + glyph->y);
+	run->len += 1;
 }
 
 void siapp_drawImageF(siWindow* win, siVec4 rect, siImage img) {
 	SI_ASSERT_NOT_NULL(win);
+	SI_STOPIF(siapp__clipRejects(win, rect), return);
+	SIAPP_TRACE_BEGIN("siapp_drawImage");
 
 	switch (win->renderType & SI_RENDERING_BITS) {
 		case SI_RENDERING_OPENGL: {
 			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-			SI_STOPIF(gl->vertexCounter + 4 > gl->maxVertexCount, siapp_windowRender(win));
+			siapp__batchReserve(win, 4);
 
-			f32 x1 = i32ToNDCX(rect.x, gl->size.width);
-			f32 y1 = i32ToNDCY(rect.y, gl->size.height);
-			f32 x2 = i32ToNDCX(rect.x + rect.z, gl->size.width);
-			f32 y2 = i32ToNDCY(rect.y + rect.w, gl->size.height);
+			f32 x1 = rect.x;
+			f32 y1 = rect.y;
+			f32 x2 = rect.x + rect.z;
+			f32 y2 = rect.y + rect.w;
 
 			siCoordsF32 tex = img.pos.gpu;
 			siapp_colorVec4f(win, win->imageColor);
 
-			siapp_texCoords2f(win, tex.x1, tex.y1); siapp_drawVertex2f(win, x1, y1);
-			siapp_texCoords2f(win, tex.x2, tex.y1); siapp_drawVertex2f(win, x2, y1);
-			siapp_texCoords2f(win, tex.x2, tex.y2); siapp_drawVertex2f(win, x2, y2);
-			siapp_texCoords2f(win, tex.x1, tex.y2); siapp_drawVertex2f(win, x1, y2);
+			siapp_texCoords2f(win, tex.x1, tex.y1); siapp__drawVertex(win, x1, y1);
+			siapp_texCoords2f(win, tex.x2, tex.y1); siapp__drawVertex(win, x2, y1);
+			siapp_texCoords2f(win, tex.x2, tex.y2); siapp__drawVertex(win, x2, y2);
+			siapp_texCoords2f(win, tex.x1, tex.y2); siapp__drawVertex(win, x1, y2);
 			siapp_texCoords2f(win, 0, 0);
 
 			gl->curTex = &img;
-			siapp__addVertexesToCMD(gl, 6, 4);
+			siapp__addVertexesToCMD(gl, SI_PRIMITIVE_QUAD, 4);
 			gl->curTex = &gl->defaultTex;
 			break;
 		}
@@ -6137,34 +9841,35 @@ void siapp_drawImageF(siWindow* win, siVec4 rect, siImage img) {
 
 
 			if (si_pointCmp(size, img.size)) {
-				siapp__cpuDrawImage(win, SI_POINT(rect.x, rect.y), &img, win->imageColor);
+				SI__CPU_DRAW(win, siapp__cpuDrawImage(win, SI_POINT(rect.x, rect.y), &img, win->imageColor));
 				break;
 			}
 
 			switch (img.atlas->texID.cpu->resizeMethod) {
 				case SI_RESIZE_NEAREST: {
-					siapp__cpuDrawImageNearest(
+					SI__CPU_DRAW(win, siapp__cpuDrawImageNearest(
 						win,
 						SI_RECT_A(rect.x, rect.y, size),
 						&img,
 						win->imageColor
-					);
+					));
 					break;
 				}
 
 				case SI_RESIZE_LINEAR: {
-					siapp__cpuDrawImageLinear(
+					SI__CPU_DRAW(win, siapp__cpuDrawImageLinear(
 						win,
 						SI_RECT_A(rect.x, rect.y, size),
 						&img,
 						win->imageColor
-					);
+					));
 					break;
 				}
 			}
 			break;
 		}
 	}
+	SIAPP_TRACE_END();
 }
 
 void siapp_drawTriangle(siWindow* win, siTriangle triangle, siColor color) {
@@ -6173,30 +9878,38 @@ void siapp_drawTriangle(siWindow* win, siTriangle triangle, siColor color) {
 void siapp_drawTriangleF(siWindow* win, siTriangleF triangle, siColor color) {
 	SI_ASSERT_NOT_NULL(win);
 
+	f32 x1 = si_minf(triangle.p1.x, si_minf(triangle.p2.x, triangle.p3.x)),
+		y1 = si_minf(triangle.p1.y, si_minf(triangle.p2.y, triangle.p3.y)),
+		x2 = si_maxf(triangle.p1.x, si_maxf(triangle.p2.x, triangle.p3.x)),
+		y2 = si_maxf(triangle.p1.y, si_maxf(triangle.p2.y, triangle.p3.y));
+	SI_STOPIF(siapp__clipRejects(win, SI_VEC4(x1, y1, x2 - x1, y2 - y1)), return);
+	SIAPP_TRACE_BEGIN("siapp_drawTriangle");
+
 	switch (win->renderType & SI_RENDERING_BITS) {
 		case SI_RENDERING_OPENGL: {
 			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-			SI_STOPIF(gl->vertexCounter + 3 > gl->maxVertexCount, siapp_windowRender(win));
-
-			f32 x1 = i32ToNDCX(triangle.p1.x, gl->size.width),
-				y1 = i32ToNDCY(triangle.p1.y, gl->size.height);
-			f32 x2 = i32ToNDCX(triangle.p2.x, gl->size.width),
-				y2 = i32ToNDCY(triangle.p2.y, gl->size.height);
-			f32 x3 = i32ToNDCX(triangle.p3.x, gl->size.width),
-				y3 = i32ToNDCY(triangle.p3.y, gl->size.height);
+			siapp__batchReserve(win, 3);
 
-			siapp_color4f(win, color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f);
-			siapp_drawVertex2f(win, x1, y1);
-			siapp_drawVertex2f(win, x2, y2);
-			siapp_drawVertex2f(win, x3, y3);
+			gl->curColor = color;
+			siapp__drawVertex(win, triangle.p1.x, triangle.p1.y);
+			siapp__drawVertex(win, triangle.p2.x, triangle.p2.y);
+			siapp__drawVertex(win, triangle.p3.x, triangle.p3.y);
 
-			siapp__addVertexesToCMD(gl, 3, 3);
+			siapp__addVertexesToCMD(gl, SI_PRIMITIVE_TRIANGLE, 3);
 			break;
 		}
 		case SI_RENDERING_CPU: {
+			siVec2 scale = win->scaleFactor;
+			siVec2 points[3] = {
+				SI_VEC2(triangle.p1.x * scale.x, triangle.p1.y * scale.y),
+				SI_VEC2(triangle.p2.x * scale.x, triangle.p2.y * scale.y),
+				SI_VEC2(triangle.p3.x * scale.x, triangle.p3.y * scale.y)
+			};
+			SI__CPU_DRAW(win, siapp__cpuFillConvex(win, points, countof(points), color));
 			break;
 		}
 	}
+	SIAPP_TRACE_END();
 }
 void siapp_drawTriangleRight(siWindow* win, siPoint start, f32 hypotenuse,
 		f32 startingAngle, siColor color) {
@@ -6255,38 +9968,56 @@ void siapp_drawPolygon(siWindow* win, siRect rect, u32 sides, siColor color) {
 }
 void siapp_drawPolygonF(siWindow* win, siVec4 rect, u32 sides, siColor color) {
 	SI_ASSERT_NOT_NULL(win);
+	SI_STOPIF(siapp__clipRejects(win, rect), return);
+	SI_ASSERT(sides >= 3);
+	SIAPP_TRACE_BEGIN("siapp_drawPolygon");
 
-	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-	SI_STOPIF(gl->vertexCounter + sides > gl->maxVertexCount, siapp_windowRender(win));
-
-	f32 radiusX = i32ToNDCX(rect.x + rect.z / 2.0f, gl->size.width);
-	f32 radiusY = i32ToNDCY(rect.y + rect.w / 2.0f, gl->size.height);
-	f32 x2 = rect.z / gl->size.width;
-	f32 y2 = rect.w / gl->size.height; /* NOTE(EimaMei): We can just use the
-											width/height directly instead of
-											radiuses due to the NDC formula
-											requiring a multiplication by two,
-											so the divide and multiply get
-											canceled out. */
-
+	f32 x2 = rect.z / 2.0f;
+	f32 y2 = rect.w / 2.0f;
+	f32 radiusX = rect.x + x2;
+	f32 radiusY = rect.y + y2;
 
 	f32 theta = SI_TO_RADIANS(360.0f / (f32)sides);
 	f32 angle = 0;
 
-	siapp_color4f(win, color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f);
+	switch (win->renderType & SI_RENDERING_BITS) {
+		case SI_RENDERING_OPENGL: {
+			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+			siapp__batchReserve(win, sides);
+			gl->curColor = color;
 
-	f32 x, y;
-	for_range (i, 0, sides) {
-		x = radiusX + x2 * si_sin(angle),
-		y = radiusY + y2 * si_cos(angle);
+			f32 x, y;
+			for_range (i, 0, sides) {
+				x = radiusX + x2 * si_sin(angle),
+				y = radiusY - y2 * si_cos(angle);
 
-		siapp_drawVertex2f(win, x, y);
-		angle += theta;
-	}
+				siapp__drawVertex(win, x, y);
+				angle += theta;
+			}
+
+			siapp__addVertexesToCMD(gl, SI_PRIMITIVE_FAN, sides);
+			break;
+		}
+		case SI_RENDERING_CPU: {
+			siVec2 stackPoints[128];
+			siVec2* points = (sides <= countof(stackPoints)) ? stackPoints : malloc(sides * sizeof(siVec2));
+			SI_ASSERT_NOT_NULL(points);
+
+			siVec2 scale = win->scaleFactor;
+			for_range (i, 0, sides) {
+				points[i] = SI_VEC2(
+					(radiusX + x2 * si_sin(angle)) * scale.x,
+					(radiusY - y2 * si_cos(angle)) * scale.y
+				);
+				angle += theta;
+			}
 
-	u32 half = sides / 2;
-	half &= ~SI_BIT(0); /* NOTE(EimaMei): Makes the number even by clearing bit 0. */
-	siapp__addVertexesToCMD(gl, sides + half, sides);
+			SI__CPU_DRAW(win, siapp__cpuFillConvex(win, points, sides, color));
+			SI_STOPIF(points != stackPoints, free(points));
+			break;
+		}
+	}
+	SIAPP_TRACE_END();
 }
 
 f32 siapp_drawText(siWindow* win, cstring text, siFont* font, siPoint pos, u32 size) {
@@ -6300,12 +10031,21 @@ f32 siapp_drawTextF(siWindow* win, cstring text, siFont* font, siVec2 pos, u32 s
 	siVec2 base = pos;
 	f32 width = 0;
 
+	siGlyphRun run;
+	run.len = 0;
+	b32 useRun = siapp__glyphRunUsable(win, scaleFactor);
+	SIAPP_TRACE_BEGIN("siapp_drawText");
+
 	usize index = 0;
 	while (true) {
 		siUtf32Char x = si_utf8Decode(&text[index]);
 		switch (x.codepoint) {
 			case SI_UNICODE_INVALID:
-			case 0: return si_maxf(width, base.x);
+			case 0: {
+				SI__CPU_DRAW(win, siapp__cpuDrawGlyphRun(win, font, &run));
+				SIAPP_TRACE_END();
+				return si_maxf(width, base.x);
+			}
 
 			case ' ': {
 				base.x += font->advance.space * scaleFactor;
@@ -6328,8 +10068,13 @@ f32 siapp_drawTextF(siWindow* win, cstring text, siFont* font, siVec2 pos, u32 s
 		}
 
 		siGlyphInfo* glyph = siapp_fontGlyphFind(font, x.codepoint);
-		f32 advance = siapp_drawCharacterScale(win, font, glyph, base, size, scaleFactor);
-		base.x += advance;
+		if (useRun) {
+			siapp__glyphRunPush(win, font, &run, glyph, base);
+			base.x += glyph->advanceX;
+		}
+		else {
+			base.x += siapp_drawCharacterScale(win, font, glyph, base, size, scaleFactor);
+		}
 		index += x.len;
 	}
 }
@@ -6341,182 +10086,960 @@ f32 siapp_drawTextWithWrapF(siWindow* win, cstring text, siFont* font, siVec2 po
 		u32 size, f32 maxWidth) {
 	SI_ASSERT_NOT_NULL(win);
 	SI_ASSERT((win->renderType & SI_RENDERING_BITS) == (font->sheet.base.atlas->render));
+	SIAPP_TRACE_BEGIN("siapp_drawTextWithWrap");
 
-	b16 italic = false;
-	b16 bold = false;
-	f32 scaleFactor = (f32)size / font->size;
-	siVec2 base = pos;
+	siTextLayout* layout = &SI_TEXT_WRAP_LAYOUT;
+	if (layout->font != font || layout->size != size || SI_TEXT_WRAP_ALLOC != font->alloc) {
+		siapp_textLayoutFree(layout);
+		*layout = siapp_textLayoutMake(font, size);
+		SI_TEXT_WRAP_ALLOC = font->alloc;
+	}
+	siapp_textLayoutUpdate(layout, text, strlen(text), maxWidth - pos.x);
+
+	f32 width = siapp_drawTextLayout(win, layout, text, pos, 0, (f32)layout->lineCount * layout->lineHeight);
+	SIAPP_TRACE_END();
+	return width;
+}
+
+siTextLayout siapp_textLayoutMake(siFont* font, u32 size) {
+	SI_ASSERT_NOT_NULL(font);
+
+	siTextLayout layout = {0};
+	layout.font = font;
+	layout.size = size;
+	layout.lineHeight = font->advance.newline * ((f32)size / font->size);
+
+	return layout;
+}
+void siapp_textLayoutUpdate(siTextLayout* layout, cstring text, usize len, f32 maxWidth) {
+	SI_ASSERT_NOT_NULL(layout);
+	SI_ASSERT(text != nil || len == 0);
+
+	siTextParagraph* old = layout->paragraphs;
+	usize oldLen = layout->paragraphLen;
+
+	layout->maxWidth = maxWidth;
+	layout->paragraphs = nil;
+	layout->paragraphLen = 0;
+	layout->paragraphCap = 0;
+	SI__ARRAY_RESERVE(layout->paragraphs, layout->paragraphCap, oldLen);
+
+	siapp__textLayoutSplit(
+		layout, text, 0, len, old, oldLen,
+		&layout->paragraphs, &layout->paragraphLen, &layout->paragraphCap
+	);
+	free(old);
+	siapp__textLayoutCount(layout, 0);
+}
+void siapp_textLayoutEdit(siTextLayout* layout, cstring text, usize len, usize start,
+		usize removed, usize inserted) {
+	SI_ASSERT_NOT_NULL(layout);
+	SI_ASSERT(text != nil || len == 0);
+	SI_ASSERT(start + inserted <= len);
+	SI_STOPIF(layout->paragraphLen == 0, siapp_textLayoutUpdate(layout, text, len, layout->maxWidth); return);
+
+	/* NOTE(EimaMei): Only the paragraphs that contain the edit are split again,
+	 * the ones after it merely get moved. */
+	usize first = siapp__textLayoutParagraphFind(layout, start),
+		  last = siapp__textLayoutParagraphFind(layout, start + removed);
+	usize oldLen = last - first + 1;
+
+	siTextParagraph* edited = nil;
+	usize editedLen = 0,
+		  editedCap = 0;
+	siapp__textLayoutSplit(
+		layout, text, layout->paragraphs[first].start,
+		siapp__textParagraphEnd(text, start + inserted, len),
+		&layout->paragraphs[first], oldLen, &edited, &editedLen, &editedCap
+	);
+
+	usize tail = layout->paragraphLen - (last + 1);
+	SI__ARRAY_RESERVE(layout->paragraphs, layout->paragraphCap, first + editedLen + tail);
+	siTextParagraph* moved = &layout->paragraphs[first + editedLen];
+	memmove(moved, &layout->paragraphs[last + 1], tail * sizeof(siTextParagraph));
+	memcpy(&layout->paragraphs[first], edited, editedLen * sizeof(siTextParagraph));
+	layout->paragraphLen = first + editedLen + tail;
+	free(edited);
+
+	for_range (i, 0, tail) {
+		moved[i].start = moved[i].start - removed + inserted;
+	}
+	siapp__textLayoutCount(layout, first);
+}
+usize siapp_textLayoutLineFind(const siTextLayout* layout, f32 offsetY) {
+	SI_ASSERT_NOT_NULL(layout);
+	SI_STOPIF(offsetY <= 0 || layout->lineCount == 0, return 0);
+
+	usize line = (usize)(offsetY / layout->lineHeight);
+	return si_min(line, layout->lineCount - 1);
+}
+siTextLine siapp_textLayoutLineGet(const siTextLayout* layout, usize line) {
+	SI_ASSERT_NOT_NULL(layout);
+	SI_ASSERT(line < layout->lineCount);
+
+	usize low = 0,
+		  high = layout->paragraphLen - 1;
+	while (low < high) {
+		usize mid = low + (high - low + 1) / 2;
+		SI_STOPIF(layout->paragraphs[mid].firstLine <= line, low = mid; continue);
+		high = mid - 1;
+	}
+
+	const siTextParagraph* p = &layout->paragraphs[low];
+	siTextLine res = p->lines[line - p->firstLine];
+	res.start += p->start;
+
+	return res;
+}
+void siapp_textLayoutFree(siTextLayout* layout) {
+	SI_ASSERT_NOT_NULL(layout);
+
+	for_range (i, 0, layout->paragraphLen) {
+		free(layout->paragraphs[i].breaks);
+		free(layout->paragraphs[i].lines);
+	}
+	free(layout->paragraphs);
+	*layout = (siTextLayout){0};
+}
+
+f32 siapp_drawTextLayout(siWindow* win, const siTextLayout* layout, cstring text,
+		siVec2 pos, f32 scrollY, f32 height) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT_NOT_NULL(layout);
+	SI_STOPIF(layout->lineCount == 0, return pos.x);
+	SIAPP_TRACE_BEGIN("siapp_drawTextLayout");
+
+	siFont* font = layout->font;
+	f32 scaleFactor = (f32)layout->size / font->size;
 	f32 width = 0;
-	usize index = 0;
 
-	while (true) {
-		siUtf32Char x = si_utf8Decode(&text[index]);
-		switch (x.codepoint) {
-			case SI_UNICODE_INVALID:
-			case 0: return si_maxf(width, base.x);
+	siGlyphRun run;
+	run.len = 0;
+	b32 useRun = siapp__glyphRunUsable(win, scaleFactor);
 
-			case ' ': {
-				base.x += font->advance.space * scaleFactor;
-				index += 1;
-				siapp__drawTextWrapped(win, text, font, pos.x, size, maxWidth, scaleFactor, &base, &width, &index);
-				continue;
+	usize line = siapp_textLayoutLineFind(layout, scrollY);
+	siVec2 base = SI_VEC2(pos.x, pos.y + line * layout->lineHeight - scrollY);
+	f32 bottom = pos.y + height;
+
+	while (line < layout->lineCount && base.y < bottom) {
+		siTextLine l = siapp_textLayoutLineGet(layout, line);
+		usize index = l.start;
+
+		/* NOTE(EimaMei): Lines outside of the clip only need their width. */
+		if (siapp__clipRejects(win, SI_VEC4(base.x, base.y, l.width, layout->lineHeight))) {
+			base.x += l.width;
+			index += l.len;
+		}
+
+		while (index < l.start + l.len) {
+			siUtf32Char x = si_utf8Decode(&text[index]);
+			SI_STOPIF(x.codepoint == SI_UNICODE_INVALID, x.len = 1);
+
+			if (x.codepoint == ' ' || x.codepoint == '\t' || x.codepoint == '\r') {
+				base.x += siapp__textAdvance(font, x.codepoint, scaleFactor);
 			}
-			case '\t': {
-				base.x += font->advance.tab * scaleFactor;
-				index += 1;
-				continue;
+			else if (useRun) {
+				siGlyphInfo* glyph = siapp_fontGlyphFind(font, x.codepoint);
+				siapp__glyphRunPush(win, font, &run, glyph, base);
+				base.x += glyph->advanceX;
 			}
-			case '\r':
-			case '\n': {
-				width = si_maxf(width, base.x);
-				base.x = pos.x;
-				base.y += font->advance.newline * scaleFactor;
-				index += 1;
-				continue;
+			else {
+				siGlyphInfo* glyph = siapp_fontGlyphFind(font, x.codepoint);
+				base.x += siapp_drawCharacterScale(win, font, glyph, base, layout->size, scaleFactor);
+			}
+			index += x.len;
+		}
+
+		width = si_maxf(width, pos.x + l.width);
+		base.x = pos.x;
+		base.y += layout->lineHeight;
+		line += 1;
+	}
+	SI__CPU_DRAW(win, siapp__cpuDrawGlyphRun(win, font, &run));
+
+	SIAPP_TRACE_END();
+	return width;
+}
+
+f32 siapp_drawCharacterScale(siWindow* win, const siFont* font, const siGlyphInfo* character,
+		siVec2 pos, u32 size, f32 scaleFactor) {
+	SI_ASSERT_NOT_NULL(win);
+	const siGlyphInfo* glyph = character;
+
+	siVec4 rect = SI_VEC4(
+		pos.x + glyph->x * scaleFactor,
+		pos.y + size + glyph->y * scaleFactor,
+		glyph->width * scaleFactor,
+		glyph->height * scaleFactor
+	);
+	SI_STOPIF(siapp__clipRejects(win, rect), return glyph->advanceX * scaleFactor);
+
+	switch (win->renderType & SI_RENDERING_BITS) {
+		case SI_RENDERING_OPENGL: {
+			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+			siapp__batchReserve(win, 4);
+
+			siImage img = siapp_spriteSheetSpriteGet(font->sheet, glyph->texID);
+			siCoordsF32 tex = img.pos.gpu;
+
+			// TODO(EimaMei): Make this slightly faster. | SET
+			tex.x2 = tex.x1 + (glyph->width / img.atlas->totalWidth);
+			tex.y2 = tex.y1 + (glyph->height / img.atlas->texHeight);
+
+			f32 x = glyph->x * scaleFactor;
+			f32 y = glyph->y * scaleFactor;
+			f32 width = glyph->width * scaleFactor;
+			f32 height = glyph->height * scaleFactor;
+
+			f32 baseX = pos.x + x,
+				baseY = pos.y + y + size;
+
+			f32 x1 = baseX;
+			f32 x2 = baseX + width;
+			f32 y1 = baseY;
+			f32 y2 = baseY + height;
+
+			{
+				siapp_colorVec4f(win, win->textColor);
+
+				siapp_texCoords2f(win, tex.x1, tex.y1); siapp__drawVertex(win, x1, y1);
+				siapp_texCoords2f(win, tex.x2, tex.y1); siapp__drawVertex(win, x2, y1);
+				siapp_texCoords2f(win, tex.x2, tex.y2); siapp__drawVertex(win, x2, y2);
+				siapp_texCoords2f(win, tex.x1, tex.y2); siapp__drawVertex(win, x1, y2);
+				siapp_texCoords2f(win, 0, 0);
+
+				gl->curTex = &img;
+				siapp__addVertexesToCMD(gl, SI_PRIMITIVE_QUAD, 4);
+				gl->curTex = &gl->defaultTex;
+			}
+			break;
+		}
+		case SI_RENDERING_CPU: {
+			siImage img = siapp_spriteSheetSpriteGet(font->sheet, glyph->texID);
+			img.size = SI_AREA(glyph->width, glyph->height);
+
+			siVec2 scale = win->scaleFactor;
+			siRect r = SI_RECT(
+				(pos.x + glyph->x * scaleFactor) * scale.x,
+				(pos.y + size + glyph->y * scaleFactor) * scale.y,
+				glyph->width * scaleFactor * scale.x,
+				glyph->height * scaleFactor * scale.y
+			);
+			size *= scaleFactor;
+
+			if (size == font->size && scale.x == 1 && scale.y == 1) {
+				SI__CPU_DRAW(win, siapp__cpuDrawImage(win, SI_POINT(r.x, r.y), &img, win->textColor));
+				break;
+			}
+
+			switch (img.atlas->texID.cpu->resizeMethod) {
+				case SI_RESIZE_NEAREST: {
+					SI__CPU_DRAW(win, siapp__cpuDrawImageNearest(
+						win,
+						r,
+						&img,
+						win->textColor
+					));
+					break;
+				}
+
+				case SI_RESIZE_LINEAR: {
+					SI__CPU_DRAW(win, siapp__cpuDrawImageLinear(
+						win,
+						r,
+						&img,
+						win->textColor
+					));
+					break;
+				}
+			}
+			break;
+		}
+	}
+
+	return glyph->advanceX * scaleFactor;
+}
+
+void siapp_color3f(siWindow* win, f32 r, f32 g, f32 b) {
+	siapp_color4f(win, r, g, b, 1.0f);
+}
+void siapp_color4f(siWindow* win, f32 r, f32 g, f32 b, f32 a) {
+	SI_ASSERT_NOT_NULL(win);
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	gl->curColor = SI_RGBA(r * 255.0f, g * 255.0f, b * 255.0f, a * 255.0f);
+}
+void siapp_colorVec4f(siWindow* win, siVec4 color) {
+	siapp_color4f(win, color.x, color.y, color.z, color.w);
+}
+
+void siapp_texCoords2f(siWindow* win, f32 x, f32 y) {
+	SI_ASSERT_NOT_NULL(win);
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	gl->curTexCoords[0] = (u16)si_round(si_minf(si_maxf(x, 0.0f), 1.0f) * UINT16_MAX);
+	gl->curTexCoords[1] = (u16)si_round(si_minf(si_maxf(y, 0.0f), 1.0f) * UINT16_MAX);
+}
+
+/* Returns the OpenGL context of the window, or 'nil' if it's legacy OpenGL,
+ * which doesn't have transforms. */
+F_TRAITS(intern)
+siWinRenderingCtxOpenGL* siapp__transformContext(siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT((win->renderType & SI_RENDERING_BITS) == SI_RENDERING_OPENGL);
+	SI_STOPIF((win->renderType & SI_RENDERING_OPENGL_BITS) == SI_RENDERINGVER_OPENGL_LEGACY, return nil);
+
+	return &win->render.opengl;
+}
+
+void siapp_transformPush(siWindow* win) {
+	siWinRenderingCtxOpenGL* gl = siapp__transformContext(win);
+	SI_STOPIF(gl == nil, return);
+	SI_ASSERT_MSG(gl->transformLen + 1 < SI_OPENGL_TRANSFORM_DEPTH, "The transform stack is full.");
+
+	gl->transforms[gl->transformLen + 1] = gl->transforms[gl->transformLen];
+	gl->transformLen += 1;
+}
+void siapp_transformPop(siWindow* win) {
+	siWinRenderingCtxOpenGL* gl = siapp__transformContext(win);
+	SI_STOPIF(gl == nil, return);
+	SI_ASSERT_MSG(gl->transformLen != 0, "The transform stack is empty.");
+
+	gl->transformLen -= 1;
+	siapp__transformCommit(win);
+}
+void siapp_transformReset(siWindow* win) {
+	siWinRenderingCtxOpenGL* gl = siapp__transformContext(win);
+	SI_STOPIF(gl == nil, return);
+
+	gl->transforms[gl->transformLen] = rglMatrixIdentity();
+	siapp__transformCommit(win);
+}
+void siapp_transformTranslate(siWindow* win, f32 x, f32 y) {
+	siWinRenderingCtxOpenGL* gl = siapp__transformContext(win);
+	SI_STOPIF(gl == nil, return);
+	siMatrix* m = &gl->transforms[gl->transformLen];
+
+	m->column[3].x += m->column[0].x * x + m->column[1].x * y;
+	m->column[3].y += m->column[0].y * x + m->column[1].y * y;
+	siapp__transformCommit(win);
+}
+void siapp_transformScale(siWindow* win, f32 x, f32 y) {
+	siWinRenderingCtxOpenGL* gl = siapp__transformContext(win);
+	SI_STOPIF(gl == nil, return);
+	siMatrix* m = &gl->transforms[gl->transformLen];
+
+	m->column[0].x *= x; m->column[0].y *= x;
+	m->column[1].x *= y; m->column[1].y *= y;
+	siapp__transformCommit(win);
+}
+void siapp_transformRotate(siWindow* win, f32 degrees) {
+	siWinRenderingCtxOpenGL* gl = siapp__transformContext(win);
+	SI_STOPIF(gl == nil, return);
+	siMatrix* m = &gl->transforms[gl->transformLen];
+
+	f32 angle = SI_TO_RADIANS(degrees);
+	f32 c = si_cos(angle),
+		s = si_sin(angle);
+
+	siVec4 col0 = m->column[0],
+		   col1 = m->column[1];
+	m->column[0] = SI_VEC4(c * col0.x + s * col1.x, c * col0.y + s * col1.y, col0.z, col0.w);
+	m->column[1] = SI_VEC4(c * col1.x - s * col0.x, c * col1.y - s * col0.y, col1.z, col1.w);
+	siapp__transformCommit(win);
+}
+
+void siapp_windowDeferredSet(siWindow* win, b32 deferred) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT((win->renderType & SI_RENDERING_BITS) == SI_RENDERING_OPENGL);
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	SI_STOPIF((win->renderType & SI_RENDERING_OPENGL_BITS) == SI_RENDERINGVER_OPENGL_LEGACY, return);
+	SI_STOPIF((gl->deferred != nil) == (deferred != false), return);
+
+	/* NOTE(EimaMei): Pending draws were recorded in the other mode, so they
+	 * have to be rendered before switching. */
+	SI_STOPIF(gl->vertexCounter != 0 || gl->drawCounter != 0, siapp_windowOpenGLRender(win));
+
+	if (deferred) {
+		gl->deferred = calloc(1, sizeof(siOpenGLDeferred));
+		SI_ASSERT_NOT_NULL(gl->deferred);
+		siapp__deferredResize(gl);
+		siapp__deferredTilesMake(gl);
+		siapp__verticesSet(gl, gl->vertices);
+	}
+	else {
+		siOpenGLDeferred* d = gl->deferred;
+		gl->vertices = d->mapped;
+		gl->deferred = nil;
+
+		free(d->vertices);
+		free(d->keys);
+		free(d->keysTmp);
+		free(d->order);
+		free(d->orderTmp);
+		free(d->CMDs);
+		free(d->tiles);
+		free(d);
+	}
+}
+void siapp_drawLayerSet(siWindow* win, u8 layer) {
+	SI_ASSERT_NOT_NULL(win);
+	win->render.opengl.layer = layer;
+}
+
+void siapp_clipPush(siWindow* win, siRect rect) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT_MSG(win->clipLen < SI_CLIP_DEPTH, "The clip stack is full.");
+
+	siVec4 prev = siapp__clipGet(win);
+	siVec4 clip = SI_VEC4(rect.x, rect.y, rect.width, rect.height);
+	SI_STOPIF(win->clipLen != win->clipBase, clip = siapp__rectIntersect(clip, win->clips[win->clipLen - 1]));
+
+	win->clips[win->clipLen] = clip;
+	win->clipLen += 1;
+	siapp__clipUpdate(win, prev);
+}
+void siapp_clipPop(siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT_MSG(win->clipLen != win->clipBase, "The clip stack is empty.");
+
+	siVec4 prev = siapp__clipGet(win);
+	win->clipLen -= 1;
+	siapp__clipUpdate(win, prev);
+}
+
+void siapp_drawListBegin(siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+
+	switch (win->renderType & SI_RENDERING_BITS) {
+		case SI_RENDERING_OPENGL: {
+			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+			SI_ASSERT_MSG(gl->recording == nil, "A draw list is already being recorded.");
+			SI_STOPIF(gl->vertexCounter != 0 || gl->drawCounter != 0, siapp_windowOpenGLRender(win));
+
+			siOpenGLRecording* rec = malloc(sizeof(siOpenGLRecording));
+			SI_ASSERT_NOT_NULL(rec);
+			rec->mapped = gl->vertices;
+			rec->maxVertexCount = gl->maxVertexCount;
+			rec->vertices = malloc(gl->maxVertexCount * sizeof(siOpenGLVertex));
+			rec->primCap = 64;
+			rec->primLen = 0;
+			rec->prims = malloc(rec->primCap * sizeof(siOpenGLRecorded));
+			SI_ASSERT(rec->vertices != nil && rec->prims != nil);
+
+			gl->vertices = rec->vertices;
+			gl->recording = rec;
+			break;
+		}
+		case SI_RENDERING_CPU: {
+			siWinRenderingCtxCPU* cpu = &win->render.cpu;
+			SI_ASSERT_MSG(cpu->recording[0] == nil, "A draw list is already being recorded.");
+
+			usize size = cpu->width * win->e.windowSize.height;
+			cpu->recording[0] = calloc(size, 1);
+			cpu->recording[1] = malloc(size);
+			SI_ASSERT(cpu->recording[0] != nil && cpu->recording[1] != nil);
+			memset(cpu->recording[1], 0xFF, size);
+			break;
+		}
+	}
+}
+siDrawList siapp_drawListEnd(siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+
+	siDrawList list = {0};
+	list.render = win->renderType & SI_RENDERING_BITS;
+
+	switch (list.render) {
+		case SI_RENDERING_OPENGL: {
+			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+			siOpenGLRecording* rec = gl->recording;
+			SI_ASSERT_MSG(rec != nil, "No draw list is being recorded.");
+
+			/* NOTE(EimaMei): Every primitive gets turned into plain triangles,
+			 * so that only a change of texture splits the list. */
+			u32 indexCount = 0;
+			for_range (i, 0, rec->primLen) {
+				const siOpenGLRecorded* prim = &rec->prims[i];
+				switch (prim->type) {
+					case SI_PRIMITIVE_QUAD: indexCount += prim->vertexCount / 4 * 6; break;
+					case SI_PRIMITIVE_TRIANGLE: indexCount += prim->vertexCount; break;
+					case SI_PRIMITIVE_FAN: indexCount += (prim->vertexCount - 2) * 3; break;
+				}
 			}
 
-			case '%': {
-				index += 1;
-				switch (text[index]) {
-					case '%': continue;
-					case '_': italic = true; continue;
+			u32* indices = malloc(si_max(indexCount, 1) * sizeof(u32));
+			siOpenGLIDs* IDs = malloc(si_max(rec->primLen, 1) * sizeof(siOpenGLIDs));
+			list.CMDs = malloc(si_max(rec->primLen, 1) * sizeof(siOpenGLDrawCMD));
+			SI_ASSERT(indices != nil && IDs != nil && list.CMDs != nil);
+
+			u32 base = 0, index = 0;
+			for_range (i, 0, rec->primLen) {
+				const siOpenGLRecorded* prim = &rec->prims[i];
+				u32 start = index;
+
+				switch (prim->type) {
+					case SI_PRIMITIVE_QUAD: {
+						for (u32 v = base; v < base + prim->vertexCount; v += 4) {
+							indices[index + 0] = v + 0;
+							indices[index + 1] = v + 1;
+							indices[index + 2] = v + 2;
+							indices[index + 3] = v + 0;
+							indices[index + 4] = v + 2;
+							indices[index + 5] = v + 3;
+							index += 6;
+						}
+						break;
+					}
+					case SI_PRIMITIVE_TRIANGLE: {
+						for_range (v, base, base + prim->vertexCount) {
+							indices[index] = v;
+							index += 1;
+						}
+						break;
+					}
+					case SI_PRIMITIVE_FAN: {
+						for_range (v, base + 1, base + prim->vertexCount - 1) {
+							indices[index + 0] = base;
+							indices[index + 1] = v;
+							indices[index + 2] = v + 1;
+							index += 3;
+						}
+						break;
+					}
+				}
+				base += prim->vertexCount;
+
+				if (list.CMDLen != 0 && IDs[list.CMDLen - 1].texID == prim->texID) {
+					list.CMDs[list.CMDLen - 1].count += index - start;
+					continue;
 				}
-				break;
+
+				siOpenGLDrawCMD* cmd = &list.CMDs[list.CMDLen];
+				cmd->count = index - start;
+				cmd->instanceCount = 1;
+				cmd->firstIndex = start;
+				cmd->baseVertex = 0;
+				cmd->baseInstance = list.CMDLen;
+				cmd->mode = GL_TRIANGLES;
+
+				IDs[list.CMDLen].texID = prim->texID;
+				IDs[list.CMDLen].matrixID = 0;
+				list.CMDLen += 1;
 			}
-		}
 
-		if (base.x > maxWidth) {
-			width = maxWidth;
-			base.x = pos.x;
-			base.y += font->advance.newline * scaleFactor;
+			glGenVertexArrays(1, &list.VAO);
+			glBindVertexArray(list.VAO);
+			glGenBuffers(countof(list.VBOs), list.VBOs);
+
+			glBindBuffer(GL_ARRAY_BUFFER, list.VBOs[SI_VBO_VERTEX]);
+			glBufferData(GL_ARRAY_BUFFER, gl->vertexCounter * sizeof(siOpenGLVertex), rec->vertices, GL_STATIC_DRAW);
+			siapp__vertexFormatSet(list.VBOs[SI_VBO_VERTEX]);
+			glEnableVertexAttribArray(SI_SHADER_POS);
+			glEnableVertexAttribArray(SI_SHADER_TEX);
+			glEnableVertexAttribArray(SI_SHADER_CLR);
+
+			glBindBuffer(GL_ARRAY_BUFFER, list.VBOs[SI_VBO_ID]);
+			glBufferData(GL_ARRAY_BUFFER, list.CMDLen * sizeof(siOpenGLIDs), IDs, GL_STATIC_DRAW);
+			glVertexAttribIPointer(SI_SHADER_ID, 2, GL_UNSIGNED_INT, 0, 0);
+			glEnableVertexAttribArray(SI_SHADER_ID);
+			glVertexAttribDivisor(SI_SHADER_ID, 1);
+
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, list.VBOs[SI_VBO_ELM]);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(u32), indices, GL_STATIC_DRAW);
+			glBindVertexArray(gl->VAO);
+
+			free(indices);
+			free(IDs);
+
+			gl->vertices = rec->mapped;
+			gl->maxVertexCount = rec->maxVertexCount;
+			gl->vertexCounter = 0;
+			gl->recording = nil;
+			free(rec->vertices);
+			free(rec->prims);
+			free(rec);
+			break;
 		}
+		case SI_RENDERING_CPU: {
+			siWinRenderingCtxCPU* cpu = &win->render.cpu;
+			SI_ASSERT_MSG(cpu->recording[0] != nil, "No draw list is being recorded.");
+
+			const siByte* black = cpu->recording[0];
+			const siByte* white = cpu->recording[1];
+			list.size = win->e.windowSize;
+
+			u32 spanCap = 64, pixelCap = 256;
+			list.spans = malloc(spanCap * sizeof(siCPUSpan));
+			list.pixels = malloc(pixelCap * sizeof(siColor));
+			u32 pixelLen = 0;
+
+			/* NOTE(EimaMei): The list was drawn over black and over white. The
+			 * black result is the premultiplied colour, the difference between
+			 * the two is how much of the background still shows through. */
+			for_range (y, 0, list.size.height) {
+				siCPUSpan* span = nil;
+
+				/* NOTE(EimaMei): A whole row always fits, so pixels don't have
+				 * to be checked one by one. */
+				if (pixelLen + list.size.width > pixelCap) {
+					while (pixelLen + list.size.width > pixelCap) { pixelCap *= 2; }
+					list.pixels = realloc(list.pixels, pixelCap * sizeof(siColor));
+					SI_ASSERT_NOT_NULL(list.pixels);
+				}
 
-		siGlyphInfo* glyph = siapp_fontGlyphFind(font, x.codepoint);
-		f32 advance = siapp_drawCharacterScale(win, font, glyph, base, size, scaleFactor);
-		base.x += advance;
-		index += x.len;
+				for_range (x, 0, list.size.width) {
+					usize index = y * cpu->width + x * SI__CHANNEL_COUNT;
+					i32 through = white[index + 0] - black[index + 0];
+					through = si_min(through, white[index + 1] - black[index + 1]);
+					through = si_min(through, white[index + 2] - black[index + 2]);
+
+					if (through >= 255) {
+						span = nil;
+						continue;
+					}
+
+					siColor pixel = {black[index + 0], black[index + 1], black[index + 2], 255 - si_max(through, 0)};
+
+					if (span == nil) {
+						if (list.spanLen == spanCap) {
+							spanCap *= 2;
+							list.spans = realloc(list.spans, spanCap * sizeof(siCPUSpan));
+							SI_ASSERT_NOT_NULL(list.spans);
+						}
+						span = &list.spans[list.spanLen];
+						span->index = index;
+						span->len = 0;
+						span->pixel = pixelLen;
+						span->solid = true;
+						list.spanLen += 1;
+					}
+					else if (span->solid && *(u32*)&list.pixels[span->pixel] != *(u32*)&pixel) {
+						/* NOTE(EimaMei): The span stops being solid, so the
+						 * shared pixel gets expanded. */
+						for_range (i, 1, span->len) {
+							list.pixels[span->pixel + i] = list.pixels[span->pixel];
+						}
+						pixelLen = span->pixel + span->len;
+						span->solid = false;
+					}
 
+					if (!span->solid || span->len == 0) {
+						list.pixels[pixelLen] = pixel;
+						pixelLen += 1;
+					}
+					span->len += 1;
+				}
+			}
+
+			free(cpu->recording[0]);
+			free(cpu->recording[1]);
+			cpu->recording[0] = nil;
+			cpu->recording[1] = nil;
+			break;
+		}
 	}
-}
 
-f32 siapp_drawCharacterScale(siWindow* win, const siFont* font, const siGlyphInfo* character,
-		siVec2 pos, u32 size, f32 scaleFactor) {
+	return list;
+}
+void siapp_drawListSubmit(siWindow* win, const siDrawList* list) {
 	SI_ASSERT_NOT_NULL(win);
-	const siGlyphInfo* glyph = character;
+	SI_ASSERT_NOT_NULL(list);
+	SI_ASSERT((win->renderType & SI_RENDERING_BITS) == list->render);
 
-	switch (win->renderType & SI_RENDERING_BITS) {
+	switch (list->render) {
 		case SI_RENDERING_OPENGL: {
 			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-			SI_STOPIF(gl->vertexCounter + 4 > gl->maxVertexCount, siapp_windowRender(win));
+			SI_STOPIF(list->CMDLen == 0, return);
 
-			siImage img = siapp_spriteSheetSpriteGet(font->sheet, glyph->texID);
-			siCoordsF32 tex = img.pos.gpu;
+			/* NOTE(EimaMei): The list has to land on top of everything drawn
+			 * before it, so the pending batch goes first. */
+			SI_STOPIF(gl->vertexCounter != 0 || gl->drawCounter != 0, siapp_windowOpenGLRender(win));
+			siapp_OpenGLCurrentContextSet(win);
 
-			// TODO(EimaMei): Make this slightly faster. | SET
-			tex.x2 = tex.x1 + (glyph->width / img.atlas->totalWidth);
-			tex.y2 = tex.y1 + (glyph->height / img.atlas->texHeight);
+			glUseProgram(gl->programID);
+			glBindVertexArray(list->VAO);
+			glUniformMatrix4fv(gl->uniformMvp, 1, GL_FALSE, gl->transforms[gl->transformLen].m);
+			siapp__timerPassBegin(win);
+			SI__COUNTER_ADD(&gl->counters, draws, list->CMDLen);
+
+			glBindBuffer(GL_ARRAY_BUFFER, list->VBOs[SI_VBO_ID]);
+			for (u32 i = 0; i < list->CMDLen; i += 1) {
+				const siOpenGLDrawCMD* cmd = &list->CMDs[i];
+				glVertexAttribIPointer(SI_SHADER_ID, 2, GL_UNSIGNED_INT, 0, (rawptr)(i * sizeof(siOpenGLIDs)));
+				glDrawElementsInstanced(
+					cmd->mode, cmd->count, GL_UNSIGNED_INT,
+					(siByte*)((usize)cmd->firstIndex * sizeof(u32)), cmd->instanceCount
+				);
+			}
+			siapp__timerPassEnd(win);
+			glBindVertexArray(gl->VAO);
+			break;
+		}
+		case SI_RENDERING_CPU: {
+			siWinRenderingCtxCPU* cpu = &win->render.cpu;
+			SI_STOPIF(!si_pointCmp(list->size, win->e.windowSize), return);
+
+			for (u32 i = 0; i < list->spanLen; i += 1) {
+				const siCPUSpan* span = &list->spans[i];
+				const siColor* src = &list->pixels[span->pixel];
+				siByte* dst = &cpu->buffer[span->index];
+				usize step = !span->solid;
+
+				for (u32 x = 0; x < span->len; x += 1) {
+					u32 inv = 255 - src->a;
+					if (inv == 0) {
+						dst[0] = src->r;
+						dst[1] = src->g;
+						dst[2] = src->b;
+					}
+					else {
+						dst[0] = dst[0] * inv / 255 + src->r;
+						dst[1] = dst[1] * inv / 255 + src->g;
+						dst[2] = dst[2] * inv / 255 + src->b;
+					}
+					dst += SI__CHANNEL_COUNT;
+					src += step;
+				}
+			}
+			break;
+		}
+	}
+}
+F_TRAITS(intern)
+void siapp__projectionSet(siWinRenderingCtxOpenGL* gl, siArea size, b32 flip) {
+	siMatrix projection = rglMatrixIdentity();
+	projection.m[0] = 2.0f / size.width;
+	projection.m[5] = (flip ? 2.0f : -2.0f) / size.height;
+	projection.m[12] = -1.0f;
+	projection.m[13] = flip ? -1.0f : 1.0f;
+	glUniformMatrix4fv(gl->uniformProjection, 1, GL_FALSE, projection.m);
+}
 
-			f32 x = glyph->x * scaleFactor;
-			f32 y = glyph->y * scaleFactor;
-			f32 width = glyph->width * scaleFactor;
-			f32 height = glyph->height * scaleFactor;
+void siapp_drawListFree(siDrawList* list) {
+	SI_ASSERT_NOT_NULL(list);
 
-			f32 baseX = pos.x + x,
-				baseY = pos.y + y + size;
+	switch (list->render) {
+		case SI_RENDERING_OPENGL: {
+			glDeleteBuffers(countof(list->VBOs), list->VBOs);
+			glDeleteVertexArrays(1, &list->VAO);
+			free(list->CMDs);
+			break;
+		}
+		case SI_RENDERING_CPU: {
+			free(list->spans);
+			free(list->pixels);
+			break;
+		}
+	}
+	memset(list, 0, sizeof(*list));
+}
 
-			f32 x1 = i32ToNDCX(baseX, gl->size.width);
-			f32 x2 = i32ToNDCX(baseX + width, gl->size.width);
-			f32 y1 = i32ToNDCY(baseY, gl->size.height);
-			f32 y2 = i32ToNDCY(baseY + height, gl->size.height);
+siLayer siapp_layerMake(siWindow* win, siArea size) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT(size.width > 0 && size.height > 0);
 
-			{
-				siVec4 clr = win->textColor;
-				siapp_color4f(win, clr.x, clr.y, clr.z, clr.w);
+	siLayer layer = {0};
+	layer.invalid = true;
 
-				siapp_texCoords2f(win, tex.x1, tex.y1); siapp_drawVertex2f(win, x1, y1);
-				siapp_texCoords2f(win, tex.x2, tex.y1); siapp_drawVertex2f(win, x2, y1);
-				siapp_texCoords2f(win, tex.x2, tex.y2); siapp_drawVertex2f(win, x2, y2);
-				siapp_texCoords2f(win, tex.x1, tex.y2); siapp_drawVertex2f(win, x1, y2);
-				siapp_texCoords2f(win, 0, 0);
+	/* NOTE(EimaMei): The atlas lives on the heap, so that the image can keep
+	 * pointing at it when the layer gets copied around. */
+	siTextureAtlas* atlas = malloc(sizeof(siTextureAtlas));
+	SI_ASSERT_NOT_NULL(atlas);
+	*atlas = siapp_textureAtlasMake(win, size, 1, SI_RESIZE_DEFAULT);
+	layer.image = siapp_imageLoadEx(atlas, nil, size.width, size.height, 4);
 
-				gl->curTex = &img;
-				siapp__addVertexesToCMD(gl, 6, 4);
-				gl->curTex = &gl->defaultTex;
-			}
+	switch (win->renderType & SI_RENDERING_BITS) {
+		case SI_RENDERING_OPENGL: {
+			glGenFramebuffers(1, &layer.FBO);
+			glBindFramebuffer(GL_FRAMEBUFFER, layer.FBO);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas->texID.opengl, 0);
+			SI_ASSERT_MSG(
+				glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE,
+				"Failed to create the framebuffer of the layer."
+			);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
 			break;
 		}
 		case SI_RENDERING_CPU: {
-			siImage img = siapp_spriteSheetSpriteGet(font->sheet, glyph->texID);
-			img.size = SI_AREA(glyph->width, glyph->height);
+			usize bufferSize = size.width * SI__CHANNEL_COUNT * size.height;
+			layer.scratch[0] = malloc(bufferSize);
+			layer.scratch[1] = malloc(bufferSize);
+			SI_ASSERT(layer.scratch[0] != nil && layer.scratch[1] != nil);
+			break;
+		}
+	}
 
-			siVec2 scale = win->scaleFactor;
-			siRect r = SI_RECT(
-				(pos.x + glyph->x * scaleFactor) * scale.x,
-				(pos.y + size + glyph->y * scaleFactor) * scale.y,
-				glyph->width * scaleFactor * scale.x,
-				glyph->height * scaleFactor * scale.y
-			);
-			size *= scaleFactor;
+	return layer;
+}
+b32 siapp_layerBegin(siWindow* win, siLayer* layer) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT_NOT_NULL(layer);
+	SI_STOPIF(!layer->invalid, return false);
 
-			if (size == font->size && scale.x == 1 && scale.y == 1) {
-				siapp__cpuDrawImage(win, SI_POINT(r.x, r.y), &img, win->textColor);
-				break;
-			}
+	/* NOTE(EimaMei): The layer starts with its own empty clip stack. */
+	layer->clipBase = win->clipBase;
+	win->clipBase = win->clipLen;
 
-			switch (img.atlas->texID.cpu->resizeMethod) {
-				case SI_RESIZE_NEAREST: {
-					siapp__cpuDrawImageNearest(
-						win,
-						r,
-						&img,
-						win->textColor
-					);
-					break;
-				}
+	siArea size = layer->image.size;
+	switch (win->renderType & SI_RENDERING_BITS) {
+		case SI_RENDERING_OPENGL: {
+			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+			SI_ASSERT_MSG(gl->recording == nil, "Layers cannot be drawn while recording a draw list.");
+			SI_STOPIF(gl->vertexCounter != 0 || gl->drawCounter != 0, siapp_windowOpenGLRender(win));
+
+			glGetIntegerv(GL_VIEWPORT, layer->viewport);
+			glGetIntegerv(GL_FRAMEBUFFER_BINDING, &layer->prevFBO);
+			layer->prevTarget = gl->target;
+			glBindFramebuffer(GL_FRAMEBUFFER, layer->FBO);
+			glViewport(0, 0, size.width, size.height);
+			gl->target = size;
+			siapp__clipApply(win);
+
+			glClearColor(0, 0, 0, 0);
+			glClear(GL_COLOR_BUFFER_BIT);
+
+			/* NOTE(EimaMei): Framebuffer rows go bottom to top, so the layer gets
+			 * drawn upside down to match the images. The alpha gets accumulated
+			 * separately, otherwise the layer would turn see-through. */
+			glUseProgram(gl->programID);
+			siapp__projectionSet(gl, size, true);
+			glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+			break;
+		}
+		case SI_RENDERING_CPU: {
+			siWinRenderingCtxCPU* cpu = &win->render.cpu;
+			SI_ASSERT_MSG(cpu->recording[0] == nil, "Layers cannot be drawn while recording a draw list.");
+
+			usize bufferSize = size.width * SI__CHANNEL_COUNT * size.height;
+			memset(layer->scratch[0], 0x00, bufferSize);
+			memset(layer->scratch[1], 0xFF, bufferSize);
+
+			/* NOTE(EimaMei): The layer is drawn the same way as a draw list,
+			 * over black and white, so that its alpha can be restored. */
+			layer->width = cpu->width;
+			layer->windowSize = win->e.windowSize;
+			layer->scaleFactor = win->scaleFactor;
+
+			cpu->width = size.width * SI__CHANNEL_COUNT;
+			cpu->recording[0] = layer->scratch[0];
+			cpu->recording[1] = layer->scratch[1];
+			win->e.windowSize = size;
+			win->scaleFactor = SI_VEC2(1, 1);
+			break;
+		}
+	}
 
-				case SI_RESIZE_LINEAR: {
-					siapp__cpuDrawImageLinear(
-						win,
-						r,
-						&img,
-						win->textColor
-					);
-					break;
+	return true;
+}
+void siapp_layerEnd(siWindow* win, siLayer* layer) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT_NOT_NULL(layer);
+	SI_ASSERT_MSG(win->clipLen == win->clipBase, "Every clip pushed inside of the layer must be popped.");
+	win->clipBase = layer->clipBase;
+
+	switch (win->renderType & SI_RENDERING_BITS) {
+		case SI_RENDERING_OPENGL: {
+			siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+			siapp_windowOpenGLRender(win);
+
+			/* NOTE(EimaMei): The layer might've been started inside of another
+			 * one, in which case the drawing continues in that one. */
+			b32 nested = (layer->prevTarget.width != 0);
+			glBindFramebuffer(GL_FRAMEBUFFER, (u32)layer->prevFBO);
+			glViewport(layer->viewport[0], layer->viewport[1], layer->viewport[2], layer->viewport[3]);
+			siapp__projectionSet(gl, nested ? layer->prevTarget : gl->size, nested);
+			gl->target = layer->prevTarget;
+			siapp__clipApply(win);
+
+			if (nested) {
+				glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+			}
+			else {
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			}
+			break;
+		}
+		case SI_RENDERING_CPU: {
+			siWinRenderingCtxCPU* cpu = &win->render.cpu;
+			siArea size = layer->image.size;
+			const siByte* black = layer->scratch[0];
+			const siByte* white = layer->scratch[1];
+
+			siTextureAtlas* atlas = layer->image.atlas;
+			siColor* dst = &atlas->texID.cpu->data[layer->image.pos.cpu.x1];
+
+			/* NOTE(EimaMei): Atlas pixels are stored in the order the image
+			 * blitters expect them, which is blue first in the buffer. */
+			for_range (y, 0, size.height) {
+				const siByte* b = &black[y * cpu->width];
+				const siByte* w = &white[y * cpu->width];
+
+				for_range (x, 0, size.width) {
+					i32 through = w[0] - b[0];
+					through = si_min(through, w[1] - b[1]);
+					through = si_min(through, w[2] - b[2]);
+
+					u32 a = 255 - si_max(si_min(through, 255), 0);
+					if (a == 0) {
+						dst[x] = SI_RGBA(0, 0, 0, 0);
+					}
+					else {
+						dst[x] = SI_RGBA(
+							si_min(b[2] * 255 / a, 255),
+							si_min(b[1] * 255 / a, 255),
+							si_min(b[0] * 255 / a, 255),
+							a
+						);
+					}
+					b += SI__CHANNEL_COUNT;
+					w += SI__CHANNEL_COUNT;
 				}
+				dst += atlas->totalWidth;
 			}
+
+			cpu->width = layer->width;
+			cpu->recording[0] = nil;
+			cpu->recording[1] = nil;
+			win->e.windowSize = layer->windowSize;
+			win->scaleFactor = layer->scaleFactor;
 			break;
 		}
 	}
 
-	return glyph->advanceX * scaleFactor;
-}
-
-void siapp_color3f(siWindow* win, f32 r, f32 g, f32 b) {
-	SI_ASSERT_NOT_NULL(win);
-	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-	gl->curColor = SI_VEC4(r, g, b, 1.0f);
-}
-void siapp_color4f(siWindow* win, f32 r, f32 g, f32 b, f32 a) {
-	SI_ASSERT_NOT_NULL(win);
-	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-	gl->curColor = SI_VEC4(r, g, b, a);
+	layer->invalid = false;
 }
-void siapp_colorVec4f(siWindow* win, siVec4 color) {
-	SI_ASSERT_NOT_NULL(win);
-	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-	gl->curColor = color;
+void siapp_layerInvalidate(siLayer* layer) {
+	SI_ASSERT_NOT_NULL(layer);
+	layer->invalid = true;
 }
+void siapp_layerFree(siLayer* layer) {
+	SI_ASSERT_NOT_NULL(layer);
+	siTextureAtlas* atlas = layer->image.atlas;
 
-void siapp_texCoords2f(siWindow* win, f32 x, f32 y) {
-	SI_ASSERT_NOT_NULL(win);
-	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
-	gl->curTexCoords = SI_VEC2(x, y);
+	switch (atlas->render) {
+		case SI_RENDERING_OPENGL: {
+			glDeleteFramebuffers(1, &layer->FBO);
+			break;
+		}
+		case SI_RENDERING_CPU: {
+			free(layer->scratch[0]);
+			free(layer->scratch[1]);
+			break;
+		}
+	}
+
+	siapp_textureAtlasFree(*atlas);
+	free(atlas);
+	memset(layer, 0, sizeof(*layer));
 }
 
 
 b32 siapp_windowRendererMake(siWindow* win, siRenderingType renderType,
 		u32 maxDrawCount, siArea maxTexRes, u32 maxTexCount) {
 	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT_MSG(
+		!(win->arg & SI_WINDOW_HEADLESS) || renderType == SI_RENDERING_CPU,
+		"Headless windows can only be rendered with 'SI_RENDERING_CPU'."
+	);
 	win->maxDrawCount = maxDrawCount;
 	win->renderType = renderType;
 
@@ -6877,6 +11400,7 @@ b32 siapp_windowOpenGLInit(siWindow* win, u32 maxDrawCount, u32 maxTexCount,
 	glGenVertexArrays(1, &gl->VAO);
 	glBindVertexArray(gl->VAO);
 	glGenBuffers(countof(gl->VBOs), gl->VBOs);
+	glGenQueries(SI_OPENGL_TIMER_FRAMES * SI_OPENGL_TIMER_PASSES, &gl->timerQueries[0][0]);
 
 	gl->programID = glCreateProgram();
 	SI_ASSERT_MSG(gl->programID != 0, "gl->programID cannot be zero.");
@@ -6885,7 +11409,7 @@ b32 siapp_windowOpenGLInit(siWindow* win, u32 maxDrawCount, u32 maxTexCount,
 		i32 vertexShader;
 		{
 			char VSHADER[sizeof(VSHADER_DEFAULT) + 20];
-			si_snprintf(VSHADER, countof(VSHADER), VSHADER_DEFAULT, maxDrawCount);
+			si_snprintf(VSHADER, countof(VSHADER), VSHADER_DEFAULT, SI_OPENGL_MATRIX_COUNT);
 			vertexShader = si_OpenGLShaderMake(GL_VERTEX_SHADER, VSHADER);
 		}
 
@@ -6941,46 +11465,20 @@ b32 siapp_windowOpenGLInit(siWindow* win, u32 maxDrawCount, u32 maxTexCount,
 	}
 	glUseProgram(gl->programID);
 
-	GL_BUFFER_MAKE(SI_VBO_POS, gl->vertices,  sizeof(siVec3) * 4 * maxDrawCount);
-	GL_BUFFER_MAKE(SI_VBO_CLR, gl->colors,    sizeof(siVec4) * 4 * maxDrawCount);
-	GL_BUFFER_MAKE(SI_VBO_TEX, gl->texCoords, sizeof(siVec2) * 4 * maxDrawCount);
-	GL_BUFFER_MAKE(SI_VBO_ID,  gl->batchInfo, sizeof(siOpenGLIDs) * maxDrawCount);
-
-	siAllocator* alloc = si_allocatorMake(maxDrawCount * (sizeof(siOpenGLDrawCMD) + sizeof(siMatrix)));
-	gl->CMDs = si_mallocArray(alloc, siOpenGLDrawCMD, maxDrawCount);
-	gl->matrices = si_mallocArray(alloc, siMatrix, maxDrawCount);
-
-	typedef u16 siOpenGLIndices[6];
-	siAllocator* indicesAlloc = si_allocatorMake(sizeof(siOpenGLIndices) * maxDrawCount);
-	siOpenGLIndices* indices = si_allocatorCurPtr(indicesAlloc);
-
-	usize k = 0;
-	for_range (i, 0, maxDrawCount) {
-		gl->matrices[i] = rglMatrixIdentity();
-
-		indices[i][0] = k + 0;
-		indices[i][1] = k + 1;
-		indices[i][2] = k + 2;
-
-		indices[i][3] = k + 0;
-		indices[i][4] = k + 2;
-		indices[i][5] = k + 3;
-
-		k += 4;
-	}
+	GL_BUFFER_MAKE(SI_VBO_VERTEX, gl->vertices, sizeof(siOpenGLVertex) * 4 * maxDrawCount);
+	GL_BUFFER_MAKE(SI_VBO_ID,     gl->batchInfo, sizeof(siOpenGLIDs) * maxDrawCount);
+	gl->maxVertexCount = maxDrawCount * 4;
+	gl->maxDrawCount = maxDrawCount;
+	for_range (i, 0, SI_OPENGL_STREAM_REGIONS) { gl->fences[i] = nil; }
 
+	gl->alloc = si_allocatorMake(SI_OPENGL_MATRIX_COUNT * sizeof(siMatrix));
+	gl->matrices = si_mallocArray(gl->alloc, siMatrix, SI_OPENGL_MATRIX_COUNT);
+	gl->CMDs = malloc(sizeof(siOpenGLDrawCMD) * maxDrawCount);
+	SI_ASSERT_NOT_NULL(gl->CMDs);
 
-	// TODO(EimaMei): See if this could be optimized as well.
-	glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[SI_VBO_POS]);
-	glVertexAttribPointer(SI_SHADER_POS, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	siapp__vertexFormatSet(gl->VBOs[SI_VBO_VERTEX]);
 	glEnableVertexAttribArray(SI_SHADER_POS);
-
-	glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[SI_VBO_TEX]);
-	glVertexAttribPointer(SI_SHADER_TEX, 2, GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(SI_SHADER_TEX);
-
-	glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[SI_VBO_CLR]);
-	glVertexAttribPointer(SI_SHADER_CLR, 4, GL_FLOAT, GL_TRUE, 0, 0);
 	glEnableVertexAttribArray(SI_SHADER_CLR);
 
 	glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[SI_VBO_ID]);
@@ -6989,21 +11487,35 @@ b32 siapp_windowOpenGLInit(siWindow* win, u32 maxDrawCount, u32 maxTexCount,
 	glVertexAttribDivisor(SI_SHADER_ID, 1);
 	RGL_opengl_getError();
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl->VBOs[SI_VBO_ELM]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(siOpenGLIndices) * maxDrawCount, indices, GL_STATIC_DRAW);
-	si_allocatorFree(indicesAlloc);
+	siapp__indicesMake(gl, maxDrawCount);
 
 	gl->uniformTexture = glGetUniformLocation(gl->programID, "textures");
 	gl->uniformMvp = glGetUniformLocation(gl->programID, "mvp");
-	glUniformMatrix4fv(gl->uniformMvp, maxDrawCount, GL_FALSE, gl->matrices->m);
+	gl->uniformProjection = glGetUniformLocation(gl->programID, "projection");
+	siapp__projectionSet(gl, gl->size, false);
 
 GL_init_section:
 	gl->vertexCounter = 0;
 	gl->drawCounter = 0;
+	gl->transformLen = 0;
+	gl->transforms[0] = rglMatrixIdentity();
+	if ((win->renderType & SI_RENDERING_OPENGL_BITS) != SI_RENDERINGVER_OPENGL_LEGACY) {
+		gl->matrices[0] = gl->transforms[0];
+	}
+	gl->matrixCounter = 1;
+	gl->matrixUsed = false;
 	gl->bgColor = SI_VEC4(1, 1, 1, 1);
-	gl->curTexCoords = SI_VEC2(0, 0);
+	gl->curTexCoords[0] = gl->curTexCoords[1] = 0;
 	gl->gradientLen = 0;
-	gl->maxVertexCount = maxDrawCount * 4;
+	gl->frameVertices = 0;
+	gl->frameDraws = 0;
+	gl->deferred = nil;
+	gl->layer = 0;
+	memset(&gl->stats, 0, sizeof(gl->stats));
+	if ((win->renderType & SI_RENDERING_OPENGL_BITS) == SI_RENDERINGVER_OPENGL_LEGACY) {
+		gl->maxVertexCount = maxDrawCount * 4;
+		gl->maxDrawCount = maxDrawCount;
+	}
 
 	win->atlas = siapp_textureAtlasMake(win, maxTexRes, maxTexCount, SI_RESIZE_DEFAULT);
 	gl->defaultTex = siapp_imageLoadEx(&win->atlas, si_buf(siByte, 255, 255, 255, 255), 1, 1, 4);
@@ -7026,49 +11538,126 @@ void siapp_windowOpenGLRender(siWindow* win) {
 			gl->drawCounter = 0;
 			return ;
 		}
-		case SI_RENDERINGVER_OPENGL_3_3: {
-			glUseProgram(gl->programID);
-			glBindVertexArray(gl->VAO);
-			//glUniformMatrix4fv(gl->uniformMvp, gl->drawCounter, GL_FALSE, gl->matrices->m);
-
-			glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[SI_VBO_POS]);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, gl->vertexCounter * sizeof(siVec3), gl->vertices);
-
-			glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[SI_VBO_TEX]);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, gl->vertexCounter * sizeof(siVec2), gl->texCoords);
-
-			glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[SI_VBO_CLR]);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, gl->vertexCounter * sizeof(siVec4), gl->colors);
-
-			glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[SI_VBO_ID]);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, gl->drawCounter * sizeof(siOpenGLIDs), gl->batchInfo);
-			break;
-		}
+		case SI_RENDERINGVER_OPENGL_3_3:
 		case SI_RENDERINGVER_OPENGL_4_4: {
 			glUseProgram(gl->programID);
 			glBindVertexArray(gl->VAO);
-			//glUniformMatrix4fv(gl->uniformMvp, gl->drawCounter, GL_FALSE, gl->matrices->m);
+			glUniformMatrix4fv(gl->uniformMvp, gl->matrixCounter, GL_FALSE, gl->matrices->m);
 			break;
 		}
 	}
 
+	SI_STOPIF(gl->deferred != nil, siapp__deferredResolve(gl));
+	siapp__timerPassBegin(win);
+
+	siOpenGLStream* vertexStream = &gl->streams[SI_VBO_VERTEX];
+	siOpenGLStream* IDStream = &gl->streams[SI_VBO_ID];
+	b32 streaming = (vertexStream->mapping == nil);
+	u64 uploadStart = siapp__clockNs();
+	if (streaming) {
+		siapp__streamUnmap(gl, SI_VBO_VERTEX, gl->vertexCounter * sizeof(siOpenGLVertex));
+		siapp__streamUnmap(gl, SI_VBO_ID, gl->drawCounter * sizeof(siOpenGLIDs));
+	}
+	u64 submitStart = siapp__clockNs();
+	win->frameHistory.current[SI_FRAME_TIME_UPLOAD] += submitStart - uploadStart;
+	i32 baseVertex = vertexStream->offset / sizeof(siOpenGLVertex);
+	usize baseID = IDStream->offset;
+
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl->VBOs[SI_VBO_ELM]);
+	glBindBuffer(GL_ARRAY_BUFFER, gl->VBOs[SI_VBO_ID]);
 
 	for_range (i, 0, gl->drawCounter) {
 		const siOpenGLDrawCMD* cmd = &gl->CMDs[i];
 
-		glDrawElementsInstancedBaseVertex(
-			GL_TRIANGLE_FAN,
-			cmd->count,
-			GL_UNSIGNED_SHORT,
-			(siByte*)((cmd->firstIndex) * sizeof(u16)),
-			cmd->instanceCount,
-			cmd->baseVertex
-		);
+		/* NOTE(EimaMei): Base instances aren't available before GL 4.2, so the
+		 * per-draw IDs get pointed at directly. */
+		glVertexAttribIPointer(SI_SHADER_ID, 2, GL_UNSIGNED_INT, 0, (rawptr)(baseID + i * sizeof(siOpenGLIDs)));
+		if (cmd->firstIndex != UINT32_MAX) {
+			glDrawElementsInstancedBaseVertex(
+				cmd->mode,
+				cmd->count,
+				GL_UNSIGNED_INT,
+				(siByte*)((usize)cmd->firstIndex * sizeof(u32)),
+				cmd->instanceCount,
+				baseVertex + cmd->baseVertex
+			);
+		}
+		else {
+			glDrawArraysInstanced(cmd->mode, baseVertex + cmd->baseVertex, cmd->count, cmd->instanceCount);
+		}
+	}
+
+	gl->frameVertices += gl->vertexCounter;
+	gl->frameDraws += gl->drawCounter;
+	SI__COUNTER_ADD(&gl->counters, draws, gl->drawCounter);
+	SI__COUNTER_ADD(&gl->counters, vertices, gl->vertexCounter);
+	gl->stats.peakVertices = si_max(gl->stats.peakVertices, gl->frameVertices);
+	gl->stats.peakDraws = si_max(gl->stats.peakDraws, gl->frameDraws);
+
+	if (streaming) {
+		/* NOTE(EimaMei): Vertex offsets stay a multiple of the vertex size, so
+		 * that they can be turned into a base vertex. */
+		vertexStream->offset += gl->vertexCounter * sizeof(siOpenGLVertex);
+		IDStream->offset += gl->drawCounter * sizeof(siOpenGLIDs);
+
+		siapp__verticesSet(gl, siapp__streamMap(gl, SI_VBO_VERTEX));
+		gl->batchInfo = siapp__streamMap(gl, SI_VBO_ID);
+	}
+	else {
+		/* NOTE(EimaMei): The next batch goes into the next region. The GPU is
+		 * only waited on if it's still reading from that region, which only
+		 * happens after 'SI_OPENGL_STREAM_REGIONS' batches are in flight. */
+		usize region = vertexStream->offset / vertexStream->regionSize;
+		gl->fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		region = (region + 1) % SI_OPENGL_STREAM_REGIONS;
+		if (gl->fences[region] != nil) {
+			glClientWaitSync(gl->fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+			glDeleteSync(gl->fences[region]);
+			gl->fences[region] = nil;
+		}
+
+		vertexStream->offset = region * vertexStream->regionSize;
+		IDStream->offset = region * IDStream->regionSize;
+		siapp__verticesSet(gl, (siOpenGLVertex*)&vertexStream->mapping[vertexStream->offset]);
+		gl->batchInfo = (siOpenGLIDs*)&IDStream->mapping[IDStream->offset];
 	}
-	glFinish();
 	gl->vertexCounter = 0;
 	gl->drawCounter = 0;
+
+	gl->matrices[0] = gl->transforms[gl->transformLen];
+	gl->matrixCounter = 1;
+	gl->matrixUsed = false;
+
+	siapp__timerPassEnd(win);
+	win->frameHistory.current[SI_FRAME_TIME_SUBMIT] += siapp__clockNs() - submitStart;
+}
+void siapp_windowOpenGLBatchReserve(siWindow* win, u32 maxVertexCount, u32 maxDrawCount) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT((win->renderType & SI_RENDERING_BITS) == SI_RENDERING_OPENGL);
+
+	siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	SI_STOPIF((win->renderType & SI_RENDERING_OPENGL_BITS) == SI_RENDERINGVER_OPENGL_LEGACY, return);
+	SI_STOPIF(maxVertexCount <= gl->maxVertexCount && maxDrawCount <= gl->maxDrawCount, return);
+
+	siapp_OpenGLCurrentContextSet(win);
+	SI_STOPIF(gl->vertexCounter != 0 || gl->drawCounter != 0, siapp_windowOpenGLRender(win));
+	siapp__batchGrow(
+		win,
+		si_max(maxVertexCount, gl->maxVertexCount),
+		si_max(maxDrawCount, gl->maxDrawCount)
+	);
+}
+siOpenGLBatchStats siapp_windowOpenGLBatchStatsGet(const siWindow* win) {
+	SI_ASSERT_NOT_NULL(win);
+	SI_ASSERT((win->renderType & SI_RENDERING_BITS) == SI_RENDERING_OPENGL);
+
+	const siWinRenderingCtxOpenGL* gl = &win->render.opengl;
+	siOpenGLBatchStats stats = gl->stats;
+	stats.maxVertexCount = gl->maxVertexCount;
+	stats.maxDrawCount = gl->maxDrawCount;
+
+	return stats;
 }
 void siapp_windowOpenGLDestroy(siWindow* win) {
 	SI_ASSERT_NOT_NULL(win);
@@ -7079,13 +11668,7 @@ void siapp_windowOpenGLDestroy(siWindow* win) {
 		case SI_RENDERINGVER_OPENGL_LEGACY: {
 			break;
 		}
-		case SI_RENDERINGVER_OPENGL_3_3: {
-			free(gl->vertices);
-			free(gl->texCoords);
-			free(gl->colors);
-			free(gl->batchInfo);
-			siFallthrough;
-		}
+		case SI_RENDERINGVER_OPENGL_3_3:
 		case SI_RENDERINGVER_OPENGL_4_4: {
 			glUseProgram(gl->programID);
 			glBindVertexArray(gl->VAO);
@@ -7093,9 +11676,16 @@ void siapp_windowOpenGLDestroy(siWindow* win) {
 			siapp_textureAtlasFree(win->atlas);
 			glDeleteBuffers(countof(gl->VBOs), gl->VBOs);
 			glDeleteVertexArrays(1, &gl->VAO);
+			glDeleteQueries(SI_OPENGL_TIMER_FRAMES * SI_OPENGL_TIMER_PASSES, &gl->timerQueries[0][0]);
+
+			for_range (i, 0, SI_OPENGL_STREAM_REGIONS) {
+				SI_STOPIF(gl->fences[i] != nil, glDeleteSync(gl->fences[i]));
+			}
 
 			glDeleteProgram(gl->programID);
 			si_allocatorFree(gl->alloc);
+			free(gl->CMDs);
+			SI_STOPIF(gl->deferred != nil, siapp_windowDeferredSet(win, false));
 			break;
 		}
 	}
@@ -7149,9 +11739,20 @@ b32 siapp_windowCPUInit(siWindow* win, u32 maxTexCount, siArea maxTexRes) {
 	SI_ASSERT_NOT_NULL(win);
 	siWinRenderingCtxCPU* cpu = &win->render.cpu;
 
+	if (win->arg & SI_WINDOW_HEADLESS) {
+		siArea size = win->e.windowSize;
+		cpu->width = size.width * SI__CHANNEL_COUNT;
+
+		cpu->buffer = (siByte*)calloc(size.height, cpu->width);
+		SI_STOPIF(cpu->buffer == nil, return false);
+		win->atlas = siapp_textureAtlasMake(win, maxTexRes, maxTexCount, SI_RESIZE_DEFAULT);
+
+		siapp__resizeWindow(win, size.width, size.height, false);
+		return true;
+	}
+
 	siArea size = siapp_screenSizeGet();
 	cpu->width = size.width * SI__CHANNEL_COUNT;
-	cpu->fps = 0;
 
 #if defined(SIAPP_PLATFORM_API_X11)
 	cpu->buffer = (siByte*)calloc(size.width * size.height, 3);
@@ -7200,8 +11801,10 @@ b32 siapp_windowCPUInit(siWindow* win, u32 maxTexCount, siArea maxTexRes) {
 }
 void siapp_windowCPURender(siWindow* win) {
 	SI_ASSERT_NOT_NULL(win);
+	SI_STOPIF(win->arg & SI_WINDOW_HEADLESS, return);
 	siWinRenderingCtxCPU* cpu = &win->render.cpu;
 	siArea size = win->e.windowSize;
+	u64 start = siapp__clockNs();
 
 #if defined(SIAPP_PLATFORM_API_X11)
 	XPutImage(
@@ -7226,16 +11829,20 @@ void siapp_windowCPURender(siWindow* win) {
 #elif defined(SIAPP_PLATFORM_API_WIN32)
 	BitBlt(win->hdc, 0, 0, size.width, size.height, cpu->hdc, 0, 0, SRCCOPY);
 #endif
-
-	if (cpu->fps != 0) {
-		si_sleep(cpu->fps);
-	}
+	win->frameHistory.current[SI_FRAME_TIME_SUBMIT] += siapp__clockNs() - start;
+	SI__COUNTER_ADD(&cpu->counters, pixelsPresented, size.width * size.height);
 }
 
 void siapp_windowCPUDestroy(siWindow* win) {
 	SI_ASSERT_NOT_NULL(win);
 	siWinRenderingCtxCPU* cpu = &win->render.cpu;
 
+	if (win->arg & SI_WINDOW_HEADLESS) {
+		free(cpu->buffer);
+		siapp_textureAtlasFree(win->atlas);
+		return ;
+	}
+
 #if defined(SIAPP_PLATFORM_API_X11)
 	free(cpu->buffer);
 	free(cpu->bitmap);
@@ -7290,7 +11897,9 @@ siMessageBoxResult siapp_messageBoxEx(siWindow* win, cstring title,
 		case IDCONTINUE: res = SI_MESSAGE_BOX_RESULT_CONTINUE; break;
 	}
 	if (win != nil && win->e.type.keyPress) {
-		memset(win->e.keys, 0, sizeof(win->e.keys));
+		win->e.keysClicked = (siKeySet){0};
+		win->e.keysPressed = (siKeySet){0};
+		win->e.keysReleased = (siKeySet){0};
 		win->e.curKey = 0;
 		win->e.type.keyPress = false;
 	}
@@ -7408,7 +12017,9 @@ siMessageBoxResult siapp_messageBoxEx(siWindow* win, cstring title,
 	}
 
 	if (win != nil && win->e.type.keyPress) {
-		memset(win->e.keys, 0, sizeof(win->e.keys));
+		win->e.keysClicked = (siKeySet){0};
+		win->e.keysPressed = (siKeySet){0};
+		win->e.keysReleased = (siKeySet){0};
 		win->e.curKey = 0;
 		win->e.type.keyPress = false;
 	}